@@ -0,0 +1,487 @@
+/*
+** Microbenchmarks for sqlite-path.
+**
+** Links sqlite-path.c, cwalk and SQLite into one binary, generates corpora of
+** paths with different shapes, and times every registered path function (and
+** the path_parts/path_parse table functions) over each corpus. Results are
+** written to stdout as JSON, one object per benchmark and corpus, so runs can
+** be saved and compared over time:
+**
+**    make -s bench > before.json
+**
+** Every benchmark runs `SELECT <expr> FROM corpus` over an in-memory table of
+** paths, so ns/op includes the cost of stepping the statement. The
+** "baseline" benchmark (`SELECT path FROM corpus`) measures that cost alone.
+** Allocations are counted through a SQLITE_CONFIG_MALLOC wrapper around
+** SQLite's default allocator, which sqlite-path allocates through.
+**
+** Usage: bench [-n paths] [-r repeat] [-f filter]
+**    -n  number of paths in each corpus (default 20000)
+**    -r  runs of each benchmark, the fastest is reported (default 5)
+**    -f  only run benchmarks whose name contains this string
+*/
+#include "sqlite3.h"
+
+#include "sqlite-path.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#pragma region allocation counting
+
+static sqlite3_mem_methods benchDefaultMem;
+static sqlite3_int64 benchAllocs;
+
+static void *benchMalloc(int n) {
+  benchAllocs++;
+  return benchDefaultMem.xMalloc(n);
+}
+
+static void *benchRealloc(void *p, int n) {
+  benchAllocs++;
+  return benchDefaultMem.xRealloc(p, n);
+}
+
+static int benchInstallMalloc(void) {
+  sqlite3_mem_methods mem;
+  int rc = sqlite3_config(SQLITE_CONFIG_GETMALLOC, &benchDefaultMem);
+  if (rc != SQLITE_OK)
+    return rc;
+  mem = benchDefaultMem;
+  mem.xMalloc = benchMalloc;
+  mem.xRealloc = benchRealloc;
+  return sqlite3_config(SQLITE_CONFIG_MALLOC, &mem);
+}
+
+#pragma endregion
+
+#pragma region corpora
+
+/*
+** splitmix64, so every corpus is the same from run to run and machine to
+** machine.
+*/
+static sqlite3_uint64 benchRandom(sqlite3_uint64 *pState) {
+  sqlite3_uint64 z = (*pState += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static int benchRange(sqlite3_uint64 *pState, int lo, int hi) {
+  return lo + (int)(benchRandom(pState) % (sqlite3_uint64)(hi - lo + 1));
+}
+
+typedef struct bench_buffer bench_buffer;
+struct bench_buffer {
+  char z[8192];
+  int n;
+};
+
+static void benchPut(bench_buffer *p, const char *z) {
+  while (*z && p->n < (int)sizeof(p->z) - 1)
+    p->z[p->n++] = *z++;
+}
+
+static void benchPutChar(bench_buffer *p, char c) {
+  if (p->n < (int)sizeof(p->z) - 1)
+    p->z[p->n++] = c;
+}
+
+static void benchPutName(bench_buffer *p, sqlite3_uint64 *pState, int nName) {
+  static const char aChar[] = "abcdefghijklmnopqrstuvwxyz0123456789_-";
+  for (int i = 0; i < nName; i++)
+    benchPutChar(p, aChar[benchRandom(pState) % (sizeof(aChar) - 1)]);
+}
+
+static void benchPutExtension(bench_buffer *p, sqlite3_uint64 *pState) {
+  static const char *aExtension[] = {".c", ".h", ".txt", ".json", ".tar.gz",
+                                     ".md", ".py", ".jpeg", ""};
+  benchPut(p, aExtension[benchRandom(pState) %
+                         (sizeof(aExtension) / sizeof(aExtension[0]))]);
+}
+
+// "src/main.c", 1 to 3 short segments
+static void benchShallow(bench_buffer *p, sqlite3_uint64 *pState) {
+  int nSegment = benchRange(pState, 1, 3);
+  for (int i = 0; i < nSegment; i++) {
+    if (i > 0)
+      benchPutChar(p, '/');
+    benchPutName(p, pState, benchRange(pState, 2, 10));
+  }
+  benchPutExtension(p, pState);
+}
+
+// absolute paths of 16 to 48 segments
+static void benchDeep(bench_buffer *p, sqlite3_uint64 *pState) {
+  int nSegment = benchRange(pState, 16, 48);
+  for (int i = 0; i < nSegment; i++) {
+    benchPutChar(p, '/');
+    benchPutName(p, pState, benchRange(pState, 1, 12));
+  }
+  benchPutExtension(p, pState);
+}
+
+// 2 to 5 segments of 48 to 200 bytes each
+static void benchLongNames(bench_buffer *p, sqlite3_uint64 *pState) {
+  int nSegment = benchRange(pState, 2, 5);
+  for (int i = 0; i < nSegment; i++) {
+    if (i > 0)
+      benchPutChar(p, '/');
+    benchPutName(p, pState, benchRange(pState, 48, 200));
+  }
+  benchPutExtension(p, pState);
+}
+
+// "./a.b/../c.d.e.tar.gz", with "." and ".." segments and dotted names
+static void benchManyDots(bench_buffer *p, sqlite3_uint64 *pState) {
+  int nSegment = benchRange(pState, 3, 10);
+  for (int i = 0; i < nSegment; i++) {
+    if (i > 0)
+      benchPutChar(p, '/');
+    switch (benchRandom(pState) % 4) {
+    case 0:
+      benchPut(p, ".");
+      break;
+    case 1:
+      benchPut(p, "..");
+      break;
+    default: {
+      int nPart = benchRange(pState, 1, 6);
+      if (benchRandom(pState) % 4 == 0)
+        benchPutChar(p, '.');
+      for (int j = 0; j < nPart; j++) {
+        if (j > 0)
+          benchPutChar(p, '.');
+        benchPutName(p, pState, benchRange(pState, 1, 5));
+      }
+    }
+    }
+  }
+}
+
+// "C:\Users\...", with a UNC share every so often
+static void benchWindows(bench_buffer *p, sqlite3_uint64 *pState) {
+  int nSegment = benchRange(pState, 2, 12);
+  if (benchRandom(pState) % 8 == 0) {
+    benchPut(p, "\\\\");
+    benchPutName(p, pState, benchRange(pState, 4, 10));
+    benchPutChar(p, '\\');
+    benchPutName(p, pState, benchRange(pState, 2, 8));
+  } else {
+    benchPutChar(p, (char)('C' + benchRandom(pState) % 4));
+    benchPutChar(p, ':');
+  }
+  for (int i = 0; i < nSegment; i++) {
+    benchPutChar(p, benchRandom(pState) % 16 ? '\\' : '/');
+    benchPutName(p, pState, benchRange(pState, 2, 14));
+  }
+  benchPutExtension(p, pState);
+}
+
+static const struct {
+  const char *zName;
+  void (*xGenerate)(bench_buffer *, sqlite3_uint64 *);
+} aCorpus[] = {
+    {"shallow", benchShallow},     {"deep", benchDeep},
+    {"long_names", benchLongNames}, {"many_dots", benchManyDots},
+    {"windows", benchWindows},
+};
+
+/*
+** Replace the contents of the corpus table with nPath paths of the given
+** shape, and set *pnBytes to their total size.
+*/
+static int benchLoadCorpus(sqlite3 *db, int iCorpus, int nPath,
+                           sqlite3_int64 *pnBytes) {
+  sqlite3_stmt *pStmt;
+  sqlite3_uint64 state = 0x5eed + iCorpus;
+  bench_buffer buffer;
+  int rc;
+
+  *pnBytes = 0;
+  rc = sqlite3_exec(db, "DELETE FROM corpus", 0, 0, 0);
+  if (rc != SQLITE_OK)
+    return rc;
+  rc = sqlite3_prepare_v2(db, "INSERT INTO corpus(path) VALUES (?)", -1,
+                          &pStmt, 0);
+  if (rc != SQLITE_OK)
+    return rc;
+  for (int i = 0; i < nPath && rc == SQLITE_OK; i++) {
+    buffer.n = 0;
+    aCorpus[iCorpus].xGenerate(&buffer, &state);
+    *pnBytes += buffer.n;
+    sqlite3_bind_text(pStmt, 1, buffer.z, buffer.n, SQLITE_STATIC);
+    rc = sqlite3_step(pStmt) == SQLITE_DONE ? SQLITE_OK : sqlite3_errcode(db);
+    sqlite3_reset(pStmt);
+  }
+  sqlite3_finalize(pStmt);
+  return rc;
+}
+
+#pragma endregion
+
+#pragma region benchmarks
+
+/*
+** Each benchmark is the expression selected for every row of the corpus.
+** zFunction is the registered function it covers, so functions added to
+** sqlite-path without a benchmark are reported on stderr.
+*/
+static const struct {
+  const char *zName;
+  const char *zFunction;
+  const char *zSql;
+} aBench[] = {
+    {"baseline", 0, "SELECT path FROM corpus"},
+    {"path_absolute", "path_absolute",
+     "SELECT path_absolute(path) FROM corpus"},
+    {"path_at", "path_at", "SELECT path_at(path, -1) FROM corpus"},
+    {"path_basename", "path_basename",
+     "SELECT path_basename(path) FROM corpus"},
+    {"path_dirname", "path_dirname", "SELECT path_dirname(path) FROM corpus"},
+    {"path_extension", "path_extension",
+     "SELECT path_extension(path) FROM corpus"},
+    {"path_intersection", "path_intersection",
+     "SELECT path_intersection(path, path) FROM corpus"},
+    {"path_join", "path_join", "SELECT path_join(path, 'a/../b') FROM corpus"},
+    {"path_length", "path_length", "SELECT path_length(path) FROM corpus"},
+    {"path_name", "path_name", "SELECT path_name(path) FROM corpus"},
+    {"path_normalize", "path_normalize",
+     "SELECT path_normalize(path) FROM corpus"},
+    {"path_part_at", "path_part_at",
+     "SELECT path_part_at(path, 1) FROM corpus"},
+    {"path_relative", "path_relative",
+     "SELECT path_relative(path) FROM corpus"},
+    {"path_root", "path_root", "SELECT path_root(path) FROM corpus"},
+    {"path_sort_key", "path_sort_key",
+     "SELECT path_sort_key(path) FROM corpus"},
+    {"path_subtree_upper", "path_subtree_upper",
+     "SELECT path_subtree_upper(path) FROM corpus"},
+    {"path_under", "path_under",
+     "SELECT path_under(path, path_dirname(path_dirname(path))) FROM corpus"},
+    {"path_win_absolute", "path_win_absolute",
+     "SELECT path_win_absolute(path) FROM corpus"},
+    {"path_win_at", "path_win_at", "SELECT path_win_at(path, -1) FROM corpus"},
+    {"path_win_basename", "path_win_basename",
+     "SELECT path_win_basename(path) FROM corpus"},
+    {"path_win_dirname", "path_win_dirname",
+     "SELECT path_win_dirname(path) FROM corpus"},
+    {"path_win_extension", "path_win_extension",
+     "SELECT path_win_extension(path) FROM corpus"},
+    {"path_win_intersection", "path_win_intersection",
+     "SELECT path_win_intersection(path, path) FROM corpus"},
+    {"path_win_join", "path_win_join",
+     "SELECT path_win_join(path, 'a\\..\\b') FROM corpus"},
+    {"path_win_length", "path_win_length",
+     "SELECT path_win_length(path) FROM corpus"},
+    {"path_win_name", "path_win_name",
+     "SELECT path_win_name(path) FROM corpus"},
+    {"path_win_normalize", "path_win_normalize",
+     "SELECT path_win_normalize(path) FROM corpus"},
+    {"path_win_part_at", "path_win_part_at",
+     "SELECT path_win_part_at(path, 1) FROM corpus"},
+    {"path_win_relative", "path_win_relative",
+     "SELECT path_win_relative(path) FROM corpus"},
+    {"path_win_root", "path_win_root",
+     "SELECT path_win_root(path) FROM corpus"},
+    {"path_win_sort_key", "path_win_sort_key",
+     "SELECT path_win_sort_key(path) FROM corpus"},
+    {"path_win_subtree_upper", "path_win_subtree_upper",
+     "SELECT path_win_subtree_upper(path) FROM corpus"},
+    {"path_win_under", "path_win_under",
+     "SELECT path_win_under(path, path_win_dirname(path_win_dirname(path))) "
+     "FROM corpus"},
+    // several functions on one row, which share a parse through the cache
+    {"path_dirname+basename+extension", 0,
+     "SELECT path_dirname(path), path_basename(path), path_extension(path) "
+     "FROM corpus"},
+    // sorting the corpus, which compares about log2(n) times per path
+    {"order_by_binary", 0, "SELECT path FROM corpus ORDER BY path"},
+    {"order_by_path", 0, "SELECT path FROM corpus ORDER BY path COLLATE PATH"},
+    {"order_by_path_nocase", 0,
+     "SELECT path FROM corpus ORDER BY path COLLATE PATH_NOCASE"},
+    {"order_by_path_natural", 0,
+     "SELECT path FROM corpus ORDER BY path COLLATE PATH_NATURAL"},
+    {"order_by_path_sort_key", 0,
+     "SELECT path FROM corpus ORDER BY path_sort_key(path)"},
+    // table functions, one op is one path
+    {"path_parts", "path_parts",
+     "SELECT count(parts.part) FROM corpus, path_parts(corpus.path) AS parts "
+     "GROUP BY corpus.rowid"},
+    {"path_win_parts", "path_win_parts",
+     "SELECT count(parts.part) FROM corpus, path_win_parts(corpus.path) AS "
+     "parts GROUP BY corpus.rowid"},
+    {"path_parse", "path_parse",
+     "SELECT parsed.dirname, parsed.basename, parsed.normalized FROM corpus, "
+     "path_parse(corpus.path) AS parsed"},
+    {"path_win_parse", "path_win_parse",
+     "SELECT parsed.dirname, parsed.basename, parsed.normalized FROM corpus, "
+     "path_win_parse(corpus.path) AS parsed"},
+    {"path_ancestors", "path_ancestors",
+     "SELECT count(a.prefix) FROM corpus, path_ancestors(corpus.path) AS a "
+     "GROUP BY corpus.rowid"},
+    {"path_win_ancestors", "path_win_ancestors",
+     "SELECT count(a.prefix) FROM corpus, path_win_ancestors(corpus.path) AS "
+     "a GROUP BY corpus.rowid"},
+    // aggregates, one op is one row added
+    {"path_rollup", "path_rollup",
+     "SELECT length(path_rollup(path, length(path))) FROM corpus"},
+    {"path_win_rollup", "path_win_rollup",
+     "SELECT length(path_win_rollup(path, length(path))) FROM corpus"},
+    {"path_tree", "path_tree",
+     "SELECT length(path_tree(path, length(path))) FROM corpus"},
+    {"path_win_tree", "path_win_tree",
+     "SELECT length(path_win_tree(path, length(path))) FROM corpus"},
+    {"path_common_prefix", "path_common_prefix",
+     "SELECT path_common_prefix(path) FROM corpus"},
+    {"path_win_common_prefix", "path_win_common_prefix",
+     "SELECT path_win_common_prefix(path) FROM corpus"},
+    // a rolling window, each row is added once and removed once
+    {"path_common_prefix_window", 0,
+     "SELECT path_common_prefix(path) OVER (ORDER BY rowid ROWS BETWEEN 16 "
+     "PRECEDING AND CURRENT ROW) FROM corpus"},
+    // generates as many paths as the corpus has
+    {"path_synth", "path_synth",
+     "SELECT path FROM path_synth((SELECT count(*) FROM corpus), 42)"},
+};
+
+#define BENCH_COUNT (int)(sizeof(aBench) / sizeof(aBench[0]))
+
+static sqlite3_int64 benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (sqlite3_int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+** Warn about registered path functions and modules that no benchmark covers.
+*/
+static void benchCheckCoverage(sqlite3 *db) {
+  sqlite3_stmt *pStmt;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT name FROM pragma_function_list "
+                         "WHERE name LIKE 'path_%' "
+                         "UNION SELECT name FROM pragma_module_list "
+                         "WHERE name LIKE 'path_%'",
+                         -1, &pStmt, 0) != SQLITE_OK)
+    return;
+  while (sqlite3_step(pStmt) == SQLITE_ROW) {
+    const char *zName = (const char *)sqlite3_column_text(pStmt, 0);
+    int bFound = strcmp(zName, "path_version") == 0 ||
+                 strcmp(zName, "path_debug") == 0 ||
+                 strcmp(zName, "path_config") == 0 ||
+                 strcmp(zName, "path_stats") == 0 ||
+                 // need a source table, see bench/workload.py
+                 strcmp(zName, "path_trie") == 0 ||
+                 strcmp(zName, "path_closure") == 0;
+    for (int i = 0; i < BENCH_COUNT && !bFound; i++)
+      bFound = aBench[i].zFunction && strcmp(aBench[i].zFunction, zName) == 0;
+    if (!bFound)
+      fprintf(stderr, "warning: %s has no benchmark\n", zName);
+  }
+  sqlite3_finalize(pStmt);
+}
+
+/*
+** Run a benchmark nRepeat times over the current corpus. Sets *pnNs to the
+** fastest run, *pnRows to the rows it returned, and *pnAllocs to the
+** allocations made during that run.
+*/
+static int benchRun(sqlite3 *db, const char *zSql, int nRepeat,
+                    sqlite3_int64 *pnNs, sqlite3_int64 *pnAllocs) {
+  sqlite3_stmt *pStmt;
+  int rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, 0);
+  if (rc != SQLITE_OK)
+    return rc;
+  *pnNs = -1;
+  for (int i = 0; i < nRepeat && rc == SQLITE_OK; i++) {
+    sqlite3_int64 nAllocs = benchAllocs;
+    sqlite3_int64 iStart = benchNow();
+    sqlite3_int64 nNs;
+    while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    }
+    nNs = benchNow() - iStart;
+    rc = sqlite3_reset(pStmt);
+    if (*pnNs < 0 || nNs < *pnNs) {
+      *pnNs = nNs;
+      *pnAllocs = benchAllocs - nAllocs;
+    }
+  }
+  sqlite3_finalize(pStmt);
+  return rc;
+}
+
+#pragma endregion
+
+int main(int argc, char **argv) {
+  sqlite3 *db;
+  const char *zFilter = 0;
+  int nPath = 20000;
+  int nRepeat = 5;
+  int bFirst = 1;
+  int rc;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0)
+      nPath = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-r") == 0)
+      nRepeat = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-f") == 0)
+      zFilter = argv[i + 1];
+  }
+  if (nPath < 1 || nRepeat < 1) {
+    fprintf(stderr, "usage: %s [-n paths] [-r repeat] [-f filter]\n",
+            argv[0]);
+    return 1;
+  }
+
+  rc = benchInstallMalloc();
+  if (rc == SQLITE_OK)
+    rc = sqlite3_open(":memory:", &db);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_path_init(db, 0, 0);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_exec(db, "CREATE TABLE corpus(path TEXT)", 0, 0, 0);
+  if (rc != SQLITE_OK) {
+    fprintf(stderr, "error: %s\n", sqlite3_errstr(rc));
+    return 1;
+  }
+  benchCheckCoverage(db);
+
+  printf("{\n  \"sqlite\": \"%s\",\n  \"paths\": %d,\n  \"repeat\": %d,\n"
+         "  \"results\": [",
+         sqlite3_libversion(), nPath, nRepeat);
+  for (int c = 0; c < (int)(sizeof(aCorpus) / sizeof(aCorpus[0])); c++) {
+    sqlite3_int64 nBytes;
+    rc = benchLoadCorpus(db, c, nPath, &nBytes);
+    if (rc != SQLITE_OK)
+      break;
+    for (int b = 0; b < BENCH_COUNT; b++) {
+      sqlite3_int64 nNs, nAllocs;
+      if (zFilter && strstr(aBench[b].zName, zFilter) == 0)
+        continue;
+      rc = benchRun(db, aBench[b].zSql, nRepeat, &nNs, &nAllocs);
+      if (rc != SQLITE_OK) {
+        fprintf(stderr, "error: %s: %s\n", aBench[b].zName, sqlite3_errmsg(db));
+        break;
+      }
+      if (nNs == 0)
+        nNs = 1;
+      printf("%s\n    {\"benchmark\": \"%s\", \"corpus\": \"%s\", "
+             "\"ops\": %d, \"bytes\": %lld, \"ns_per_op\": %.2f, "
+             "\"bytes_per_sec\": %.0f, \"allocs_per_op\": %.3f}",
+             bFirst ? "" : ",", aBench[b].zName, aCorpus[c].zName, nPath,
+             nBytes, (double)nNs / nPath, (double)nBytes * 1e9 / nNs,
+             (double)nAllocs / nPath);
+      bFirst = 0;
+    }
+    if (rc != SQLITE_OK)
+      break;
+  }
+  printf("\n  ]\n}\n");
+  sqlite3_close(db);
+  return rc == SQLITE_OK ? 0 : 1;
+}
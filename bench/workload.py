@@ -0,0 +1,241 @@
+"""
+End-to-end SQL workload benchmarks for sqlite-path.
+
+bench/bench.c times single function calls. This suite times the queries
+people actually run over file listings, so planner, virtual table and
+aggregation overhead show up too. For every table size it builds a synthetic
+`files(path)` table, then runs each query through the dist/sqlite3 CLI and
+through the loadable extension in Python's sqlite3 module. Every run is a
+fresh process, so its peak RSS can be read from wait4().
+
+Results are printed as JSON, one object per size, engine and query:
+
+  make bench-workload WORKLOAD_ARGS="--rows 1000000 --engine loadable"
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+QUERIES = {
+  # the README's extension histogram, over a table instead of fsdir()
+  "extension_histogram": """
+    select
+      path_extension(path),
+      count(*),
+      printf('%.*c', min(count(*), 40), '*') as bar
+    from files
+    where path_extension(path) is not null
+    group by 1
+    order by 2 desc
+    limit 6
+  """,
+  # the README's "deepest .c files under ext/". The monorepo profile puts
+  # ext/ second, as in core/ext/ and vendor/ext/, so this matches about 0.3%
+  # of rows (2827 of 1000000 with seed 42) and isn't timing an empty filter.
+  "deepest_under_ext": """
+    select
+      path,
+      path_length(path) as depth
+    from files
+    where
+      path_part_at(path, 1) == 'ext'
+      and path_extension(path) == '.c'
+    order by 2 desc
+    limit 5
+  """,
+  "path_parts_join": """
+    select parts.part, count(*)
+    from files, path_parts(files.path) as parts
+    group by 1
+    order by 2 desc
+    limit 10
+  """,
+  "path_parts_filter": """
+    select count(*)
+    from files, path_parts(files.path) as parts
+    where parts.part = 'node_modules'
+  """,
+  "directory_rollup": """
+    select path_dirname(path), count(*), sum(path_length(path))
+    from files
+    group by 1
+    order by 2 desc
+    limit 10
+  """,
+  # totals for every directory level, not just each row's parent
+  "ancestor_rollup": """
+    select a.prefix, count(*), sum(path_length(files.path))
+    from files, path_ancestors(files.path) as a
+    group by 1
+    order by 2 desc
+    limit 10
+  """,
+  # the same totals from one aggregate, without sorting the expanded rows
+  "path_rollup": """
+    select count(*) from json_each((
+      select path_rollup(path, path_length(path)) from files
+    ))
+  """,
+  # the directory tree a UI renders, built in SQLite instead of from flat rows
+  "path_tree": """
+    select length(path_tree(path)) from files
+  """,
+  # "everything under a directory", as a scan and from a path_trie
+  "under_scan": """
+    select count(*) from files where path_under(path, 'src/lib')
+  """,
+  "trie_count_under": """
+    select count from files_trie where path = 'src/lib'
+  """,
+  "trie_children": """
+    select name, count from files_trie where children = 'src' order by count desc
+  """,
+  # ancestry from a path_closure, instead of expanding every row's path_parts
+  "closure_descendants": """
+    select count(*) from files_closure where ancestor = 'src/lib'
+  """,
+  "closure_ancestors": """
+    select ancestor from files_closure
+    where descendant = (select max(path) from files) and depth > 0
+  """,
+  "path_join_insert": """
+    create temp table joined as
+    select path_join(path_dirname(path), 'build', path_name(path) || '.o') as path
+    from files
+  """,
+}
+
+# Deterministic file listing of `rows` paths, from path_synth's monorepo
+# profile, so the same size always builds the same table.
+BUILD_SQL = """
+  create table files(path text);
+  insert into files(path) select path from path_synth({rows}, 42, 'monorepo');
+"""
+
+# each only built when one of its queries runs, since they cost more than
+# the table
+INDEX_SQL = {
+  "trie_": "create virtual table files_trie using path_trie(files, path);\n",
+  "closure_": "create virtual table files_closure using path_closure(files, path);\n",
+}
+
+LOADABLE_CHILD = """
+import sqlite3, sys, time
+db = sqlite3.connect(sys.argv[1])
+db.enable_load_extension(True)
+db.load_extension(sys.argv[2])
+start = time.perf_counter()
+rows = db.execute(sys.argv[3]).fetchall()
+print(time.perf_counter() - start)
+"""
+
+def maxrss_kb(rusage):
+  # ru_maxrss is in kilobytes on Linux and bytes on macOS
+  if sys.platform == "darwin":
+    return rusage.ru_maxrss // 1024
+  return rusage.ru_maxrss
+
+def run_child(args, stdin=None):
+  """Runs args to completion, returning (stdout, peak RSS in KB)."""
+  # reaped with wait4() instead of Popen.wait(), for the child's rusage
+  with tempfile.TemporaryFile() as stderr:
+    proc = subprocess.Popen(
+      args,
+      stdin=subprocess.PIPE if stdin is not None else subprocess.DEVNULL,
+      stdout=subprocess.PIPE,
+      stderr=stderr,
+    )
+    if stdin is not None:
+      proc.stdin.write(stdin.encode("utf8"))
+      proc.stdin.close()
+    stdout = proc.stdout.read().decode("utf8")
+    _, status, rusage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+      stderr.seek(0)
+      raise RuntimeError(f"{args[0]} failed: {stderr.read().decode('utf8').strip()}")
+  return stdout, maxrss_kb(rusage)
+
+def run_loadable(db_path, extension, sql):
+  stdout, rss = run_child([sys.executable, "-c", LOADABLE_CHILD, db_path, extension, sql])
+  return float(stdout.strip()), rss
+
+def run_cli(db_path, cli, sql):
+  # the CLI times the statement itself, and the extension is compiled in
+  script = ".timer on\n.output /dev/null\n" + sql.strip() + ";\n"
+  stdout, rss = run_child([cli, db_path], stdin=script)
+  times = re.findall(r"Run Time: real ([0-9.]+)", stdout)
+  if not times:
+    raise RuntimeError(f"no timing in sqlite3 output: {stdout!r}")
+  return sum(float(t) for t in times), rss
+
+def build_database(db_path, extension, rows, queries):
+  sql = "pragma journal_mode=off;\npragma synchronous=off;\n" + BUILD_SQL.format(rows=rows)
+  for prefix, index_sql in INDEX_SQL.items():
+    if any(q.startswith(prefix) for q in queries):
+      sql += index_sql
+  child = (
+    "import sqlite3, sys\n"
+    "db = sqlite3.connect(sys.argv[1])\n"
+    "db.enable_load_extension(True)\n"
+    "db.load_extension(sys.argv[2])\n"
+    "db.executescript(sys.argv[3])\n"
+  )
+  run_child([sys.executable, "-c", child, db_path, extension, sql])
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.strip().split("\n")[0])
+  parser.add_argument("--rows", default="1000000,10000000,50000000",
+                      help="comma separated table sizes")
+  parser.add_argument("--engine", choices=["cli", "loadable", "both"], default="both")
+  parser.add_argument("--sqlite3", default="dist/sqlite3", help="sqlite3 CLI with sqlite-path built in")
+  parser.add_argument("--extension", default="dist/path0", help="loadable extension, without its suffix")
+  parser.add_argument("--query", action="append", choices=sorted(QUERIES), help="only run these queries")
+  parser.add_argument("--repeat", type=int, default=1, help="runs of each query, the fastest is reported")
+  parser.add_argument("--dir", default=None, help="where to build the databases, a temporary directory by default")
+  args = parser.parse_args()
+
+  engines = ["cli", "loadable"] if args.engine == "both" else [args.engine]
+  queries = args.query or list(QUERIES)
+  results = []
+
+  with tempfile.TemporaryDirectory(dir=args.dir) as tmp:
+    for rows in [int(r) for r in args.rows.split(",")]:
+      db_path = os.path.join(tmp, f"files-{rows}.db")
+      start = time.perf_counter()
+      build_database(db_path, args.extension, rows, queries)
+      print(f"built {rows} rows in {time.perf_counter() - start:.1f}s", file=sys.stderr)
+
+      for engine in engines:
+        for name in queries:
+          best = None
+          for _ in range(args.repeat):
+            if engine == "cli":
+              elapsed, rss = run_cli(db_path, args.sqlite3, QUERIES[name])
+            else:
+              elapsed, rss = run_loadable(db_path, args.extension, QUERIES[name])
+            if best is None or elapsed < best[0]:
+              best = (elapsed, rss)
+          elapsed, rss = best
+          results.append({
+            "query": name,
+            "engine": engine,
+            "rows": rows,
+            "seconds": round(elapsed, 6),
+            "rows_per_sec": round(rows / elapsed) if elapsed > 0 else None,
+            "peak_rss_kb": rss,
+          })
+          print(f"{rows} {engine} {name}: {elapsed:.3f}s", file=sys.stderr)
+      os.remove(db_path)
+
+  json.dump({"results": results}, sys.stdout, indent=2)
+  print()
+
+if __name__ == "__main__":
+  main()
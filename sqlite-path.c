@@ -5,9 +5,19 @@ SQLITE_EXTENSION_INIT1
 #include <ctype.h>
 #include <cwalk.h>
 #include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 #pragma region sqlite - path meta scalar functions
 
@@ -21,14 +31,17 @@ static void pathVersionFunc(sqlite3_context *context, int argc,
 
 /** path_debug()
  * Returns a debug string of various info about sqlite-path, including
- * the version string, build date, commit hash, and cwalk version.
+ * the version string, build date, commit hash, cwalk version and the byte
+ * scanning kernel in use.
  */
+static const char *pathScanName;
+
 static void pathDebugFunc(sqlite3_context *context, int argc,
                           sqlite3_value **arg) {
-  const char *debug =
-      sqlite3_mprintf("Version: %s\nDate: %s\nSource: %s\ncwalk version: %s",
-                      SQLITE_PATH_VERSION, SQLITE_PATH_DATE, SQLITE_PATH_SOURCE,
-                      SQLITE_PATH_CWALK_VERSION);
+  const char *debug = sqlite3_mprintf(
+      "Version: %s\nDate: %s\nSource: %s\ncwalk version: %s\nScan kernel: %s",
+      SQLITE_PATH_VERSION, SQLITE_PATH_DATE, SQLITE_PATH_SOURCE,
+      SQLITE_PATH_CWALK_VERSION, pathScanName);
   if (debug == NULL) {
     sqlite3_result_error_nomem(context);
     return;
@@ -39,399 +52,6526 @@ static void pathDebugFunc(sqlite3_context *context, int argc,
 
 #pragma endregion
 
-#pragma region sqlite - path scalar functions
+#pragma region sqlite - path byte scanning kernels
 
-/** path_absolute(path)
- * Returns 1 if the given path is absolute, 0 otherwise.
- *
- */
-static void pathAbsoluteFunc(sqlite3_context *context, int argc,
-                             sqlite3_value **argv) {
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_int(context, 0);
-    return;
+/*
+** On CPUs with vector units, the tokenizer doesn't look at a path
+** byte-by-byte. Instead a pathScan kernel turns up to PATH_SCAN_WINDOW bytes
+** into two bitmasks, one with a bit set for every separator and one for
+** every '.', 16 or 32 bytes per instruction. Segment boundaries, depth and
+** extensions then fall out of those masks with shifts, popcount and
+** count-trailing/leading-zeros.
+**
+** pathScan points to the widest kernel the CPU supports, picked once by
+** pathSelectKernels() when the extension is loaded. SSE2 and AVX2 kernels
+** are only built for x86 with GCC/clang. Everywhere else (ARM, WASM, MSVC)
+** pathScan stays NULL and the tokenizer falls back to a plain byte loop,
+** which beats building the masks one byte at a time.
+**
+** The SQLITE_PATH_SCAN environment variable caps the kernel at 'sse2' or
+** 'bytes' (no kernel), so tests can compare every kernel on one machine.
+*/
+
+/*
+** Run xInit once per process, however many threads load sqlite-path at the
+** same time. Callers see everything xInit wrote.
+*/
+#ifdef _WIN32
+typedef INIT_ONCE path_once;
+#define PATH_ONCE_INIT INIT_ONCE_STATIC_INIT
+
+static BOOL CALLBACK pathOnceCallback(PINIT_ONCE pOnce, PVOID pInit,
+                                      PVOID *pUnused) {
+  (void)pOnce;
+  (void)pUnused;
+  ((void (*)(void))pInit)();
+  return TRUE;
+}
+
+static void pathOnce(path_once *pOnce, void (*xInit)(void)) {
+  InitOnceExecuteOnce(pOnce, pathOnceCallback, (PVOID)xInit, NULL);
+}
+#else
+typedef pthread_once_t path_once;
+#define PATH_ONCE_INIT PTHREAD_ONCE_INIT
+
+static void pathOnce(path_once *pOnce, void (*xInit)(void)) {
+  pthread_once(pOnce, xInit);
+}
+#endif
+
+#define PATH_SCAN_WINDOW 256
+#define PATH_SCAN_WORDS (PATH_SCAN_WINDOW / 64)
+
+#if defined(__GNUC__)
+#define pathCtz64(x) __builtin_ctzll(x)
+#define pathClz64(x) __builtin_clzll(x)
+#define pathPopcount64(x) __builtin_popcountll(x)
+#else
+static int pathCtz64(sqlite3_uint64 x) {
+  int n = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    n++;
   }
-  sqlite3_result_int(
-      context, cwk_path_is_absolute((const char *)sqlite3_value_text(argv[0])));
+  return n;
 }
-/** path_basename(path)
- * Returns the basename of the given path as text,
- * or NULL if it cannot be calculated.
- */
-static void pathBasenameFunc(sqlite3_context *context, int argc,
-                             sqlite3_value **argv) {
-  const char *basename;
-  size_t length;
-  const char *path;
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
-    return;
+static int pathClz64(sqlite3_uint64 x) {
+  int n = 0;
+  while (!(x & ((sqlite3_uint64)1 << 63))) {
+    x <<= 1;
+    n++;
   }
-  path = (const char *)sqlite3_value_text(argv[0]);
-  cwk_path_get_basename(path, &basename, &length);
-  sqlite3_result_text(context, basename, length, SQLITE_TRANSIENT);
+  return n;
 }
+static int pathPopcount64(sqlite3_uint64 x) {
+  int n = 0;
+  for (; x; x &= x - 1)
+    n++;
+  return n;
+}
+#endif
 
-/** path_dirname(path)
- * Returns the dirname of the given path as text,
- * or NULL if it cannot be calculated.
- */
-static void pathDirnameFunc(sqlite3_context *context, int argc,
-                            sqlite3_value **argv) {
-  size_t length = 0;
-  const char *path;
+/*
+** Fill aSep and aDot with bitmasks of the n <= PATH_SCAN_WINDOW bytes at z.
+** Bit i of aSep is set when z[i] is sep1 or sep2, bit i of aDot when z[i] is
+** '.'. Bits past n are left clear.
+*/
+typedef void (*path_scan_fn)(const char *z, int n, char sep1, char sep2,
+                             sqlite3_uint64 *aSep, sqlite3_uint64 *aDot);
 
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
-    return;
-  }
-  path = (const char *)sqlite3_value_text(argv[0]);
-  cwk_path_get_dirname(path, &length);
-  if (length == 0) {
-    sqlite3_result_null(context);
-    return;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PATH_KERNELS_X86 1
+#include <immintrin.h>
+
+// only used for inputs shorter than one vector
+static void pathScanScalar(const char *z, int n, char sep1, char sep2,
+                           sqlite3_uint64 *aSep, sqlite3_uint64 *aDot) {
+  memset(aSep, 0, PATH_SCAN_WORDS * sizeof(sqlite3_uint64));
+  memset(aDot, 0, PATH_SCAN_WORDS * sizeof(sqlite3_uint64));
+  for (int i = 0; i < n; i++) {
+    aSep[i >> 6] |= (sqlite3_uint64)(z[i] == sep1 || z[i] == sep2) << (i & 63);
+    aDot[i >> 6] |= (sqlite3_uint64)(z[i] == '.') << (i & 63);
   }
-  sqlite3_result_text(context, path, length, SQLITE_TRANSIENT);
 }
 
-/** path_extension(path)
- * Returns the extension of the given path as text,
- * or NULL if it cannot be calculated.
- */
-static void pathExtensionFunc(sqlite3_context *context, int argc,
-                              sqlite3_value **argv) {
-  const char *extension;
-  size_t length = 0;
-  const char *path;
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
+/*
+** Both x86 kernels handle a partial last vector by re-loading the last full
+** vector of the input, which overlaps bytes already scanned, and shifting
+** away the overlap. Inputs shorter than one vector go through the scalar
+** kernel, so nothing is ever read past z[n-1].
+*/
+
+__attribute__((target("sse2"))) static void
+pathScanSse2(const char *z, int n, char sep1, char sep2, sqlite3_uint64 *aSep,
+             sqlite3_uint64 *aDot) {
+  const __m128i v1 = _mm_set1_epi8(sep1);
+  const __m128i v2 = _mm_set1_epi8(sep2);
+  const __m128i vDot = _mm_set1_epi8('.');
+  int i = 0;
+  if (n < 16) {
+    pathScanScalar(z, n, sep1, sep2, aSep, aDot);
     return;
   }
-  path = (const char *)sqlite3_value_text(argv[0]);
-  cwk_path_get_extension(path, &extension, &length);
-  if (length == 0) {
-    sqlite3_result_null(context);
-    return;
+  memset(aSep, 0, PATH_SCAN_WORDS * sizeof(sqlite3_uint64));
+  memset(aDot, 0, PATH_SCAN_WORDS * sizeof(sqlite3_uint64));
+  for (; i < n; i += 16) {
+    int shift = i + 16 <= n ? 0 : i + 16 - n;
+    __m128i v = _mm_loadu_si128((const __m128i *)(z + i - shift));
+    unsigned sep = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)));
+    unsigned dot = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vDot));
+    aSep[i >> 6] |= (sqlite3_uint64)(sep >> shift) << (i & 63);
+    aDot[i >> 6] |= (sqlite3_uint64)(dot >> shift) << (i & 63);
   }
-  sqlite3_result_text(context, extension, length, SQLITE_TRANSIENT);
 }
 
-/** path_name(path)
- * Returns the name of the given path as text,
- * or NULL if it cannot be calculated.
- */
-static void pathNameFunc(sqlite3_context *context, int argc,
-                         sqlite3_value **argv) {
-  const char *path;
-  struct cwk_segment segment;
-  const char *c;
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
+__attribute__((target("avx2"))) static void
+pathScanAvx2(const char *z, int n, char sep1, char sep2, sqlite3_uint64 *aSep,
+             sqlite3_uint64 *aDot) {
+  const __m256i v1 = _mm256_set1_epi8(sep1);
+  const __m256i v2 = _mm256_set1_epi8(sep2);
+  const __m256i vDot = _mm256_set1_epi8('.');
+  int i = 0;
+  if (n < 32) {
+    pathScanSse2(z, n, sep1, sep2, aSep, aDot);
     return;
   }
+  memset(aSep, 0, PATH_SCAN_WORDS * sizeof(sqlite3_uint64));
+  memset(aDot, 0, PATH_SCAN_WORDS * sizeof(sqlite3_uint64));
+  for (; i < n; i += 32) {
+    int shift = i + 32 <= n ? 0 : i + 32 - n;
+    __m256i v = _mm256_loadu_si256((const __m256i *)(z + i - shift));
+    unsigned sep = (unsigned)_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, v1), _mm256_cmpeq_epi8(v, v2)));
+    unsigned dot = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vDot));
+    aSep[i >> 6] |= (sqlite3_uint64)(sep >> shift) << (i & 63);
+    aDot[i >> 6] |= (sqlite3_uint64)(dot >> shift) << (i & 63);
+  }
+}
+#endif
 
-  path = (const char *)sqlite3_value_text(argv[0]);
+static path_scan_fn pathScan = NULL;
+static const char *pathScanName = "bytes";
 
-  if (!cwk_path_get_last_segment(path, &segment)) {
-    sqlite3_result_null(context);
-    return;
+static void pathSelectKernelsOnce(void) {
+#ifdef PATH_KERNELS_X86
+  const char *zCap = getenv("SQLITE_PATH_SCAN");
+  int bAvx2 = zCap == NULL || strcmp(zCap, "avx2") == 0;
+  int bSse2 = bAvx2 || strcmp(zCap, "sse2") == 0;
+  __builtin_cpu_init();
+  if (bAvx2 && __builtin_cpu_supports("avx2")) {
+    pathScan = pathScanAvx2;
+    pathScanName = "avx2";
+  } else if (bSse2 && __builtin_cpu_supports("sse2")) {
+    pathScan = pathScanSse2;
+    pathScanName = "sse2";
   }
+#endif
+}
 
-  for (c = segment.begin; c <= segment.end; ++c) {
+/*
+** Point pathScan at the best kernel for the current CPU, if any. Only the
+** first call picks one, so connections opening on other threads never see
+** pathScan change while they may be calling it.
+*/
+static void pathSelectKernels(void) {
+  static path_once once = PATH_ONCE_INIT;
+  pathOnce(&once, pathSelectKernelsOnce);
+}
 
-    if (*c == '.') {
-      // hidden files!
-      if (c == segment.begin) {
-        continue;
-      }
-      sqlite3_result_text(context, segment.begin, c - segment.begin,
-                          SQLITE_TRANSIENT);
-      return;
+/*
+** Offset of the first/last set bit of aMask in [lo, hi), or -1 if none.
+*/
+static int pathMaskFirst(const sqlite3_uint64 *aMask, int lo, int hi) {
+  for (int w = lo >> 6; w <= (hi - 1) >> 6 && lo < hi; w++) {
+    sqlite3_uint64 m = aMask[w];
+    if (w == lo >> 6)
+      m &= ~(sqlite3_uint64)0 << (lo & 63);
+    if (m) {
+      int at = (w << 6) + pathCtz64(m);
+      return at < hi ? at : -1;
     }
   }
+  return -1;
+}
 
-  // at this point, the last segment doesn't have an extension, so the
-  // name is just the entire segment
-  sqlite3_result_text(context, segment.begin, segment.end - segment.begin,
-                      SQLITE_TRANSIENT);
-  return;
+static int pathMaskLast(const sqlite3_uint64 *aMask, int lo, int hi) {
+  for (int w = (hi - 1) >> 6; w >= lo >> 6 && lo < hi; w--) {
+    sqlite3_uint64 m = aMask[w];
+    if (w == (hi - 1) >> 6 && (hi & 63))
+      m &= ~(~(sqlite3_uint64)0 << (hi & 63));
+    if (m) {
+      int at = (w << 6) + 63 - pathClz64(m);
+      return at >= lo ? at : -1;
+    }
+  }
+  return -1;
 }
 
-/** path_intersection(path)
- * Returns the common portions between two paths, or null if it cannot be
- * computed.
- *
- */
-static void pathIntersectionFunc(sqlite3_context *context, int argc,
-                                 sqlite3_value **argv) {
-  char result[FILENAME_MAX];
+#pragma endregion
 
-  const char *base;
-  const char *other;
-  size_t length;
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL ||
-      sqlite3_value_type(argv[1]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
-    return;
+#pragma region sqlite - path tokenizer
+
+/*
+** Every path function works off of a path_parsed, which is filled in by a
+** single forward scan over the path's bytes. Segments are stored as a
+** struct-of-arrays of byte offsets, sizes and types, so random access like
+** path_part_at(p, -1) is a constant time lookup after the scan.
+**
+** The arrays live inline in the path_parsed (so on the stack for callers that
+** declare one locally) and only move to the heap for paths deeper than
+** PATH_SEGMENTS_INLINE segments. Since aBegin/aSize/aType can point into the
+** struct itself, a path_parsed must never be copied with memcpy.
+*/
+
+#define PATH_SEGMENTS_INLINE 32
+
+typedef struct path_parsed path_parsed;
+struct path_parsed {
+  // length of the root portion of the path, ex "/" for absolute paths
+  int nRoot;
+  // whether the path is absolute, its root ends with a separator
+  int absolute;
+  // number of segments in the path
+  int nSegment;
+  // capacity of aBegin, aSize and aType
+  int nAlloc;
+  // byte offset where each segment begins
+  int *aBegin;
+  // byte size of each segment
+  int *aSize;
+  // enum cwk_segment_type of each segment
+  unsigned char *aType;
+  // byte offset of the last segment's extension, only valid if nExtension > 0
+  int iExtension;
+  // size of the last segment's extension, 0 if there is none
+  int nExtension;
+  // size of the last segment's name, the segment without its extension
+  int nName;
+
+  int aBeginInline[PATH_SEGMENTS_INLINE];
+  int aSizeInline[PATH_SEGMENTS_INLINE];
+  unsigned char aTypeInline[PATH_SEGMENTS_INLINE];
+};
+
+static void pathParsedInit(path_parsed *p) {
+  p->nRoot = 0;
+  p->absolute = 0;
+  p->nSegment = 0;
+  p->nAlloc = PATH_SEGMENTS_INLINE;
+  p->aBegin = p->aBeginInline;
+  p->aSize = p->aSizeInline;
+  p->aType = p->aTypeInline;
+  p->iExtension = 0;
+  p->nExtension = 0;
+  p->nName = 0;
+}
+
+static void pathParsedFree(path_parsed *p) {
+  if (p->aBegin != p->aBeginInline) {
+    sqlite3_free(p->aBegin);
+    sqlite3_free(p->aSize);
+    sqlite3_free(p->aType);
   }
+  pathParsedInit(p);
+}
 
-  base = (const char *)sqlite3_value_text(argv[0]);
-  other = (const char *)sqlite3_value_text(argv[1]);
-  length = cwk_path_get_intersection(base, other);
+/*
+** Grow the segment arrays of p onto the heap, doubling their capacity.
+*/
+static int pathParsedGrow(path_parsed *p) {
+  sqlite3_int64 nNew = (sqlite3_int64)p->nAlloc * 2;
+  int *aBegin = sqlite3_malloc64(nNew * sizeof(int));
+  int *aSize = sqlite3_malloc64(nNew * sizeof(int));
+  unsigned char *aType = sqlite3_malloc64(nNew);
+  if (aBegin == NULL || aSize == NULL || aType == NULL) {
+    sqlite3_free(aBegin);
+    sqlite3_free(aSize);
+    sqlite3_free(aType);
+    return SQLITE_NOMEM;
+  }
+  // the tokenizer can have the beginning of one more segment than
+  // nSegment stored, so the full capacity is copied over
+  memcpy(aBegin, p->aBegin, p->nAlloc * sizeof(int));
+  memcpy(aSize, p->aSize, p->nAlloc * sizeof(int));
+  memcpy(aType, p->aType, p->nAlloc);
+  if (p->aBegin != p->aBeginInline) {
+    sqlite3_free(p->aBegin);
+    sqlite3_free(p->aSize);
+    sqlite3_free(p->aType);
+  }
+  p->aBegin = aBegin;
+  p->aSize = aSize;
+  p->aType = aType;
+  p->nAlloc = (int)nNew;
+  return SQLITE_OK;
+}
 
-  if (length == 0) {
-    sqlite3_result_null(context);
-    return;
+/*
+** Fill in the type of every segment of p, once their offsets are known.
+*/
+static void pathClassifySegments(const char *zPath, path_parsed *p) {
+  for (int i = 0; i < p->nSegment; i++) {
+    const char *z = zPath + p->aBegin[i];
+    if (z[0] != '.' || p->aSize[i] > 2)
+      p->aType[i] = CWK_NORMAL;
+    else if (p->aSize[i] == 1)
+      p->aType[i] = CWK_CURRENT;
+    else
+      p->aType[i] = z[1] == '.' ? CWK_BACK : CWK_NORMAL;
   }
+}
 
-  sqlite3_result_text(context, base, length, SQLITE_TRANSIENT);
+/*
+** Find the name and extension spans of the last segment of p. The
+** extension starts at its last '.', and its name ends at the first '.'
+** that isn't a hidden file prefix.
+*/
+static void pathFindNameExtension(const char *zPath, path_parsed *p) {
+  int last = p->nSegment - 1;
+  int begin = p->aBegin[last];
+  int end = begin + p->aSize[last];
+  int i;
+  for (i = end - 1; i >= begin; i--) {
+    if (zPath[i] == '.') {
+      p->iExtension = i;
+      p->nExtension = end - i;
+      break;
+    }
+  }
+  p->nName = p->aSize[last];
+  for (i = begin + 1; i < end; i++) {
+    if (zPath[i] == '.') {
+      p->nName = i - begin;
+      break;
+    }
+  }
 }
 
-/** path_join(path1, path2, [...pathN])
- * Join two or more paths together, or null if it cannot be computed.
- */
-static void pathJoinFunc(sqlite3_context *context, int argc,
-                         sqlite3_value **argv) {
-  char buffer[FILENAME_MAX];
-  char *ptr;
-  size_t size;
+/*
+** Paths are parsed in either unix or windows style, like cwalk's
+** CWK_STYLE_UNIX and CWK_STYLE_WINDOWS. Unix paths only have '/' separators
+** and a "/" root. Windows paths also separate on '\\', and can have drive
+** ("C:", "C:\\"), UNC ("\\\\server\\share\\") and device ("\\\\?\\")
+** roots.
+**
+** The tokenizer below is written once against an eStyle parameter, and
+** compiled into one copy per style (pathTokenizeUnix, pathTokenizeWindows)
+** with eStyle a constant, so the scan loops never branch on the style.
+** Functions reach the right copy through the path_style their registration
+** carries as user data.
+*/
 
-  if (argc < 2) {
-    sqlite3_result_error(context, "at least 2 paths are required for path_join",
-                         -1);
-    return;
+#define PATH_STYLE_UNIX 0
+#define PATH_STYLE_WINDOWS 1
+
+#if defined(__GNUC__)
+#define PATH_ALWAYS_INLINE __attribute__((always_inline)) inline
+#elif defined(_MSC_VER)
+#define PATH_ALWAYS_INLINE __forceinline
+#else
+#define PATH_ALWAYS_INLINE inline
+#endif
+
+#define pathIsSeparator(eStyle, c)                                             \
+  ((c) == '/' || ((eStyle) == PATH_STYLE_WINDOWS && (c) == '\\'))
+
+/*
+** Length of the root of a windows path, following cwalk.
+*/
+static int pathWindowsRoot(const char *zPath, int nPath) {
+  int i;
+  if (nPath >= 2 && isalpha((unsigned char)zPath[0]) && zPath[1] == ':')
+    return nPath > 2 && pathIsSeparator(PATH_STYLE_WINDOWS, zPath[2]) ? 3 : 2;
+  if (nPath == 0 || !pathIsSeparator(PATH_STYLE_WINDOWS, zPath[0]))
+    return 0;
+  if (nPath == 1 || !pathIsSeparator(PATH_STYLE_WINDOWS, zPath[1]))
+    return 1;
+  // device paths, "\\\\?\\" and "\\\\.\\"
+  if (nPath >= 4 && (zPath[2] == '?' || zPath[2] == '.') &&
+      pathIsSeparator(PATH_STYLE_WINDOWS, zPath[3]))
+    return 4;
+  // UNC paths, "\\\\server\\share\\"
+  i = 2;
+  for (int part = 0; part < 2; part++) {
+    while (i < nPath && !pathIsSeparator(PATH_STYLE_WINDOWS, zPath[i]))
+      i++;
+    if (i < nPath)
+      i++;
   }
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
-    return;
+  return i;
+}
+
+/*
+** Tokenizer for when there's no vector kernel, one byte at a time.
+*/
+static PATH_ALWAYS_INLINE int pathTokenizeBytes(const char *zPath, int nPath,
+                                                path_parsed *p, int eStyle) {
+  int i = p->nRoot, begin;
+  while (1) {
+    while (i < nPath && pathIsSeparator(eStyle, zPath[i]))
+      i++;
+    if (i == nPath)
+      break;
+    begin = i;
+    while (i < nPath && !pathIsSeparator(eStyle, zPath[i]))
+      i++;
+    if (p->nSegment == p->nAlloc && pathParsedGrow(p) != SQLITE_OK)
+      return SQLITE_NOMEM;
+    p->aBegin[p->nSegment] = begin;
+    p->aSize[p->nSegment] = i - begin;
+    p->nSegment++;
+  }
+  pathClassifySegments(zPath, p);
+  if (p->nSegment > 0)
+    pathFindNameExtension(zPath, p);
+  return SQLITE_OK;
+}
+
+/*
+** Tokenizer on top of the pathScan masks. With `other` as the mask of
+** non-separator bytes in a 64 byte word, segments begin on the bits of
+** `other & ~(other << 1)` and end on the bits of `~other & (other << 1)`,
+** so each word costs one loop iteration per segment boundary, and
+** popcount sizes the segment arrays up front.
+*/
+static PATH_ALWAYS_INLINE int pathTokenizeMasked(const char *zPath, int nPath,
+                                                 path_parsed *p, int eStyle) {
+  sqlite3_uint64 aSep[PATH_SCAN_WORDS];
+  sqlite3_uint64 aDot[PATH_SCAN_WORDS];
+  // whether the byte before the current word is part of a segment
+  sqlite3_uint64 carry = 0;
+  // number of segments whose beginning has been found, which is one ahead
+  // of p->nSegment while the scan is inside of a segment
+  int nBegin = 0;
+  int iWindow, nWindow, begin, end, last, i;
+
+  for (iWindow = p->nRoot; iWindow < nPath; iWindow += PATH_SCAN_WINDOW) {
+    nWindow = nPath - iWindow;
+    if (nWindow > PATH_SCAN_WINDOW)
+      nWindow = PATH_SCAN_WINDOW;
+    pathScan(zPath + iWindow, nWindow, '/',
+             eStyle == PATH_STYLE_WINDOWS ? '\\' : '/', aSep, aDot);
+
+    for (int w = 0; w * 64 < nWindow; w++) {
+      int n = nWindow - w * 64;
+      int at = iWindow + w * 64;
+      sqlite3_uint64 valid =
+          n >= 64 ? ~(sqlite3_uint64)0 : (((sqlite3_uint64)1 << n) - 1);
+      sqlite3_uint64 other = ~aSep[w] & valid;
+      sqlite3_uint64 prev = (other << 1) | carry;
+      sqlite3_uint64 begins = other & ~prev;
+      sqlite3_uint64 ends = ~other & prev & valid;
+
+      while (nBegin + pathPopcount64(begins) > p->nAlloc) {
+        if (pathParsedGrow(p) != SQLITE_OK)
+          return SQLITE_NOMEM;
+      }
+      for (; begins; begins &= begins - 1)
+        p->aBegin[nBegin++] = at + pathCtz64(begins);
+      for (; ends; ends &= ends - 1) {
+        p->aSize[p->nSegment] = at + pathCtz64(ends) - p->aBegin[p->nSegment];
+        p->nSegment++;
+      }
+      carry = other >> 63;
+    }
+  }
+  if (nBegin > p->nSegment) {
+    p->aSize[p->nSegment] = nPath - p->aBegin[p->nSegment];
+    p->nSegment++;
   }
 
-  size = 0;
-  ptr = (char *)sqlite3_value_text(argv[0]);
-  for (int i = 1; i < argc; i++) {
-    size_t n;
-    const char *b = (const char *)sqlite3_value_text(argv[i]);
-    n = cwk_path_join(ptr, b, buffer, sizeof(buffer));
-    size = n;
-    ptr = buffer;
-    buffer[size] = 0;
+  pathClassifySegments(zPath, p);
+  if (p->nSegment == 0)
+    return SQLITE_OK;
+
+  // The last segment is almost always inside the last scanned window,
+  // so its dots are already in aDot.
+  last = p->nSegment - 1;
+  begin = p->aBegin[last];
+  end = begin + p->aSize[last];
+  iWindow -= PATH_SCAN_WINDOW;
+  if (begin < iWindow) {
+    pathFindNameExtension(zPath, p);
+    return SQLITE_OK;
+  }
+  i = pathMaskLast(aDot, begin - iWindow, end - iWindow);
+  if (i >= 0) {
+    p->iExtension = iWindow + i;
+    p->nExtension = end - p->iExtension;
   }
-  sqlite3_result_text(context, buffer, size, SQLITE_TRANSIENT);
+  i = pathMaskFirst(aDot, begin + 1 - iWindow, end - iWindow);
+  p->nName = i >= 0 ? iWindow + i - begin : p->aSize[last];
+  return SQLITE_OK;
 }
 
-/** path_normalize(path)
- * Create a normalized version of the given path (resolving back segments),
- * or null if it cannot be computed.
- */
-static void pathNormalizeFunc(sqlite3_context *context, int argc,
-                              sqlite3_value **argv) {
-  char result[FILENAME_MAX];
-  const char *path;
-  int length;
-  size_t size;
+/*
+** Tokenize the nPath bytes at zPath into p, in a single pass. The root,
+** every segment's offset/size/type, and the last segment's name and
+** extension spans are recorded. Consecutive separators are treated as one,
+** matching cwalk. Returns SQLITE_NOMEM if a deep path's segment arrays
+** could not be grown, SQLITE_OK otherwise. Heap storage from a previous
+** call is reused.
+*/
+static PATH_ALWAYS_INLINE int pathTokenizeStyle(const char *zPath, int nPath,
+                                                path_parsed *p, int eStyle) {
+  p->nSegment = 0;
+  p->iExtension = 0;
+  p->nExtension = 0;
+  p->nName = 0;
+  if (eStyle == PATH_STYLE_WINDOWS)
+    p->nRoot = pathWindowsRoot(zPath, nPath);
+  else
+    p->nRoot = (nPath > 0 && zPath[0] == '/') ? 1 : 0;
+  p->absolute =
+      p->nRoot > 0 && pathIsSeparator(eStyle, zPath[p->nRoot - 1]);
+  if (pathScan)
+    return pathTokenizeMasked(zPath, nPath, p, eStyle);
+  return pathTokenizeBytes(zPath, nPath, p, eStyle);
+}
 
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
+static int pathTokenizeUnix(const char *zPath, int nPath, path_parsed *p) {
+  return pathTokenizeStyle(zPath, nPath, p, PATH_STYLE_UNIX);
+}
+
+static int pathTokenizeWindows(const char *zPath, int nPath, path_parsed *p) {
+  return pathTokenizeStyle(zPath, nPath, p, PATH_STYLE_WINDOWS);
+}
+
+/*
+** Everything about a path style that path functions need, passed to them
+** through their registration.
+*/
+typedef struct path_style path_style;
+struct path_style {
+  // PATH_STYLE_UNIX or PATH_STYLE_WINDOWS
+  int eStyle;
+  // prefix of the names of the functions and modules of this style
+  const char *zPrefix;
+  // separator written between the segments of a path that's built
+  char cSeparator;
+  // compare n bytes of two segments or roots, memcmp() style
+  int (*xCompare)(const char *a, const char *b, int n);
+  int (*xTokenize)(const char *zPath, int nPath, path_parsed *p);
+};
+
+static int pathCompareUnix(const char *a, const char *b, int n) {
+  return memcmp(a, b, n);
+}
+
+/*
+** Windows paths compare ASCII case-insensitively, and '/' equal to '\\'.
+*/
+static int pathCompareWindows(const char *a, const char *b, int n) {
+  for (int i = 0; i < n; i++) {
+    int ca = tolower((unsigned char)(a[i] == '\\' ? '/' : a[i]));
+    int cb = tolower((unsigned char)(b[i] == '\\' ? '/' : b[i]));
+    if (ca != cb)
+      return ca - cb;
+  }
+  return 0;
+}
+
+static const path_style pathStyleUnix = {PATH_STYLE_UNIX, "path_", '/',
+                                         pathCompareUnix, pathTokenizeUnix};
+static const path_style pathStyleWindows = {PATH_STYLE_WINDOWS, "path_win_",
+                                            '\\', pathCompareWindows,
+                                            pathTokenizeWindows};
+
+static int pathTokenize(const path_style *pStyle, const char *zPath, int nPath,
+                        path_parsed *p) {
+  return pStyle->xTokenize(zPath, nPath, p);
+}
+
+#pragma endregion
+
+#pragma region sqlite - path stats
+
+/*
+** Opt-in instrumentation, read through the path_stats table. Stats are off
+** unless sqlite-path is compiled with SQLITE_PATH_ENABLE_STATS, or turned on
+** at runtime with path_config('stats', 1).
+**
+** Each thread counts into its own path_stats_thread, so counting never
+** contends on a lock or a shared cache line. A thread's block is linked into
+** pathStatsThreads the first time it counts anything. When the thread exits,
+** its counts are folded into pathStatsRetired and the block is freed; the
+** blocks of threads still alive are freed when sqlite-path is unloaded.
+** pathStatsMutex guards the list, so path_stats can sum it while threads come
+** and go. Counts read while another thread is mid-call may be off by that
+** call.
+*/
+
+#if defined(_MSC_VER)
+#define PATH_THREAD_LOCAL __declspec(thread)
+#else
+#define PATH_THREAD_LOCAL __thread
+#endif
+
+// functions a style can register, with a set of counters each
+#define PATH_MAX_FUNCTIONS 32
+// counters of the path_parts xFilter and xNext methods, per style
+#define PATH_STATS_PARTS_FILTER (2 * PATH_MAX_FUNCTIONS)
+#define PATH_STATS_PARTS_NEXT (PATH_STATS_PARTS_FILTER + 2)
+#define PATH_STATS_SLOTS (PATH_STATS_PARTS_NEXT + 2)
+
+typedef struct path_stats_counters path_stats_counters;
+struct path_stats_counters {
+  sqlite3_int64 nCall;
+  sqlite3_int64 nBytesIn;
+  sqlite3_int64 nBytesOut;
+  sqlite3_int64 nNull;
+  sqlite3_int64 nNs;
+  sqlite3_int64 nCacheHit;
+  sqlite3_int64 nCacheMiss;
+};
+
+typedef struct path_stats_thread path_stats_thread;
+struct path_stats_thread {
+  path_stats_thread *pNext;
+  path_stats_counters aSlot[PATH_STATS_SLOTS];
+};
+
+#ifdef SQLITE_PATH_ENABLE_STATS
+static int pathStatsEnabled = 1;
+#else
+static int pathStatsEnabled = 0;
+#endif
+
+static path_stats_thread *pathStatsThreads;
+// counts of the threads that have exited, guarded by pathStatsMutex
+static path_stats_counters pathStatsRetired[PATH_STATS_SLOTS];
+static PATH_THREAD_LOCAL path_stats_thread *pathStatsThread;
+// counters of the scalar function the current thread is running, if any
+static PATH_THREAD_LOCAL path_stats_counters *pathStatsCurrent;
+
+static sqlite3_int64 pathStatsNow(void) {
+#ifdef _WIN32
+  LARGE_INTEGER now, frequency;
+  QueryPerformanceCounter(&now);
+  QueryPerformanceFrequency(&frequency);
+  return (sqlite3_int64)((double)now.QuadPart * 1e9 / frequency.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (sqlite3_int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/*
+** pathStatsMutex guards pathStatsThreads and pathStatsRetired. It's private
+** to sqlite-path, and statically initialized so it needs no setup or
+** teardown.
+*/
+#ifdef _WIN32
+static SRWLOCK pathStatsMutex = SRWLOCK_INIT;
+static void pathStatsLock(void) { AcquireSRWLockExclusive(&pathStatsMutex); }
+static void pathStatsUnlock(void) { ReleaseSRWLockExclusive(&pathStatsMutex); }
+#else
+static pthread_mutex_t pathStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+static void pathStatsLock(void) { pthread_mutex_lock(&pathStatsMutex); }
+static void pathStatsUnlock(void) { pthread_mutex_unlock(&pathStatsMutex); }
+#endif
+
+static void pathStatsAdd(path_stats_counters *pTotal,
+                         const path_stats_counters *pSlot) {
+  pTotal->nCall += pSlot->nCall;
+  pTotal->nBytesIn += pSlot->nBytesIn;
+  pTotal->nBytesOut += pSlot->nBytesOut;
+  pTotal->nNull += pSlot->nNull;
+  pTotal->nNs += pSlot->nNs;
+  pTotal->nCacheHit += pSlot->nCacheHit;
+  pTotal->nCacheMiss += pSlot->nCacheMiss;
+}
+
+/*
+** Fold the counts of an exiting thread into pathStatsRetired, then unlink and
+** free its block. Blocks are allocated with malloc() rather than
+** sqlite3_malloc(), since they can be freed after sqlite3_shutdown().
+*/
+static void pathStatsThreadExit(void *pArg) {
+  path_stats_thread *p = pArg;
+  path_stats_thread **pp;
+  if (p == NULL)
     return;
+  pathStatsLock();
+  for (pp = &pathStatsThreads; *pp; pp = &(*pp)->pNext) {
+    if (*pp == p) {
+      *pp = p->pNext;
+      break;
+    }
   }
-  path = (const char *)sqlite3_value_text(argv[0]);
-  size = cwk_path_normalize(path, result, sizeof(result));
+  for (int i = 0; i < PATH_STATS_SLOTS; i++)
+    pathStatsAdd(&pathStatsRetired[i], &p->aSlot[i]);
+  pathStatsUnlock();
+  free(p);
+}
 
-  sqlite3_result_text(context, result, size, SQLITE_TRANSIENT);
+/*
+** Free the blocks of every thread still alive, when sqlite-path is unloaded.
+** A loadable extension can be unloaded while its threads live on, so thread
+** exits must not call back into it afterwards: the pthread key is deleted,
+** and on Windows DllMain stops being called.
+*/
+static void pathStatsUnload(void) {
+  path_stats_thread *p, *pNext;
+  pathStatsLock();
+  for (p = pathStatsThreads; p; p = pNext) {
+    pNext = p->pNext;
+    free(p);
+  }
+  pathStatsThreads = NULL;
+  pathStatsUnlock();
 }
 
-// TODO path_name(path), "a.txt" -> "a", "d.tar.gz" -> "d" etc.
+#ifdef _WIN32
+#ifndef SQLITE_CORE
+BOOL WINAPI DllMain(HINSTANCE hInstance, DWORD dwReason, LPVOID pReserved) {
+  (void)hInstance;
+  if (dwReason == DLL_THREAD_DETACH) {
+    pathStatsThreadExit(pathStatsThread);
+    pathStatsThread = NULL;
+  } else if (dwReason == DLL_PROCESS_DETACH && pReserved == NULL) {
+    // pReserved is NULL on FreeLibrary(), not on process exit
+    pathStatsUnload();
+  }
+  return TRUE;
+}
+#endif
+static void pathStatsRegister(path_stats_thread *p) { (void)p; }
+#else
+static pthread_key_t pathStatsKey;
+static int pathStatsKeyOk = 0;
+
+static void pathStatsKeyInit(void) {
+  pathStatsKeyOk = pthread_key_create(&pathStatsKey, pathStatsThreadExit) == 0;
+}
+
+// have pathStatsThreadExit() called on p when the current thread exits
+static void pathStatsRegister(path_stats_thread *p) {
+  static path_once once = PATH_ONCE_INIT;
+  pathOnce(&once, pathStatsKeyInit);
+  if (pathStatsKeyOk)
+    pthread_setspecific(pathStatsKey, p);
+}
+
+#if !defined(SQLITE_CORE) && defined(__GNUC__)
+__attribute__((destructor)) static void pathStatsDestructor(void) {
+  if (pathStatsKeyOk)
+    pthread_key_delete(pathStatsKey);
+  pathStatsUnload();
+}
+#endif
+#endif
+
+/*
+** The current thread's counters for the given slot, or NULL on an OOM.
+*/
+static path_stats_counters *pathStatsSlot(int iSlot) {
+  if (pathStatsThread == NULL) {
+    path_stats_thread *p = calloc(1, sizeof(*p));
+    if (p == NULL)
+      return NULL;
+    pathStatsLock();
+    p->pNext = pathStatsThreads;
+    pathStatsThreads = p;
+    pathStatsUnlock();
+    pathStatsRegister(p);
+    pathStatsThread = p;
+  }
+  return &pathStatsThread->aSlot[iSlot];
+}
+
+/*
+** Add the counters of every thread, live or exited, for the given slot into
+** pTotal.
+*/
+static void pathStatsSum(int iSlot, path_stats_counters *pTotal) {
+  pathStatsLock();
+  *pTotal = pathStatsRetired[iSlot];
+  for (path_stats_thread *p = pathStatsThreads; p; p = p->pNext)
+    pathStatsAdd(pTotal, &p->aSlot[iSlot]);
+  pathStatsUnlock();
+}
+
+/*
+** Optional USDT probes for bpftrace, perf and SystemTap, compiled in with
+** SQLITE_PATH_ENABLE_SDT (`make loadable SDT=1`). A probe is a single nop
+** until a tracer attaches to it, and each one has a semaphore the tracer
+** increments while attached, so arguments that cost something to compute
+** are only computed while someone is listening. Without the flag every
+** probe compiles to nothing.
+**
+**   function_entry(name, style, bytes_in)
+**   function_return(name, style, bytes_in, bytes_out)
+**     around every scalar function. name is the function's name without its
+**     style prefix, style is 0 for unix and 1 for windows, bytes_in is the
+**     size of its TEXT and BLOB arguments and bytes_out the size of its TEXT
+**     or BLOB result, 0 for other results and -1 for NULL.
+**   parts_filter_entry(style)
+**   parts_filter_return(style, bytes_in, rc)
+**   parts_next(style, rowid, rc)
+**   parts_close(style)
+**     the path_parts cursor methods, bytes_in being the size of every path
+**     the scan was given.
+*/
+#ifdef SQLITE_PATH_ENABLE_SDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define PATH_PROBE_SEMAPHORE(name)                                             \
+  static unsigned short sqlite_path_##name##_semaphore                         \
+      __attribute__((used, section(".probes")))
+#define PATH_PROBE_ENABLED(name)                                               \
+  __builtin_expect(sqlite_path_##name##_semaphore != 0, 0)
+#define PATH_PROBE1(name, a) STAP_PROBE1(sqlite_path, name, a)
+#define PATH_PROBE3(name, a, b, c) STAP_PROBE3(sqlite_path, name, a, b, c)
+#define PATH_PROBE4(name, a, b, c, d) STAP_PROBE4(sqlite_path, name, a, b, c, d)
+
+PATH_PROBE_SEMAPHORE(function_entry);
+PATH_PROBE_SEMAPHORE(function_return);
+PATH_PROBE_SEMAPHORE(parts_filter_entry);
+PATH_PROBE_SEMAPHORE(parts_filter_return);
+PATH_PROBE_SEMAPHORE(parts_next);
+PATH_PROBE_SEMAPHORE(parts_close);
+
+// bytes_out of the scalar function the current thread is running
+static PATH_THREAD_LOCAL sqlite3_int64 pathProbeBytesOut;
+#define PATH_PROBE_BYTES_OUT(n) (pathProbeBytesOut = (n))
+#else
+#define PATH_PROBE_ENABLED(name) 0
+#define PATH_PROBE1(name, a)
+#define PATH_PROBE3(name, a, b, c)
+#define PATH_PROBE4(name, a, b, c, d)
+#define PATH_PROBE_BYTES_OUT(n)
+#endif
+
+static void pathStatsReset(void) {
+  pathStatsLock();
+  memset(pathStatsRetired, 0, sizeof(pathStatsRetired));
+  for (path_stats_thread *p = pathStatsThreads; p; p = p->pNext)
+    memset(p->aSlot, 0, sizeof(p->aSlot));
+  pathStatsUnlock();
+}
+
+/** path_config(name, [value])
+ * Returns the value of a runtime setting of sqlite-path, after setting it to
+ * value if one is given. Settings are process-wide.
+ *
+ *  'stats': 1 to count calls into path_stats, 0 to stop. 'reset' clears
+ *           every counter and leaves stats on or off.
+ */
+static void pathConfigFunc(sqlite3_context *context, int argc,
+                           sqlite3_value **argv) {
+  const char *zName;
+  if (argc < 1 || argc > 2) {
+    sqlite3_result_error(context,
+                         "path_config takes a name and an optional value", -1);
+    return;
+  }
+  zName = (const char *)sqlite3_value_text(argv[0]);
+  if (zName == NULL || sqlite3_stricmp(zName, "stats") != 0) {
+    char *zErr = sqlite3_mprintf("unknown path_config setting '%s'",
+                                 zName ? zName : "");
+    sqlite3_result_error(context, zErr ? zErr : "unknown setting", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  if (argc > 1) {
+    const char *zValue = (const char *)sqlite3_value_text(argv[1]);
+    if (zValue && sqlite3_stricmp(zValue, "reset") == 0)
+      pathStatsReset();
+    else
+      pathStatsEnabled = sqlite3_value_int(argv[1]) != 0;
+  }
+  sqlite3_result_int(context, pathStatsEnabled);
+}
+
+#pragma endregion
+
+#pragma region sqlite - path parse cache
+
+/*
+** Most queries call several path functions on the same column, like
+** `select path_dirname(p), path_basename(p), path_extension(p) from files`.
+** Instead of tokenizing the path in every function, each connection keeps a
+** small cache of recently parsed paths, keyed on the input bytes. Every
+** scalar function reads segment offsets, root, extension and depth out of a
+** cache entry, so a row is only scanned once no matter how many path
+** functions are called on it.
+*/
+
+// number of parsed paths kept per connection. Needs to be at least 2, so
+// functions with two path arguments don't evict their first argument.
+#define PATH_CACHE_SIZE 4
+
+typedef struct path_cache_entry path_cache_entry;
+struct path_cache_entry {
+  // copy of the input bytes this entry was parsed from
+  char *zKey;
+  int nKey;
+  int nKeyAlloc;
+  // style the key was parsed in
+  const path_style *pStyle;
+  // tick of when this entry was last used, 0 if the entry is empty
+  sqlite3_uint64 iUsed;
+  path_parsed parsed;
+};
+
+typedef struct path_context path_context;
+
+/*
+** User data of every registered function: the connection's shared state,
+** the style that function parses paths in, and the implementation that
+** pathFunctionCall() dispatches to.
+*/
+typedef struct path_function path_function;
+struct path_function {
+  path_context *pCtx;
+  const path_style *pStyle;
+  void (*xFunc)(sqlite3_context *, int, sqlite3_value **);
+  // name without the style prefix, for probes
+  const char *zName;
+  // counters of this function in path_stats
+  int iSlot;
+};
+
+/*
+** Per-connection state for sqlite-path, shared by every registered function
+** through its path_function. Reference counted, since each function
+** registration holds a reference that's released in its destructor.
+*/
+struct path_context {
+  int nRef;
+  sqlite3_uint64 iTick;
+  path_cache_entry aEntry[PATH_CACHE_SIZE];
+  // user data for the functions of each style, PATH_STYLE_UNIX and
+  // PATH_STYLE_WINDOWS
+  path_function aFunction[2][PATH_MAX_FUNCTIONS];
+};
+
+static void pathContextRelease(void *p) {
+  path_context *pCtx = (path_context *)p;
+  if (--pCtx->nRef > 0)
+    return;
+  for (int i = 0; i < PATH_CACHE_SIZE; i++) {
+    sqlite3_free(pCtx->aEntry[i].zKey);
+    pathParsedFree(&pCtx->aEntry[i].parsed);
+  }
+  sqlite3_free(pCtx);
+}
+
+static void pathFunctionRelease(void *p) {
+  pathContextRelease(((path_function *)p)->pCtx);
+}
+
+static const path_style *pathFunctionStyle(sqlite3_context *context) {
+  return ((path_function *)sqlite3_user_data(context))->pStyle;
+}
+
+/*
+** Every path function is registered as this, which calls the actual
+** implementation, and counts the call when stats are on or fires its
+** probes when a tracer is attached.
+*/
+static void pathFunctionCall(sqlite3_context *context, int argc,
+                             sqlite3_value **argv) {
+  path_function *pFunc = (path_function *)sqlite3_user_data(context);
+  path_stats_counters *pStats = NULL, *pOuter;
+  sqlite3_int64 iStart = 0, nBytesIn = 0;
+
+  if (!pathStatsEnabled && !PATH_PROBE_ENABLED(function_entry) &&
+      !PATH_PROBE_ENABLED(function_return)) {
+    pFunc->xFunc(context, argc, argv);
+    return;
+  }
+  for (int i = 0; i < argc; i++) {
+    int eType = sqlite3_value_type(argv[i]);
+    // only paths count, sqlite3_value_bytes() would convert numbers to text
+    if (eType == SQLITE_TEXT || eType == SQLITE_BLOB)
+      nBytesIn += sqlite3_value_bytes(argv[i]);
+  }
+  PATH_PROBE3(function_entry, pFunc->zName, pFunc->pStyle->eStyle, nBytesIn);
+  if (pathStatsEnabled)
+    pStats = pathStatsSlot(pFunc->iSlot);
+  if (pStats) {
+    pStats->nCall++;
+    pStats->nBytesIn += nBytesIn;
+    iStart = pathStatsNow();
+  }
+  pOuter = pathStatsCurrent;
+  pathStatsCurrent = pStats;
+  PATH_PROBE_BYTES_OUT(0);
+  pFunc->xFunc(context, argc, argv);
+  pathStatsCurrent = pOuter;
+  if (pStats)
+    pStats->nNs += pathStatsNow() - iStart;
+  PATH_PROBE4(function_return, pFunc->zName, pFunc->pStyle->eStyle, nBytesIn,
+              pathProbeBytesOut);
+}
+
+/*
+** Returns the parsed form of the given path, from the connection's parse
+** cache if it was recently parsed. The returned pointer is only valid until
+** PATH_CACHE_SIZE-1 other paths are parsed on this connection. On error,
+** an error result is set on context and NULL is returned. Entries are keyed
+** on the nPath bytes of zPath and the style of the calling function, so a
+** TEXT and a BLOB path with the same bytes share one.
+*/
+static const path_parsed *pathParseCached(sqlite3_context *context,
+                                          const char *zPath, int nPath) {
+  path_function *pFunc = (path_function *)sqlite3_user_data(context);
+  path_context *pCtx = pFunc->pCtx;
+  path_cache_entry *pEntry = &pCtx->aEntry[0];
+
+  // sqlite3_value_text() and friends return NULL on an OOM
+  if (zPath == NULL) {
+    sqlite3_result_error_nomem(context);
+    return NULL;
+  }
+  pCtx->iTick++;
+  for (int i = 0; i < PATH_CACHE_SIZE; i++) {
+    path_cache_entry *p = &pCtx->aEntry[i];
+    if (p->iUsed && p->nKey == nPath && p->pStyle == pFunc->pStyle &&
+        memcmp(p->zKey, zPath, nPath) == 0) {
+      if (pathStatsCurrent)
+        pathStatsCurrent->nCacheHit++;
+      p->iUsed = pCtx->iTick;
+      return &p->parsed;
+    }
+    // least recently used (or empty) entry is the one to evict
+    if (p->iUsed < pEntry->iUsed)
+      pEntry = p;
+  }
+
+  if (pathStatsCurrent)
+    pathStatsCurrent->nCacheMiss++;
+  pEntry->iUsed = 0;
+  if (pEntry->nKeyAlloc < nPath + 1) {
+    char *zKey = sqlite3_realloc64(pEntry->zKey, nPath + 1);
+    if (zKey == NULL) {
+      sqlite3_result_error_nomem(context);
+      return NULL;
+    }
+    pEntry->zKey = zKey;
+    pEntry->nKeyAlloc = nPath + 1;
+  }
+  if (pathTokenize(pFunc->pStyle, zPath, nPath, &pEntry->parsed) !=
+      SQLITE_OK) {
+    sqlite3_result_error_nomem(context);
+    return NULL;
+  }
+  memcpy(pEntry->zKey, zPath, nPath);
+  pEntry->nKey = nPath;
+  pEntry->pStyle = pFunc->pStyle;
+  pEntry->iUsed = pCtx->iTick;
+  return &pEntry->parsed;
+}
+
+#pragma endregion
+
+#pragma region sqlite - path normalization
+
+/*
+** path_join and path_normalize both build a new path out of the segments of
+** one or more input paths, dropping "." segments and resolving ".." against
+** the segment before it, like cwalk does. A path_builder writes the result in
+** a single pass straight into one output buffer, which the caller sizes up
+** front from the input lengths, and keeps a stack of where every output
+** segment starts so a ".." can truncate the output in constant time.
+*/
+
+typedef struct path_builder path_builder;
+struct path_builder {
+  // style the inputs are parsed in, and the output separated with
+  const path_style *pStyle;
+  // output buffer, at least as large as pathBuilderSize() says
+  char *zOut;
+  // number of bytes written to zOut
+  int nOut;
+  // number of paths appended so far
+  int nPaths;
+  // whether the output path is absolute, so leading ".." are dropped
+  int absolute;
+  // number of segments written to zOut
+  int nKept;
+  // number of leading ".." segments that couldn't be resolved
+  int nBack;
+  // capacity of aMark
+  int nMarkAlloc;
+  // offset in zOut where each written segment (and its separator) starts
+  int *aMark;
+  int aMarkInline[PATH_SEGMENTS_INLINE];
+  // scratch space to tokenize each input into
+  path_parsed parsed;
+};
+
+/*
+** Upper bound on the size of the output of joining paths totalling nBytes
+** bytes over nPaths arguments. Every segment of an input path except the
+** first is preceded by a separator in that input, so the output (including
+** the separator joining each input) is never longer than this.
+*/
+static sqlite3_int64 pathBuilderSize(sqlite3_int64 nBytes, int nPaths) {
+  return nBytes + nPaths + 1;
+}
+
+static void pathBuilderInit(path_builder *p, const path_style *pStyle,
+                            char *zOut) {
+  memset(p, 0, offsetof(path_builder, aMarkInline));
+  p->pStyle = pStyle;
+  p->zOut = zOut;
+  p->nMarkAlloc = PATH_SEGMENTS_INLINE;
+  p->aMark = p->aMarkInline;
+  pathParsedInit(&p->parsed);
+}
+
+static void pathBuilderFree(path_builder *p) {
+  if (p->aMark != p->aMarkInline)
+    sqlite3_free(p->aMark);
+  pathParsedFree(&p->parsed);
+}
+
+/*
+** Append the segments of the nPath bytes at zPath to the output. The root of
+** the first path appended becomes the root of the output, the roots of any
+** later paths are ignored.
+*/
+static int pathBuilderAppend(path_builder *p, const char *zPath, int nPath) {
+  path_parsed *parsed = &p->parsed;
+  int rc = pathTokenize(p->pStyle, zPath, nPath, parsed);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  if (p->nPaths++ == 0 && parsed->nRoot > 0) {
+    memcpy(p->zOut, zPath, parsed->nRoot);
+    p->nOut = parsed->nRoot;
+    p->absolute = parsed->absolute;
+  }
+
+  for (int i = 0; i < parsed->nSegment; i++) {
+    switch (parsed->aType[i]) {
+    case CWK_CURRENT:
+      continue;
+    case CWK_BACK:
+      if (p->nKept > p->nBack) {
+        p->nOut = p->aMark[--p->nKept];
+        continue;
+      }
+      if (p->absolute)
+        continue;
+      p->nBack++;
+      break;
+    }
+    if (p->nKept == p->nMarkAlloc) {
+      int *aNew = sqlite3_malloc64(sizeof(int) * p->nMarkAlloc * 2);
+      if (aNew == NULL)
+        return SQLITE_NOMEM;
+      memcpy(aNew, p->aMark, sizeof(int) * p->nKept);
+      if (p->aMark != p->aMarkInline)
+        sqlite3_free(p->aMark);
+      p->aMark = aNew;
+      p->nMarkAlloc *= 2;
+    }
+    p->aMark[p->nKept++] = p->nOut;
+    if (p->nKept > 1)
+      p->zOut[p->nOut++] = p->pStyle->cSeparator;
+    memcpy(p->zOut + p->nOut, zPath + parsed->aBegin[i], parsed->aSize[i]);
+    p->nOut += parsed->aSize[i];
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Finish the output, which is "." if nothing else was written.
+*/
+static int pathBuilderFinish(path_builder *p) {
+  if (p->nOut == 0)
+    p->zOut[p->nOut++] = '.';
+  return p->nOut;
+}
+
+#pragma endregion
+
+#pragma region sqlite - path scalar functions
+
+/*
+** Paths are arbitrary bytes, and can be stored as either TEXT or BLOB.
+** pathValue() returns the bytes of a path argument without converting BLOBs
+** to text, and sets *pnPath from sqlite3_value_bytes(), so nothing relies on
+** a NUL terminator and paths may contain any byte. Functions that return a
+** path (or a slice of one) return it with the same type as their input,
+** through pathResult().
+*/
+static const char *pathValue(sqlite3_value *value, int *pnPath) {
+  const char *zPath;
+  if (sqlite3_value_type(value) == SQLITE_BLOB)
+    zPath = (const char *)sqlite3_value_blob(value);
+  else
+    zPath = (const char *)sqlite3_value_text(value);
+  *pnPath = sqlite3_value_bytes(value);
+  // a zero-length BLOB is a NULL pointer, but still an (empty) path
+  return zPath == NULL && *pnPath == 0 ? "" : zPath;
+}
+
+static void pathResult(sqlite3_context *context, int eType, const char *z,
+                       int n, void (*xDel)(void *)) {
+  if (pathStatsCurrent)
+    pathStatsCurrent->nBytesOut += n;
+  PATH_PROBE_BYTES_OUT(n);
+  if (eType == SQLITE_BLOB)
+    sqlite3_result_blob(context, z, n, xDel);
+  else
+    sqlite3_result_text(context, z, n, xDel);
+}
+
+static void pathResultNull(sqlite3_context *context) {
+  if (pathStatsCurrent)
+    pathStatsCurrent->nNull++;
+  PATH_PROBE_BYTES_OUT(-1);
+  sqlite3_result_null(context);
+}
+
+/*
+** Drop "." segments of a tokenized path and resolve ".." segments against
+** the segment before them, in place, the same way path_normalize() does.
+*/
+static void pathResolveSegments(path_parsed *p) {
+  int nKept = 0;
+  int nBack = 0;
+  for (int i = 0; i < p->nSegment; i++) {
+    switch (p->aType[i]) {
+    case CWK_CURRENT:
+      continue;
+    case CWK_BACK:
+      if (nKept > nBack) {
+        nKept--;
+        continue;
+      }
+      if (p->absolute)
+        continue;
+      nBack++;
+      break;
+    }
+    p->aBegin[nKept] = p->aBegin[i];
+    p->aSize[nKept] = p->aSize[i];
+    p->aType[nKept] = p->aType[i];
+    nKept++;
+  }
+  p->nSegment = nKept;
+}
+
+/*
+** Returns how many leading segments two tokenized and resolved paths share,
+** or -1 if their roots differ.
+*/
+static int pathCommonSegments(const path_style *pStyle, const char *zBase,
+                              const path_parsed *base, const char *zOther,
+                              const path_parsed *other) {
+  int i;
+  if (base->nRoot != other->nRoot ||
+      pStyle->xCompare(zBase, zOther, base->nRoot) != 0)
+    return -1;
+  for (i = 0; i < base->nSegment && i < other->nSegment; i++) {
+    if (base->aSize[i] != other->aSize[i] ||
+        pStyle->xCompare(zBase + base->aBegin[i], zOther + other->aBegin[i],
+                         base->aSize[i]) != 0)
+      break;
+  }
+  return i;
+}
+
+/*
+** Returns the number of bytes of zBase that it has in common with zOther:
+** the root, if both have the same one, up to the end of the last segment
+** that both paths share after normalization. Returns 0 if the roots differ,
+** or -1 on an OOM.
+*/
+static int pathIntersection(const path_style *pStyle, const char *zBase,
+                            int nBase, const char *zOther, int nOther) {
+  path_parsed base;
+  path_parsed other;
+  int nSegment;
+  int nCommon = -1;
+
+  pathParsedInit(&base);
+  pathParsedInit(&other);
+  if (pathTokenize(pStyle, zBase, nBase, &base) != SQLITE_OK ||
+      pathTokenize(pStyle, zOther, nOther, &other) != SQLITE_OK)
+    goto done;
+
+  pathResolveSegments(&base);
+  pathResolveSegments(&other);
+  nSegment = pathCommonSegments(pStyle, zBase, &base, zOther, &other);
+  if (nSegment < 0)
+    nCommon = 0;
+  else if (nSegment == 0)
+    nCommon = base.nRoot;
+  else
+    nCommon = base.aBegin[nSegment - 1] + base.aSize[nSegment - 1];
+
+done:
+  pathParsedFree(&base);
+  pathParsedFree(&other);
+  return nCommon;
+}
+
+/*
+** Returns 1 if zPath is inside zDir at any depth once both are normalized,
+** 0 if it isn't, or -1 on an OOM. Roots and segments are compared with the
+** style's xCompare, so windows paths are matched case-insensitively.
+*/
+static int pathUnder(const path_style *pStyle, const char *zPath, int nPath,
+                     const char *zDir, int nDir) {
+  path_parsed path;
+  path_parsed dir;
+  int bUnder = -1;
+
+  pathParsedInit(&path);
+  pathParsedInit(&dir);
+  if (pathTokenize(pStyle, zPath, nPath, &path) != SQLITE_OK ||
+      pathTokenize(pStyle, zDir, nDir, &dir) != SQLITE_OK)
+    goto done;
+
+  bUnder = 0;
+  if (path.nRoot != dir.nRoot ||
+      pStyle->xCompare(zPath, zDir, path.nRoot) != 0)
+    goto done;
+
+  pathResolveSegments(&path);
+  pathResolveSegments(&dir);
+  if (dir.nSegment >= path.nSegment)
+    goto done;
+  for (int i = 0; i < dir.nSegment; i++) {
+    if (path.aSize[i] != dir.aSize[i] ||
+        pStyle->xCompare(zPath + path.aBegin[i], zDir + dir.aBegin[i],
+                         dir.aSize[i]) != 0)
+      goto done;
+  }
+  bUnder = 1;
+
+done:
+  pathParsedFree(&path);
+  pathParsedFree(&dir);
+  return bUnder;
+}
+
+/** path_under(path, dir)
+ * Returns 1 if path is inside dir at any depth, 0 if it isn't (or is dir
+ * itself), or null if either is null. "." and ".." segments are resolved in
+ * both first, so 'a/b/../c' is under 'a' and 'a/../b' isn't.
+ */
+static void pathUnderFunc(sqlite3_context *context, int argc,
+                          sqlite3_value **argv) {
+  const char *path;
+  const char *dir;
+  int nPath;
+  int nDir;
+  int bUnder;
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL ||
+      sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  dir = pathValue(argv[1], &nDir);
+  if (path == NULL || dir == NULL) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  bUnder = pathUnder(pathFunctionStyle(context), path, nPath, dir, nDir);
+  if (bUnder < 0) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  sqlite3_result_int(context, bUnder);
+}
+
+/** path_absolute(path)
+ * Returns 1 if the given path is absolute, 0 otherwise.
+ *
+ */
+static void pathAbsoluteFunc(sqlite3_context *context, int argc,
+                             sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    sqlite3_result_int(context, 0);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  sqlite3_result_int(context, parsed->absolute);
+}
+/** path_basename(path)
+ * Returns the basename of the given path,
+ * or NULL if it cannot be calculated.
+ */
+static void pathBasenameFunc(sqlite3_context *context, int argc,
+                             sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  int eType = sqlite3_value_type(argv[0]);
+  int last;
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  if (parsed->nSegment == 0) {
+    pathResultNull(context);
+    return;
+  }
+  last = parsed->nSegment - 1;
+  pathResult(context, eType, path + parsed->aBegin[last], parsed->aSize[last],
+             SQLITE_TRANSIENT);
+}
+
+/** path_dirname(path)
+ * Returns the dirname of the given path,
+ * or NULL if it cannot be calculated.
+ */
+static void pathDirnameFunc(sqlite3_context *context, int argc,
+                            sqlite3_value **argv) {
+  const path_parsed *parsed;
+  int length;
+  const char *path;
+  int nPath;
+  int eType = sqlite3_value_type(argv[0]);
+
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  length =
+      parsed->nSegment == 0 ? 0 : parsed->aBegin[parsed->nSegment - 1];
+  if (length == 0) {
+    pathResultNull(context);
+    return;
+  }
+  pathResult(context, eType, path, length, SQLITE_TRANSIENT);
+}
+
+/** path_extension(path)
+ * Returns the extension of the given path,
+ * or NULL if it cannot be calculated.
+ */
+static void pathExtensionFunc(sqlite3_context *context, int argc,
+                              sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  int eType = sqlite3_value_type(argv[0]);
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  if (parsed->nExtension == 0) {
+    pathResultNull(context);
+    return;
+  }
+  pathResult(context, eType, path + parsed->iExtension, parsed->nExtension,
+             SQLITE_TRANSIENT);
+}
+
+/** path_name(path)
+ * Returns the name of the given path,
+ * or NULL if it cannot be calculated.
+ */
+static void pathNameFunc(sqlite3_context *context, int argc,
+                         sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  int eType = sqlite3_value_type(argv[0]);
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  if (parsed->nSegment == 0) {
+    pathResultNull(context);
+    return;
+  }
+
+  // hidden files like ".vimrc" keep their leading dot, the name is everything
+  // in the last segment up to the next '.', or the entire segment otherwise.
+  pathResult(context, eType, path + parsed->aBegin[parsed->nSegment - 1],
+             parsed->nName, SQLITE_TRANSIENT);
+}
+
+/** path_intersection(path)
+ * Returns the common portions between two paths, or null if it cannot be
+ * computed.
+ *
+ */
+static void pathIntersectionFunc(sqlite3_context *context, int argc,
+                                 sqlite3_value **argv) {
+  const char *base;
+  const char *other;
+  int nBase;
+  int nOther;
+  int eType = sqlite3_value_type(argv[0]);
+  int length;
+  if (eType == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+
+  base = pathValue(argv[0], &nBase);
+  other = pathValue(argv[1], &nOther);
+  length = pathIntersection(pathFunctionStyle(context), base, nBase, other,
+                            nOther);
+  if (length < 0) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  if (length == 0) {
+    pathResultNull(context);
+    return;
+  }
+
+  pathResult(context, eType, base, length, SQLITE_TRANSIENT);
+}
+
+/** path_join(path1, path2, [...pathN])
+ * Join two or more paths together, or null if it cannot be computed.
+ * NULL arguments after the first are skipped. The result has the same type
+ * as path1.
+ */
+static void pathJoinFunc(sqlite3_context *context, int argc,
+                         sqlite3_value **argv) {
+  path_builder builder;
+  sqlite3_int64 nBytes = 0;
+  char *zOut;
+  int eType;
+  int nOut = 0;
+  int rc = SQLITE_OK;
+
+  if (argc < 2) {
+    sqlite3_result_error(context, "at least 2 paths are required for path_join",
+                         -1);
+    return;
+  }
+  eType = sqlite3_value_type(argv[0]);
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+
+  for (int i = 0; i < argc; i++) {
+    int nPath;
+    if (sqlite3_value_type(argv[i]) == SQLITE_NULL)
+      continue;
+    pathValue(argv[i], &nPath);
+    nBytes += nPath;
+  }
+  zOut = sqlite3_malloc64(pathBuilderSize(nBytes, argc));
+  if (zOut == NULL) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  pathBuilderInit(&builder, pathFunctionStyle(context), zOut);
+  for (int i = 0; i < argc && rc == SQLITE_OK; i++) {
+    const char *zPath;
+    int nPath;
+    if (sqlite3_value_type(argv[i]) == SQLITE_NULL)
+      continue;
+    zPath = pathValue(argv[i], &nPath);
+    if (zPath == NULL) {
+      rc = SQLITE_NOMEM;
+      break;
+    }
+    rc = pathBuilderAppend(&builder, zPath, nPath);
+  }
+  if (rc == SQLITE_OK)
+    nOut = pathBuilderFinish(&builder);
+  pathBuilderFree(&builder);
+  if (rc != SQLITE_OK) {
+    sqlite3_free(zOut);
+    sqlite3_result_error_code(context, rc);
+    return;
+  }
+  pathResult(context, eType, zOut, nOut, sqlite3_free);
+}
+
+/** path_normalize(path)
+ * Create a normalized version of the given path (resolving back segments),
+ * or null if it cannot be computed.
+ */
+static void pathNormalizeFunc(sqlite3_context *context, int argc,
+                              sqlite3_value **argv) {
+  path_builder builder;
+  const char *path;
+  char *zOut;
+  int eType = sqlite3_value_type(argv[0]);
+  int nPath;
+  int nOut = 0;
+  int rc;
+
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  if (path == NULL) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  zOut = sqlite3_malloc64(pathBuilderSize(nPath, 1));
+  if (zOut == NULL) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  pathBuilderInit(&builder, pathFunctionStyle(context), zOut);
+  rc = pathBuilderAppend(&builder, path, nPath);
+  if (rc == SQLITE_OK)
+    nOut = pathBuilderFinish(&builder);
+  pathBuilderFree(&builder);
+  if (rc != SQLITE_OK) {
+    sqlite3_free(zOut);
+    sqlite3_result_error_code(context, rc);
+    return;
+  }
+  pathResult(context, eType, zOut, nOut, sqlite3_free);
+}
+
+// TODO path_name(path), "a.txt" -> "a", "d.tar.gz" -> "d" etc.
+
+/** path_relative(path)
+ * Returns 1 if the given path is relative, 0 if not, or null if path is null.
+
+ */
+static void pathRelativeFunc(sqlite3_context *context, int argc,
+                             sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  sqlite3_result_int(context, !parsed->absolute);
+}
+
+/** path_root(path)
+ * Returns the root portion of the given path, or null if it cannot be computed.
+ *
+ */
+static void pathRootFunc(sqlite3_context *context, int argc,
+                         sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  int eType = sqlite3_value_type(argv[0]);
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  pathResult(context, eType, path, parsed->nRoot, SQLITE_TRANSIENT);
+}
+
+/** path_part_at(path, at)
+ ** path_at(path, at)
+ * Returns the path segment in the given path at the specified index.
+ * If 'at' is positive, then '0' is the first segment and counts to the end.
+ * If 'at' is negative, then '-1' is the last segment and continue to the
+ * beginning. If 'at' "overflows" in either direction, then returns NULL.
+ *
+ */
+static void pathPartAtFunc(sqlite3_context *context, int argc,
+                           sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  int eType = sqlite3_value_type(argv[0]);
+  sqlite3_int64 at = sqlite3_value_int64(argv[1]);
+
+  if (eType == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+
+  if (at < 0)
+    at += parsed->nSegment;
+  if (at < 0 || at >= parsed->nSegment) {
+    pathResultNull(context);
+    return;
+  }
+  pathResult(context, eType, path + parsed->aBegin[at], parsed->aSize[at],
+             SQLITE_TRANSIENT);
+}
+
+/** path_length(path)
+ * Returns the number of segments in the given path.
+ *
+ */
+static void pathLengthFunc(sqlite3_context *context, int argc,
+                           sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  int nPath;
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  sqlite3_result_int(context, parsed->nSegment);
+}
+#pragma endregion
+
+#pragma region sqlite - path sort keys
+
+/*
+** A sort key is a BLOB whose memcmp() order is the depth-first order of the
+** directory tree: a directory sorts right before everything under it, and
+** everything under it sorts before its next sibling. Plain text order gets
+** this wrong because '/' sorts above bytes like '-' and '.', which puts
+** "/a-b" between "/a" and "/a/b".
+**
+** The key is the root, then every segment separated by a single 0x00 byte.
+** 0x00 and 0x01 bytes inside the path are escaped to 0x01 0x01 and 0x01 0x02,
+** so the separator sorts below every other byte. Runs of separators count as
+** one, and trailing separators are dropped, so "/a//b/" has the same key as
+** "/a/b". "." and ".." segments are kept as they are, normalize first when
+** they shouldn't be.
+*/
+
+/*
+** Write the escaped form of the n bytes of z to zOut, turning every run of
+** separators into a single 0x00. Returns the number of bytes written, at
+** most 2*n.
+*/
+static int pathSortKeyAppend(const path_style *pStyle, const char *z, int n,
+                             unsigned char *zOut) {
+  int nOut = 0;
+  for (int i = 0; i < n; i++) {
+    unsigned char c = (unsigned char)z[i];
+    if (pathIsSeparator(pStyle->eStyle, c)) {
+      if (nOut == 0 || zOut[nOut - 1] != 0x00)
+        zOut[nOut++] = 0x00;
+    } else if (c <= 0x01) {
+      zOut[nOut++] = 0x01;
+      zOut[nOut++] = c + 1;
+    } else {
+      zOut[nOut++] = c;
+    }
+  }
+  return nOut;
+}
+
+/*
+** Build the sort key of the nPath bytes of zPath, parsed as parsed, into a
+** new sqlite3_malloc() buffer with room for one more byte, and its size in
+** *pnKey. Returns NULL on an OOM.
+*/
+static unsigned char *pathSortKey(const path_style *pStyle, const char *zPath,
+                                  int nPath, const path_parsed *parsed,
+                                  int *pnKey) {
+  // every byte escapes to at most 2, plus path_subtree_upper()'s extra byte
+  unsigned char *zKey = sqlite3_malloc64((sqlite3_uint64)nPath * 2 + 1);
+  int nKey;
+  if (zKey == NULL)
+    return NULL;
+  nKey = pathSortKeyAppend(pStyle, zPath, parsed->nRoot, zKey);
+  for (int i = 0; i < parsed->nSegment; i++) {
+    if (i > 0)
+      zKey[nKey++] = 0x00;
+    nKey += pathSortKeyAppend(pStyle, zPath + parsed->aBegin[i],
+                              parsed->aSize[i], zKey + nKey);
+  }
+  *pnKey = nKey;
+  return zKey;
+}
+
+/** path_sort_key(path)
+ * Returns a BLOB that sorts in directory tree order with memcmp(), for
+ * expression indexes like `create index files_tree on
+ * files(path_sort_key(path))`.
+ */
+static void pathSortKeyFunc(sqlite3_context *context, int argc,
+                            sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  unsigned char *zKey;
+  int nPath, nKey;
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  zKey = pathSortKey(pathFunctionStyle(context), path, nPath, parsed, &nKey);
+  if (zKey == NULL) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  pathResult(context, SQLITE_BLOB, (const char *)zKey, nKey, sqlite3_free);
+}
+
+/** path_subtree_upper(dir)
+ * Returns the smallest sort key greater than the sort key of dir and of
+ * every path under it, so `path_sort_key(path) >= path_sort_key(dir) and
+ * path_sort_key(path) < path_subtree_upper(dir)` is a single index range
+ * over dir and its subtree. NULL for an empty dir.
+ */
+static void pathSubtreeUpperFunc(sqlite3_context *context, int argc,
+                                 sqlite3_value **argv) {
+  const path_parsed *parsed;
+  const char *path;
+  unsigned char *zKey;
+  int nPath, nKey;
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    pathResultNull(context);
+    return;
+  }
+  path = pathValue(argv[0], &nPath);
+  parsed = pathParseCached(context, path, nPath);
+  if (parsed == NULL)
+    return;
+  zKey = pathSortKey(pathFunctionStyle(context), path, nPath, parsed, &nKey);
+  if (zKey == NULL) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  if (nKey == 0) {
+    sqlite3_free(zKey);
+    pathResultNull(context);
+    return;
+  }
+  // paths under dir all start with its key and a 0x00, except under a bare
+  // root like "/", whose key already ends in one. Bumping that 0x00 to 0x01
+  // bounds the subtree, while siblings like "/a-b" for "/a" sort above it.
+  if (zKey[nKey - 1] != 0x00)
+    zKey[nKey++] = 0x00;
+  zKey[nKey - 1] = 0x01;
+  pathResult(context, SQLITE_BLOB, (const char *)zKey, nKey, sqlite3_free);
+}
+
+#pragma endregion
+
+#pragma region sqlite - path collations
+
+/*
+** PATH, PATH_NOCASE and PATH_NATURAL order unix paths segment by segment,
+** with the separator below every other byte, so an index or ORDER BY with
+** them walks the tree depth first. PATH orders exactly like memcmp() on
+** path_sort_key(): runs of '/' count as one and trailing ones are ignored.
+** PATH_NOCASE also folds case, ASCII plus the Latin-1, Latin Extended-A,
+** Greek and Cyrillic letters, the way macOS and Windows volumes usually
+** compare names. PATH_NATURAL orders runs of digits by their value, so
+** "file2" sorts before "file10".
+**
+** Collations run for every comparison in index maintenance, so the common
+** prefix of both strings is skipped 8 bytes at a time before anything is
+** decoded, and the rest is walked one unit at a time.
+*/
+
+#define PATH_COLLATE_BINARY 0
+#define PATH_COLLATE_NOCASE 1
+#define PATH_COLLATE_NATURAL 2
+
+/*
+** A position in one side of a comparison. pathCollateNext() returns the
+** next unit: -1 at the end, 0 for a run of separators, and otherwise the
+** byte (or for PATH_COLLATE_NOCASE, folded code point) plus one.
+*/
+typedef struct path_collate_cursor path_collate_cursor;
+struct path_collate_cursor {
+  const unsigned char *z;
+  int n;
+  int i;
+};
+
+/*
+** Simple case fold of code point c, for the alphabets that have case and
+** show up in file names most often.
+*/
+static int pathFoldCodepoint(int c) {
+  if (c < 0x80)
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+  if (c >= 0xC0 && c <= 0xDE && c != 0xD7)
+    return c + 32;
+  if (c >= 0x100 && c <= 0x17F) {
+    // pairs of upper and lower case letters, upper case first
+    if (c == 0x178)
+      return 0xFF;
+    if (c == 0x17F)
+      return 's';
+    if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E))
+      return c + (c & 1);
+    if (c == 0x130 || c == 0x131 || c == 0x138 || c == 0x149)
+      return c;
+    return c | 1;
+  }
+  if ((c >= 0x391 && c <= 0x3A9 && c != 0x3A2) || (c >= 0x410 && c <= 0x42F))
+    return c + 32;
+  if (c >= 0x400 && c <= 0x40F)
+    return c + 80;
+  return c;
+}
+
+/*
+** Decode the UTF-8 character at p->z[p->i] and advance past it. Bytes that
+** don't start a well-formed character are returned as they are.
+*/
+static int pathCollateCodepoint(path_collate_cursor *p) {
+  const unsigned char *z = p->z + p->i;
+  int nLeft = p->n - p->i;
+  int c = z[0];
+  if (c >= 0xC2 && c <= 0xDF && nLeft >= 2 && (z[1] & 0xC0) == 0x80) {
+    p->i += 2;
+    return ((c & 0x1F) << 6) | (z[1] & 0x3F);
+  }
+  if (c >= 0xE0 && c <= 0xEF && nLeft >= 3 && (z[1] & 0xC0) == 0x80 &&
+      (z[2] & 0xC0) == 0x80) {
+    p->i += 3;
+    return ((c & 0x0F) << 12) | ((z[1] & 0x3F) << 6) | (z[2] & 0x3F);
+  }
+  if (c >= 0xF0 && c <= 0xF4 && nLeft >= 4 && (z[1] & 0xC0) == 0x80 &&
+      (z[2] & 0xC0) == 0x80 && (z[3] & 0xC0) == 0x80) {
+    p->i += 4;
+    return ((c & 0x07) << 18) | ((z[1] & 0x3F) << 12) | ((z[2] & 0x3F) << 6) |
+           (z[3] & 0x3F);
+  }
+  p->i++;
+  return c;
+}
+
+static PATH_ALWAYS_INLINE int pathCollateNext(path_collate_cursor *p,
+                                              int eCollate) {
+  int c;
+  if (p->i >= p->n)
+    return -1;
+  c = p->z[p->i];
+  if (c == '/') {
+    int iRun = p->i;
+    while (p->i < p->n && p->z[p->i] == '/')
+      p->i++;
+    // trailing separators are ignored, unless the path is only a root
+    return p->i == p->n && iRun > 0 ? -1 : 0;
+  }
+  if (eCollate == PATH_COLLATE_NOCASE) {
+    if (c < 0x80) {
+      p->i++;
+      return (c >= 'A' && c <= 'Z' ? c + 32 : c) + 1;
+    }
+    return pathFoldCodepoint(pathCollateCodepoint(p)) + 1;
+  }
+  p->i++;
+  return c + 1;
+}
+
+static int pathIsDigit(int c) { return c >= '0' && c <= '9'; }
+
+/*
+** Compare the runs of digits that start right before pA->i and pB->i by
+** value, and move both cursors past them. When the values are equal, *pTie
+** is set to order the run with fewer leading zeros first, if it isn't set
+** already, so "2" and "02" are never equal.
+*/
+static int pathCollateNumber(path_collate_cursor *pA, path_collate_cursor *pB,
+                             int *pTie) {
+  int iA = pA->i - 1, iB = pB->i - 1, nZeroA = 0, nZeroB = 0;
+  int iEndA, iEndB;
+  while (iA < pA->n - 1 && pA->z[iA] == '0' && pathIsDigit(pA->z[iA + 1])) {
+    iA++;
+    nZeroA++;
+  }
+  while (iB < pB->n - 1 && pB->z[iB] == '0' && pathIsDigit(pB->z[iB + 1])) {
+    iB++;
+    nZeroB++;
+  }
+  for (iEndA = iA; iEndA < pA->n && pathIsDigit(pA->z[iEndA]); iEndA++) {
+  }
+  for (iEndB = iB; iEndB < pB->n && pathIsDigit(pB->z[iEndB]); iEndB++) {
+  }
+  pA->i = iEndA;
+  pB->i = iEndB;
+  // without leading zeros, the longer run is the larger number
+  if (iEndA - iA != iEndB - iB)
+    return iEndA - iA < iEndB - iB ? -1 : 1;
+  for (; iA < iEndA; iA++, iB++) {
+    if (pA->z[iA] != pB->z[iB])
+      return pA->z[iA] < pB->z[iB] ? -1 : 1;
+  }
+  if (*pTie == 0 && nZeroA != nZeroB)
+    *pTie = nZeroA < nZeroB ? -1 : 1;
+  return 0;
+}
+
+static PATH_ALWAYS_INLINE int pathCollate(int eCollate, int nA, const void *pA,
+                                          int nB, const void *pB) {
+  const unsigned char *zA = (const unsigned char *)pA;
+  const unsigned char *zB = (const unsigned char *)pB;
+  int n = nA < nB ? nA : nB;
+  int i = 0, iSync, tie = 0;
+  path_collate_cursor a, b;
+
+  while (i + 8 <= n) {
+    sqlite3_uint64 wA, wB;
+    memcpy(&wA, zA + i, 8);
+    memcpy(&wB, zB + i, 8);
+    if (wA != wB)
+      break;
+    i += 8;
+  }
+  while (i < n && zA[i] == zB[i])
+    i++;
+  if (i == nA && i == nB)
+    return 0;
+
+  // Back up from the first difference to a point where both sides decode
+  // the same way: the start of a UTF-8 character, of the separator run
+  // before it, and for PATH_NATURAL of the number it's in.
+  iSync = i;
+  if (eCollate == PATH_COLLATE_NOCASE) {
+    // bytes before i are the same on both sides, and at i only the longer
+    // side has one, A being a prefix of B when i == nA
+    const unsigned char *zSync = i < nA ? zA : zB;
+    while (iSync > 0 && (zSync[iSync] & 0xC0) == 0x80)
+      iSync--;
+  }
+  while (iSync > 0 && zA[iSync - 1] == '/')
+    iSync--;
+  if (eCollate == PATH_COLLATE_NATURAL) {
+    while (iSync > 0 && pathIsDigit(zA[iSync - 1]))
+      iSync--;
+  }
+
+  a.z = zA;
+  a.n = nA;
+  a.i = iSync;
+  b.z = zB;
+  b.n = nB;
+  b.i = iSync;
+  for (;;) {
+    int cA = pathCollateNext(&a, eCollate);
+    int cB = pathCollateNext(&b, eCollate);
+    if (eCollate == PATH_COLLATE_NATURAL && pathIsDigit(cA - 1) &&
+        pathIsDigit(cB - 1)) {
+      int rc = pathCollateNumber(&a, &b, &tie);
+      if (rc)
+        return rc;
+      continue;
+    }
+    if (cA != cB)
+      return cA < cB ? -1 : 1;
+    if (cA < 0)
+      return tie;
+  }
+}
+
+static int pathCollateBinary(void *pArg, int nA, const void *pA, int nB,
+                             const void *pB) {
+  return pathCollate(PATH_COLLATE_BINARY, nA, pA, nB, pB);
+}
+
+static int pathCollateNocase(void *pArg, int nA, const void *pA, int nB,
+                             const void *pB) {
+  return pathCollate(PATH_COLLATE_NOCASE, nA, pA, nB, pB);
+}
+
+static int pathCollateNatural(void *pArg, int nA, const void *pA, int nB,
+                              const void *pB) {
+  return pathCollate(PATH_COLLATE_NATURAL, nA, pA, nB, pB);
+}
+
+#pragma endregion
+
+#pragma region sqlite - path table functions
+
+/*
+** A growable byte buffer owned by a table function cursor. Reused across
+** xFilter calls, so a correlated scan over many rows only allocates when a
+** path is longer than any it has seen before.
+*/
+typedef struct path_buffer path_buffer;
+struct path_buffer {
+  char *z;
+  sqlite3_int64 nAlloc;
+};
+
+static int pathBufferReserve(path_buffer *p, sqlite3_int64 n) {
+  char *z;
+  if (n <= p->nAlloc)
+    return SQLITE_OK;
+  z = sqlite3_realloc64(p->z, n);
+  if (z == NULL)
+    return SQLITE_NOMEM;
+  p->z = z;
+  p->nAlloc = n;
+  return SQLITE_OK;
+}
+
+static void pathBufferFree(path_buffer *p) {
+  sqlite3_free(p->z);
+  p->z = NULL;
+  p->nAlloc = 0;
+}
+
+/*
+** The paths a table function cursor yields rows for: the value of its path
+** argument, or every value of a "path IN (...)" constraint that SQLite hands
+** over all at once (see sqlite3_vtab_in()). The values are only valid during
+** xFilter, so they are copied back to back into one buffer owned by the
+** cursor, reused across xFilter calls. NULL paths are left out.
+*/
+typedef struct path_batch path_batch;
+struct path_batch {
+  path_buffer bytes;
+  sqlite3_int64 nBytes;
+  int nPath;
+  int nAlloc;
+  struct path_batch_entry {
+    sqlite3_int64 iOffset;
+    int nPath;
+    // SQLITE_TEXT or SQLITE_BLOB
+    int eType;
+  } *aPath;
+};
+
+static int pathBatchAppend(path_batch *p, sqlite3_value *value) {
+  struct path_batch_entry *pEntry;
+  const char *zPath;
+  int nPath;
+  int rc;
+  if (sqlite3_value_type(value) == SQLITE_NULL)
+    return SQLITE_OK;
+  zPath = pathValue(value, &nPath);
+  if (zPath == NULL)
+    return SQLITE_NOMEM;
+  if (p->nPath == p->nAlloc) {
+    int nAlloc = p->nAlloc ? p->nAlloc * 2 : 4;
+    struct path_batch_entry *aPath =
+        sqlite3_realloc64(p->aPath, sizeof(*aPath) * nAlloc);
+    if (aPath == NULL)
+      return SQLITE_NOMEM;
+    p->aPath = aPath;
+    p->nAlloc = nAlloc;
+  }
+  rc = pathBufferReserve(&p->bytes, p->nBytes + nPath + 1);
+  if (rc != SQLITE_OK)
+    return rc;
+  memcpy(p->bytes.z + p->nBytes, zPath, nPath);
+  pEntry = &p->aPath[p->nPath++];
+  pEntry->iOffset = p->nBytes;
+  pEntry->nPath = nPath;
+  pEntry->eType = sqlite3_value_type(value);
+  p->nBytes += nPath;
+  return SQLITE_OK;
+}
+
+/*
+** Replace the paths of the batch with value, or with every value of the IN
+** list it stands for if bIn is set.
+*/
+static int pathBatchLoad(path_batch *p, sqlite3_value *value, int bIn) {
+  sqlite3_value *pIn;
+  int rc;
+  p->nBytes = 0;
+  p->nPath = 0;
+  if (!bIn)
+    return pathBatchAppend(p, value);
+  for (rc = sqlite3_vtab_in_first(value, &pIn); rc == SQLITE_OK && pIn;
+       rc = sqlite3_vtab_in_next(value, &pIn)) {
+    rc = pathBatchAppend(p, pIn);
+    if (rc != SQLITE_OK)
+      return rc;
+  }
+  return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+static const char *pathBatchPath(const path_batch *p, int i, int *pnPath) {
+  *pnPath = p->aPath[i].nPath;
+  return p->bytes.z + p->aPath[i].iOffset;
+}
+
+static void pathBatchFree(path_batch *p) {
+  pathBufferFree(&p->bytes);
+  sqlite3_free(p->aPath);
+  memset(p, 0, sizeof(*p));
+}
+
+/** select * from path_parts(path)
+ * Table function that returns each segment for the given path.
+ * Return a table with the following schema:
+ * ```sql
+ * create table path_parts(
+ *  type text,        --
+ *  part text,       --x
+ *  path text hidden  -- input path
+ * )
+ * ```
+ *
+ */
+
+#define PATH_PARTS_SCHEMA "CREATE TABLE x(path hidden, type text, part text)"
+
+/*
+** path_parts and path_parse are registered once per path style, with one of
+** these as the pAux of sqlite3_create_module(). Each table keeps the style
+** of the module it was connected through.
+*/
+typedef struct path_module path_module;
+struct path_module {
+  const char *zName;
+  const char *zSchema;
+  const path_style *pStyle;
+};
+
+typedef struct path_vtab path_vtab;
+struct path_vtab {
+  sqlite3_vtab base;
+  const path_style *pStyle;
+};
+
+static const path_style *pathVtabStyle(sqlite3_vtab *pVtab) {
+  return ((path_vtab *)pVtab)->pStyle;
+}
+
+#define PATH_PARTS_COLUMN_ROWID -1
+#define PATH_PARTS_COLUMN_PATH 0
+#define PATH_PARTS_COLUMN_TYPE 1
+#define PATH_PARTS_COLUMN_SEGMENT 2
+
+// constraints besides "path = ?" that xBestIndex passes on to xFilter, as
+// idxNum flags. Their values follow the path in argv, in flag order.
+#define PATH_PARTS_INDEX_PART_EQ 0x01
+#define PATH_PARTS_INDEX_TYPE_EQ 0x02
+#define PATH_PARTS_INDEX_ROWID_EQ 0x04
+#define PATH_PARTS_INDEX_ROWID_GT 0x08
+#define PATH_PARTS_INDEX_ROWID_GE 0x10
+#define PATH_PARTS_INDEX_ROWID_LT 0x20
+#define PATH_PARTS_INDEX_ROWID_LE 0x40
+#define PATH_PARTS_INDEX_LIMIT 0x80
+#define PATH_PARTS_INDEX_OFFSET 0x100
+#define PATH_PARTS_INDEX_COUNT 9
+// ORDER BY rowid DESC was consumed, segments are yielded last to first
+#define PATH_PARTS_INDEX_DESC 0x10000
+// the path is a "path IN (...)" list, processed all at once
+#define PATH_PARTS_INDEX_PATH_IN 0x20000
+
+// estimated number of segments in a path, for the query planner
+#define PATH_PARTS_ESTIMATED_ROWS 8
+// more segments than any path has
+#define PATH_PARTS_MAX_ROWID 0x7fffffff
+
+typedef struct path_parts_cursor path_parts_cursor;
+struct path_parts_cursor {
+  // Base class - must be first
+  sqlite3_vtab_cursor base;
+  // index of the current segment
+  sqlite3_int64 iRowid;
+  // first segment and one past the last segment of the current path to
+  // yield, from any rowid constraints and LIMIT/OFFSET
+  sqlite3_int64 iBegin;
+  sqlite3_int64 iEnd;
+  // bounds from the rowid constraints, for every path
+  sqlite3_int64 iLower;
+  sqlite3_int64 iUpper;
+  sqlite3_int64 nLimit;
+  sqlite3_int64 nOffset;
+  // PATH_PARTS_INDEX_* flags of the constraints in use
+  int idxNum;
+  // segment type that "type = ?" matches, or -1
+  int iTypeEq;
+  // segment bytes that "part = ?" matches, and their type, if
+  // PATH_PARTS_INDEX_PART_EQ
+  path_buffer partEq;
+  int nPartEq;
+  int ePartEq;
+  // private copy of the paths whose segments are being yielded, since the
+  // xFilter arguments are only valid until the next row
+  path_batch batch;
+  // index in batch of the current path
+  int iPath;
+  // the current path and its type, SQLITE_TEXT or SQLITE_BLOB
+  const char *zPath;
+  int nPath;
+  int eType;
+  // segments of the current path. The cursor's buffers are reused by every
+  // rescan, so a correlated scan only allocates for paths longer (or
+  // deeper) than any before.
+  path_parsed parsed;
+};
+
+/*
+** The pathPartsReadConnect() method is invoked to create a new
+** pathParts_vtab that describes the pathParts_read virtual table.
+**
+** Think of this routine as the constructor for pathParts_vtab objects.
+**
+** All this routine needs to do is:
+**
+**    (1) Allocate the pathParts_vtab object and initialize all fields.
+**
+**    (2) Tell SQLite (via the sqlite3_declare_vtab() interface) what the
+**        result set of queries against pathParts_read will look like.
+**
+** path_parts and path_parse share this constructor, the schema to declare
+** and the path style are in the path_module given to sqlite3_create_module().
+*/
+static int pathPartsConnect(sqlite3 *db, void *pAux, int argcUnused,
+                            const char *const *argvUnused,
+                            sqlite3_vtab **ppVtab, char **pzErrUnused) {
+  const path_module *pModule = (const path_module *)pAux;
+  path_vtab *pNew;
+  int rc;
+  (void)argcUnused;
+  (void)argvUnused;
+  (void)pzErrUnused;
+  rc = sqlite3_declare_vtab(db, pModule->zSchema);
+  if (rc == SQLITE_OK) {
+    pNew = sqlite3_malloc(sizeof(*pNew));
+    if (pNew == 0)
+      return SQLITE_NOMEM;
+    memset(pNew, 0, sizeof(*pNew));
+    pNew->pStyle = pModule->pStyle;
+    *ppVtab = &pNew->base;
+    sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+  }
+  return rc;
+}
+
+/*
+** This method is the destructor for path_parts_cursor objects.
+*/
+static int pathPartsDisconnect(sqlite3_vtab *pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+/*
+** Constructor for a new path_parts_cursor object.
+*/
+static int pathPartsOpen(sqlite3_vtab *pUnused,
+                         sqlite3_vtab_cursor **ppCursor) {
+  path_parts_cursor *pCur;
+  (void)pUnused;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0)
+    return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pathParsedInit(&pCur->parsed);
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+/*
+** Destructor for a path_parts_cursor.
+*/
+static int pathPartsClose(sqlite3_vtab_cursor *cur) {
+  path_parts_cursor *pCur = (path_parts_cursor *)cur;
+  PATH_PROBE1(parts_close, pathVtabStyle(cur->pVtab)->eStyle);
+  pathBatchFree(&pCur->batch);
+  pathBufferFree(&pCur->partEq);
+  pathParsedFree(&pCur->parsed);
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+/*
+** Return TRUE if the cursor has been moved off of the last
+** row of output.
+*/
+static int pathPartsEof(sqlite3_vtab_cursor *cur) {
+  path_parts_cursor *pCur = (path_parts_cursor *)cur;
+  return pCur->iPath >= pCur->batch.nPath;
+}
+
+/*
+** Move the cursor to the first segment of the current path, starting at the
+** current one and in the scan's direction, that matches the pushed down
+** "part = ?" and "type = ?" constraints. Returns 0 if there is none.
+*/
+static int pathPartsSkip(path_parts_cursor *pCur) {
+  const path_parsed *parsed = &pCur->parsed;
+  int iStep = (pCur->idxNum & PATH_PARTS_INDEX_DESC) ? -1 : 1;
+  for (; pCur->iRowid >= pCur->iBegin && pCur->iRowid < pCur->iEnd;
+       pCur->iRowid += iStep) {
+    int i = (int)pCur->iRowid;
+    if (pCur->iTypeEq >= 0 && parsed->aType[i] != pCur->iTypeEq)
+      continue;
+    if ((pCur->idxNum & PATH_PARTS_INDEX_PART_EQ) &&
+        (parsed->aSize[i] != pCur->nPartEq ||
+         memcmp(pCur->zPath + parsed->aBegin[i], pCur->partEq.z,
+                pCur->nPartEq) != 0))
+      continue;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+** Move the cursor to the first matching segment of the next path in its
+** batch that has one, or past the last path.
+*/
+static int pathPartsNextPath(path_parts_cursor *pCur) {
+  while (++pCur->iPath < pCur->batch.nPath) {
+    sqlite3_int64 iBegin = pCur->iLower;
+    sqlite3_int64 iEnd = pCur->iUpper;
+    sqlite3_int64 nOffset = pCur->nOffset;
+    int rc;
+
+    pCur->zPath = pathBatchPath(&pCur->batch, pCur->iPath, &pCur->nPath);
+    pCur->eType = pCur->batch.aPath[pCur->iPath].eType;
+    rc = pathTokenize(pathVtabStyle(pCur->base.pVtab), pCur->zPath,
+                      pCur->nPath, &pCur->parsed);
+    if (rc != SQLITE_OK)
+      return rc;
+
+    if (iEnd > pCur->parsed.nSegment)
+      iEnd = pCur->parsed.nSegment;
+    // TEXT parts never equal a BLOB, or the other way around
+    if ((pCur->idxNum & PATH_PARTS_INDEX_PART_EQ) &&
+        pCur->ePartEq != pCur->eType)
+      iEnd = 0;
+    if (iBegin > iEnd)
+      iBegin = iEnd;
+    // LIMIT and OFFSET are only used when no other filter is, so they count
+    // segments of the [iBegin, iEnd) range from the start of the scan
+    if (nOffset > 0) {
+      if (nOffset > iEnd - iBegin)
+        nOffset = iEnd - iBegin;
+      if (pCur->idxNum & PATH_PARTS_INDEX_DESC)
+        iEnd -= nOffset;
+      else
+        iBegin += nOffset;
+    }
+    if (pCur->nLimit >= 0 && pCur->nLimit < iEnd - iBegin) {
+      if (pCur->idxNum & PATH_PARTS_INDEX_DESC)
+        iBegin = iEnd - pCur->nLimit;
+      else
+        iEnd = iBegin + pCur->nLimit;
+    }
+
+    pCur->iBegin = iBegin;
+    pCur->iEnd = iEnd;
+    pCur->iRowid = (pCur->idxNum & PATH_PARTS_INDEX_DESC) ? iEnd - 1 : iBegin;
+    if (pathPartsSkip(pCur))
+      break;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Advance a path_parts_cursor to its next row of output.
+*/
+static int pathPartsStep(path_parts_cursor *pCur) {
+  pCur->iRowid += (pCur->idxNum & PATH_PARTS_INDEX_DESC) ? -1 : 1;
+  if (pathPartsSkip(pCur))
+    return SQLITE_OK;
+  return pathPartsNextPath(pCur);
+}
+
+static int pathPartsNext(sqlite3_vtab_cursor *cur) {
+  path_parts_cursor *pCur = (path_parts_cursor *)cur;
+  path_stats_counters *pStats;
+  sqlite3_int64 iStart;
+  int rc;
+  if (!pathStatsEnabled && !PATH_PROBE_ENABLED(parts_next))
+    return pathPartsStep(pCur);
+  pStats = pathStatsEnabled ? pathStatsSlot(PATH_STATS_PARTS_NEXT +
+                                            pathVtabStyle(cur->pVtab)->eStyle)
+                            : NULL;
+  if (pStats == NULL) {
+    rc = pathPartsStep(pCur);
+  } else {
+    iStart = pathStatsNow();
+    rc = pathPartsStep(pCur);
+    pStats->nNs += pathStatsNow() - iStart;
+    pStats->nCall++;
+  }
+  PATH_PROBE3(parts_next, pathVtabStyle(cur->pVtab)->eStyle, pCur->iRowid, rc);
+  return rc;
+}
+
+/*
+** Return values of columns for the row at which the path_parts_cursor
+** is currently pointing.
+*/
+static int pathPartsColumn(
+    sqlite3_vtab_cursor *cur, /* The cursor */
+    sqlite3_context *ctx,     /* First argument to sqlite3_result_...() */
+    int i                     /* Which column to return */
+) {
+  path_parts_cursor *pCur = (path_parts_cursor *)cur;
+  int iSegment = (int)pCur->iRowid;
+  switch (i) {
+  case PATH_PARTS_COLUMN_PATH: {
+    pathResult(ctx, pCur->eType, pCur->zPath, pCur->nPath, SQLITE_TRANSIENT);
+    break;
+  }
+  case PATH_PARTS_COLUMN_TYPE: {
+    switch (pCur->parsed.aType[iSegment]) {
+    case CWK_NORMAL:
+      sqlite3_result_text(ctx, "normal", -1, SQLITE_STATIC);
+      break;
+    case CWK_CURRENT:
+      sqlite3_result_text(ctx, "current", -1, SQLITE_STATIC);
+      break;
+    case CWK_BACK:
+      sqlite3_result_text(ctx, "back", -1, SQLITE_STATIC);
+      break;
+    }
+    break;
+  }
+  case PATH_PARTS_COLUMN_SEGMENT: {
+    pathResult(ctx, pCur->eType, pCur->zPath + pCur->parsed.aBegin[iSegment],
+               pCur->parsed.aSize[iSegment], SQLITE_TRANSIENT);
+    break;
+  }
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Return the rowid for the current row. In this implementation, the
+** first row returned is assigned rowid value 1, and each subsequent
+** row a value 1 more than that of the previous.
+*/
+static int pathPartsRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+  path_parts_cursor *pCur = (path_parts_cursor *)cur;
+  *pRowid = pCur->iRowid;
+  return SQLITE_OK;
+}
+
+/*
+** SQLite will invoke this method one or more times while planning a query
+** that uses the pathParts_read virtual table.  This routine needs to create
+** a query plan for each invocation and compute an estimated cost for that
+** plan.
+*/
+
+/*
+** Use the required "path = ?" constraint of path_parts and path_parse as the
+** first argument to xFilter. If it's a "path IN (...)" that SQLite can hand
+** over all at once, that's requested and *pbIn is set, and the argument is
+** to be loaded with pathBatchLoad().
+*/
+static int pathBestIndexPath(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo,
+                             int *pbIn) {
+  int hasPath = 0;
+  int hasUnusablePath = 0;
+  *pbIn = 0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+    // iColumn of LIMIT and OFFSET is meaningless
+    if (pCons->op == SQLITE_INDEX_CONSTRAINT_LIMIT ||
+        pCons->op == SQLITE_INDEX_CONSTRAINT_OFFSET)
+      continue;
+    if (pCons->iColumn != PATH_PARTS_COLUMN_PATH ||
+        pCons->op != SQLITE_INDEX_CONSTRAINT_EQ || hasPath)
+      continue;
+    if (!pCons->usable) {
+      hasUnusablePath = 1;
+      continue;
+    }
+    hasPath = 1;
+    pIdxInfo->aConstraintUsage[i].argvIndex = 1;
+    pIdxInfo->aConstraintUsage[i].omit = 1;
+    // sqlite3_vtab_in() is new in SQLite 3.38.0
+    if (sqlite3_libversion_number() >= 3038000 &&
+        sqlite3_vtab_in(pIdxInfo, i, -1))
+      *pbIn = sqlite3_vtab_in(pIdxInfo, i, 1);
+  }
+  if (!hasPath && hasUnusablePath)
+    return SQLITE_CONSTRAINT;
+  if (!hasPath) {
+    pVTab->zErrMsg = sqlite3_mprintf("path argument is required");
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Returns the PATH_PARTS_INDEX_* flag for the i-th constraint on a column
+** of path_parts, or 0 if the cursor can't make use of it.
+*/
+static int pathPartsConstraintFlag(sqlite3_index_info *pIdxInfo, int i) {
+  const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+  switch (pCons->iColumn) {
+  case PATH_PARTS_COLUMN_SEGMENT:
+  case PATH_PARTS_COLUMN_TYPE:
+    if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ ||
+        sqlite3_stricmp(sqlite3_vtab_collation(pIdxInfo, i), "BINARY") != 0)
+      return 0;
+    return pCons->iColumn == PATH_PARTS_COLUMN_SEGMENT
+               ? PATH_PARTS_INDEX_PART_EQ
+               : PATH_PARTS_INDEX_TYPE_EQ;
+  case PATH_PARTS_COLUMN_ROWID:
+    switch (pCons->op) {
+    case SQLITE_INDEX_CONSTRAINT_EQ:
+      return PATH_PARTS_INDEX_ROWID_EQ;
+    case SQLITE_INDEX_CONSTRAINT_GT:
+      return PATH_PARTS_INDEX_ROWID_GT;
+    case SQLITE_INDEX_CONSTRAINT_GE:
+      return PATH_PARTS_INDEX_ROWID_GE;
+    case SQLITE_INDEX_CONSTRAINT_LT:
+      return PATH_PARTS_INDEX_ROWID_LT;
+    case SQLITE_INDEX_CONSTRAINT_LE:
+      return PATH_PARTS_INDEX_ROWID_LE;
+    }
+    break;
+  }
+  return 0;
+}
+
+/*
+** Besides the path, "part = ?", "type = ?" and comparisons on rowid are
+** passed to xFilter so the cursor can skip segments that can't match and stop
+** at the last one that can. They aren't omitted: the cursor only skips rows
+** it is sure of, and SQLite still checks every row it returns, so values of
+** other types or collations than the cursor understands stay correct.
+**
+** ORDER BY rowid is always consumed, DESC by walking the segments backward.
+** LIMIT and OFFSET are consumed when there's no other ORDER BY and no other
+** constraint left for SQLite to check, since only then are the rows the
+** cursor yields exactly the result rows, in order.
+*/
+static int pathPartsBestIndex(sqlite3_vtab *pVTab,
+                              sqlite3_index_info *pIdxInfo) {
+  // constraint used for each PATH_PARTS_INDEX_* flag, by flag bit
+  int aCons[PATH_PARTS_INDEX_COUNT];
+  int idxNum = 0;
+  int iArg = 2;
+  // number of constraints other than path, LIMIT and OFFSET, plus one for
+  // an ORDER BY SQLite has to sort by or an IN list of paths
+  int nChecked = 0;
+  int bIn;
+  double nRow = PATH_PARTS_ESTIMATED_ROWS;
+  int rc = pathBestIndexPath(pVTab, pIdxInfo, &bIn);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  // the segments of several paths aren't in rowid order, and LIMIT/OFFSET
+  // count rows across all of them
+  if (bIn) {
+    idxNum |= PATH_PARTS_INDEX_PATH_IN;
+    nChecked++;
+  }
+  if (!bIn && pIdxInfo->nOrderBy == 1 &&
+      pIdxInfo->aOrderBy[0].iColumn == PATH_PARTS_COLUMN_ROWID) {
+    pIdxInfo->orderByConsumed = 1;
+    if (pIdxInfo->aOrderBy[0].desc)
+      idxNum |= PATH_PARTS_INDEX_DESC;
+  }
+  if (pIdxInfo->nOrderBy > 0 && !pIdxInfo->orderByConsumed)
+    nChecked++;
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+    if (pCons->op != SQLITE_INDEX_CONSTRAINT_LIMIT &&
+        pCons->op != SQLITE_INDEX_CONSTRAINT_OFFSET &&
+        pCons->iColumn != PATH_PARTS_COLUMN_PATH)
+      nChecked++;
+  }
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+    int flag = 0;
+    if (!pCons->usable)
+      continue;
+    if (pCons->op == SQLITE_INDEX_CONSTRAINT_LIMIT)
+      flag = nChecked == 0 ? PATH_PARTS_INDEX_LIMIT : 0;
+    else if (pCons->op == SQLITE_INDEX_CONSTRAINT_OFFSET)
+      flag = nChecked == 0 ? PATH_PARTS_INDEX_OFFSET : 0;
+    else
+      flag = pathPartsConstraintFlag(pIdxInfo, i);
+    if (flag == 0 || (idxNum & flag))
+      continue;
+    idxNum |= flag;
+    aCons[pathCtz64(flag)] = i;
+  }
+
+  for (int b = 0; b < PATH_PARTS_INDEX_COUNT; b++) {
+    if (idxNum & (1 << b))
+      pIdxInfo->aConstraintUsage[aCons[b]].argvIndex = iArg++;
+  }
+  // SQLite skips the OFFSET itself unless it's omitted, LIMIT is always
+  // applied again so it can stay
+  if (idxNum & PATH_PARTS_INDEX_OFFSET)
+    pIdxInfo->aConstraintUsage[aCons[pathCtz64(PATH_PARTS_INDEX_OFFSET)]]
+        .omit = 1;
+
+  if (idxNum & (PATH_PARTS_INDEX_PART_EQ | PATH_PARTS_INDEX_ROWID_EQ))
+    nRow = 1;
+  if (idxNum & PATH_PARTS_INDEX_TYPE_EQ)
+    nRow /= 2;
+  if (idxNum & (PATH_PARTS_INDEX_ROWID_GT | PATH_PARTS_INDEX_ROWID_GE))
+    nRow /= 2;
+  if (idxNum & (PATH_PARTS_INDEX_ROWID_LT | PATH_PARTS_INDEX_ROWID_LE))
+    nRow /= 2;
+  if (idxNum & PATH_PARTS_INDEX_ROWID_EQ)
+    pIdxInfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+  pIdxInfo->idxNum = idxNum;
+  pIdxInfo->estimatedRows = nRow < 1 ? 1 : (sqlite3_int64)nRow;
+  pIdxInfo->estimatedCost = nRow;
+
+  return SQLITE_OK;
+}
+
+/*
+** Returns the segment type named by a "type = ?" value, or -1 if no segment
+** has that type.
+*/
+static int pathPartsTypeEq(sqlite3_value *value) {
+  const char *z;
+  if (sqlite3_value_type(value) != SQLITE_TEXT)
+    return -1;
+  z = (const char *)sqlite3_value_text(value);
+  if (z == NULL)
+    return -1;
+  if (strcmp(z, "normal") == 0)
+    return CWK_NORMAL;
+  if (strcmp(z, "current") == 0)
+    return CWK_CURRENT;
+  if (strcmp(z, "back") == 0)
+    return CWK_BACK;
+  return -1;
+}
+
+/*
+** This method is called to "rewind" the path_parts_cursor object back
+** to the first row of output.  This method is always called at least
+** once prior to any call to xColumn() or xRowid() or xEof().
+**
+** This routine should initialize the cursor and position it so that it
+** is pointing at the first row, or pointing off the end of the table
+** (so that xEof() will return true) if the table is empty.
+*/
+/*
+** Start a path_parts scan, see pathPartsFilter().
+*/
+static int pathPartsStart(path_parts_cursor *pCur, int idxNum,
+                          sqlite3_value **argv) {
+  int iArg = 1;
+  int rc;
+  pCur->idxNum = idxNum;
+  pCur->iTypeEq = -1;
+  pCur->iLower = 0;
+  pCur->iUpper = PATH_PARTS_MAX_ROWID;
+  pCur->nLimit = -1;
+  pCur->nOffset = 0;
+  pCur->iPath = -1;
+  rc = pathBatchLoad(&pCur->batch, argv[0],
+                     (idxNum & PATH_PARTS_INDEX_PATH_IN) != 0);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  for (int b = 0; b < PATH_PARTS_INDEX_COUNT; b++) {
+    sqlite3_value *value;
+    int eType;
+    sqlite3_int64 iValue;
+    if (!(idxNum & (1 << b)))
+      continue;
+    value = argv[iArg++];
+    eType = sqlite3_value_type(value);
+    switch (1 << b) {
+    case PATH_PARTS_INDEX_PART_EQ: {
+      const char *z;
+      // numbers are compared as text, leave them to SQLite
+      if (eType == SQLITE_INTEGER || eType == SQLITE_FLOAT) {
+        pCur->idxNum &= ~PATH_PARTS_INDEX_PART_EQ;
+        break;
+      }
+      // NULL doesn't equal any part
+      pCur->ePartEq = eType;
+      if (eType == SQLITE_NULL)
+        break;
+      z = pathValue(value, &pCur->nPartEq);
+      if (z == NULL)
+        return SQLITE_NOMEM;
+      rc = pathBufferReserve(&pCur->partEq, pCur->nPartEq + 1);
+      if (rc != SQLITE_OK)
+        return rc;
+      memcpy(pCur->partEq.z, z, pCur->nPartEq);
+      break;
+    }
+    case PATH_PARTS_INDEX_TYPE_EQ:
+      pCur->iTypeEq = pathPartsTypeEq(value);
+      if (pCur->iTypeEq < 0)
+        pCur->iUpper = 0;
+      break;
+    case PATH_PARTS_INDEX_LIMIT:
+      pCur->nLimit = sqlite3_value_int64(value);
+      break;
+    case PATH_PARTS_INDEX_OFFSET:
+      pCur->nOffset = sqlite3_value_int64(value);
+      break;
+    default:
+      // rowid bounds are only applied for integers, SQLite checks the rest
+      if (eType != SQLITE_INTEGER)
+        break;
+      iValue = sqlite3_value_int64(value);
+      switch (1 << b) {
+      case PATH_PARTS_INDEX_ROWID_EQ:
+        if (iValue > pCur->iLower)
+          pCur->iLower = iValue;
+        if (iValue < pCur->iUpper)
+          pCur->iUpper = iValue + 1;
+        break;
+      case PATH_PARTS_INDEX_ROWID_GT:
+        if (iValue >= pCur->iLower)
+          pCur->iLower = iValue < pCur->iUpper ? iValue + 1 : pCur->iUpper;
+        break;
+      case PATH_PARTS_INDEX_ROWID_GE:
+        if (iValue > pCur->iLower)
+          pCur->iLower = iValue;
+        break;
+      case PATH_PARTS_INDEX_ROWID_LT:
+        if (iValue < pCur->iUpper)
+          pCur->iUpper = iValue;
+        break;
+      case PATH_PARTS_INDEX_ROWID_LE:
+        if (iValue < pCur->iUpper)
+          pCur->iUpper = iValue + 1;
+        break;
+      }
+      break;
+    }
+  }
+
+  return pathPartsNextPath(pCur);
+}
+
+static int pathPartsFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                           const char *idxStr, int argc, sqlite3_value **argv) {
+  path_parts_cursor *pCur = (path_parts_cursor *)pVtabCursor;
+  path_stats_counters *pStats;
+  sqlite3_int64 iStart;
+  int rc;
+  if (!pathStatsEnabled && !PATH_PROBE_ENABLED(parts_filter_entry) &&
+      !PATH_PROBE_ENABLED(parts_filter_return))
+    return pathPartsStart(pCur, idxNum, argv);
+  PATH_PROBE1(parts_filter_entry, pathVtabStyle(pVtabCursor->pVtab)->eStyle);
+  pStats = pathStatsEnabled
+               ? pathStatsSlot(PATH_STATS_PARTS_FILTER +
+                               pathVtabStyle(pVtabCursor->pVtab)->eStyle)
+               : NULL;
+  if (pStats == NULL) {
+    rc = pathPartsStart(pCur, idxNum, argv);
+  } else {
+    iStart = pathStatsNow();
+    rc = pathPartsStart(pCur, idxNum, argv);
+    pStats->nNs += pathStatsNow() - iStart;
+    pStats->nCall++;
+    pStats->nBytesIn += pCur->batch.nBytes;
+  }
+  PATH_PROBE3(parts_filter_return, pathVtabStyle(pVtabCursor->pVtab)->eStyle,
+              pCur->batch.nBytes, rc);
+  return rc;
+}
+
+static sqlite3_module pathPartsModule = {
+    0,                   /* iVersion */
+    0,                   /* xCreate */
+    pathPartsConnect,    /* xConnect */
+    pathPartsBestIndex,  /* xBestIndex */
+    pathPartsDisconnect, /* xDisconnect */
+    0,                   /* xDestroy */
+    pathPartsOpen,       /* xOpen - open a cursor */
+    pathPartsClose,      /* xClose - close a cursor */
+    pathPartsFilter,     /* xFilter - configure scan constraints */
+    pathPartsNext,       /* xNext - advance a cursor */
+    pathPartsEof,        /* xEof - check for end of scan */
+    pathPartsColumn,     /* xColumn - read data */
+    pathPartsRowid,      /* xRowid - read data */
+    0,                   /* xUpdate */
+    0,                   /* xBegin */
+    0,                   /* xSync */
+    0,                   /* xCommit */
+    0,                   /* xRollback */
+    0,                   /* xFindMethod */
+    0,                   /* xRename */
+    0,                   /* xSavepoint */
+    0,                   /* xRelease */
+    0,                   /* xRollbackTo */
+    0                    /* xShadowName */
+};
+
+/** select * from path_parse(path)
+ * Table function that returns a single row with every component of the given
+ * path, parsing it once. Return a table with the following schema:
+ * ```sql
+ * create table path_parse(
+ *  dirname text,      -- path_dirname(path)
+ *  basename text,     -- path_basename(path)
+ *  name text,         -- path_name(path)
+ *  extension text,    -- path_extension(path)
+ *  root text,         -- path_root(path)
+ *  depth int,         -- path_length(path)
+ *  is_absolute int,   -- path_absolute(path)
+ *  normalized text,   -- path_normalize(path)
+ *  path text hidden   -- input path
+ * )
+ * ```
+ * Only the columns a query uses are computed.
+ */
+
+#define PATH_PARSE_SCHEMA                                                      \
+  "CREATE TABLE x(path hidden, dirname text, basename text, name text, "      \
+  "extension text, root text, depth int, is_absolute int, normalized text)"
+
+#define PATH_PARSE_COLUMN_PATH 0
+#define PATH_PARSE_COLUMN_DIRNAME 1
+#define PATH_PARSE_COLUMN_BASENAME 2
+#define PATH_PARSE_COLUMN_NAME 3
+#define PATH_PARSE_COLUMN_EXTENSION 4
+#define PATH_PARSE_COLUMN_ROOT 5
+#define PATH_PARSE_COLUMN_DEPTH 6
+#define PATH_PARSE_COLUMN_IS_ABSOLUTE 7
+#define PATH_PARSE_COLUMN_NORMALIZED 8
+
+// columns computed from the tokenized path, as a colUsed mask
+#define PATH_PARSE_PARSED_COLUMNS                                              \
+  ((1 << PATH_PARSE_COLUMN_DIRNAME) | (1 << PATH_PARSE_COLUMN_BASENAME) |      \
+   (1 << PATH_PARSE_COLUMN_NAME) | (1 << PATH_PARSE_COLUMN_EXTENSION) |        \
+   (1 << PATH_PARSE_COLUMN_ROOT) | (1 << PATH_PARSE_COLUMN_DEPTH) |            \
+   (1 << PATH_PARSE_COLUMN_IS_ABSOLUTE))
+
+// the path is a "path IN (...)" list, processed all at once
+#define PATH_PARSE_INDEX_PATH_IN 0x40000000
+
+typedef struct path_parse_cursor path_parse_cursor;
+struct path_parse_cursor {
+  // Base class - must be first
+  sqlite3_vtab_cursor base;
+  // colUsed mask and PATH_PARSE_INDEX_PATH_IN from xBestIndex
+  int idxNum;
+  // private copy of the paths to parse, one row each
+  path_batch batch;
+  // index in batch of the current path, which is also the rowid
+  int iPath;
+  // the current path and its type, SQLITE_TEXT or SQLITE_BLOB
+  const char *zPath;
+  int nPath;
+  int eType;
+  // normalized path, only if the normalized column is used
+  path_buffer normalized;
+  int nNormalized;
+  // tokenized path, only if any other component is used
+  path_parsed parsed;
+};
+
+static int pathParseOpen(sqlite3_vtab *pUnused,
+                         sqlite3_vtab_cursor **ppCursor) {
+  path_parse_cursor *pCur;
+  (void)pUnused;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0)
+    return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pathParsedInit(&pCur->parsed);
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int pathParseClose(sqlite3_vtab_cursor *cur) {
+  path_parse_cursor *pCur = (path_parse_cursor *)cur;
+  pathBatchFree(&pCur->batch);
+  pathBufferFree(&pCur->normalized);
+  pathParsedFree(&pCur->parsed);
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int pathParseEof(sqlite3_vtab_cursor *cur) {
+  path_parse_cursor *pCur = (path_parse_cursor *)cur;
+  return pCur->iPath >= pCur->batch.nPath;
+}
+
+/*
+** Compute the components of the current path that the query uses.
+*/
+static int pathParseLoad(path_parse_cursor *pCur) {
+  int rc = SQLITE_OK;
+  if (pathParseEof(&pCur->base))
+    return SQLITE_OK;
+  pCur->zPath = pathBatchPath(&pCur->batch, pCur->iPath, &pCur->nPath);
+  pCur->eType = pCur->batch.aPath[pCur->iPath].eType;
+
+  if (pCur->idxNum & PATH_PARSE_PARSED_COLUMNS) {
+    rc = pathTokenize(pathVtabStyle(pCur->base.pVtab), pCur->zPath,
+                      pCur->nPath, &pCur->parsed);
+    if (rc != SQLITE_OK)
+      return rc;
+  }
+  if (pCur->idxNum & (1 << PATH_PARSE_COLUMN_NORMALIZED)) {
+    path_builder builder;
+    rc = pathBufferReserve(&pCur->normalized, pathBuilderSize(pCur->nPath, 1));
+    if (rc != SQLITE_OK)
+      return rc;
+    pathBuilderInit(&builder, pathVtabStyle(pCur->base.pVtab),
+                    pCur->normalized.z);
+    rc = pathBuilderAppend(&builder, pCur->zPath, pCur->nPath);
+    if (rc == SQLITE_OK)
+      pCur->nNormalized = pathBuilderFinish(&builder);
+    pathBuilderFree(&builder);
+  }
+  return rc;
+}
+
+static int pathParseNext(sqlite3_vtab_cursor *cur) {
+  path_parse_cursor *pCur = (path_parse_cursor *)cur;
+  pCur->iPath++;
+  return pathParseLoad(pCur);
+}
+
+static int pathParseColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx,
+                           int i) {
+  path_parse_cursor *pCur = (path_parse_cursor *)cur;
+  const path_parsed *parsed = &pCur->parsed;
+  const char *zPath = pCur->zPath;
+  int last = parsed->nSegment - 1;
+  switch (i) {
+  case PATH_PARSE_COLUMN_PATH:
+    pathResult(ctx, pCur->eType, zPath, pCur->nPath, SQLITE_TRANSIENT);
+    break;
+  case PATH_PARSE_COLUMN_DIRNAME:
+    if (last >= 0 && parsed->aBegin[last] > 0)
+      pathResult(ctx, pCur->eType, zPath, parsed->aBegin[last],
+                 SQLITE_TRANSIENT);
+    break;
+  case PATH_PARSE_COLUMN_BASENAME:
+    if (last >= 0)
+      pathResult(ctx, pCur->eType, zPath + parsed->aBegin[last],
+                 parsed->aSize[last], SQLITE_TRANSIENT);
+    break;
+  case PATH_PARSE_COLUMN_NAME:
+    if (last >= 0)
+      pathResult(ctx, pCur->eType, zPath + parsed->aBegin[last],
+                 parsed->nName, SQLITE_TRANSIENT);
+    break;
+  case PATH_PARSE_COLUMN_EXTENSION:
+    if (parsed->nExtension > 0)
+      pathResult(ctx, pCur->eType, zPath + parsed->iExtension,
+                 parsed->nExtension, SQLITE_TRANSIENT);
+    break;
+  case PATH_PARSE_COLUMN_ROOT:
+    pathResult(ctx, pCur->eType, zPath, parsed->nRoot, SQLITE_TRANSIENT);
+    break;
+  case PATH_PARSE_COLUMN_DEPTH:
+    sqlite3_result_int(ctx, parsed->nSegment);
+    break;
+  case PATH_PARSE_COLUMN_IS_ABSOLUTE:
+    sqlite3_result_int(ctx, parsed->absolute);
+    break;
+  case PATH_PARSE_COLUMN_NORMALIZED:
+    pathResult(ctx, pCur->eType, pCur->normalized.z, pCur->nNormalized,
+               SQLITE_TRANSIENT);
+    break;
+  }
+  return SQLITE_OK;
+}
+
+static int pathParseRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+  *pRowid = ((path_parse_cursor *)cur)->iPath;
+  return SQLITE_OK;
+}
+
+/*
+** idxNum is the colUsed mask of the query, so xFilter only computes the
+** components that are read.
+*/
+static int pathParseBestIndex(sqlite3_vtab *pVTab,
+                              sqlite3_index_info *pIdxInfo) {
+  int bIn;
+  int rc = pathBestIndexPath(pVTab, pIdxInfo, &bIn);
+  if (rc != SQLITE_OK)
+    return rc;
+  pIdxInfo->idxNum = (int)(pIdxInfo->colUsed & ~PATH_PARSE_INDEX_PATH_IN &
+                           0x7fffffff);
+  if (bIn) {
+    pIdxInfo->idxNum |= PATH_PARSE_INDEX_PATH_IN;
+  } else {
+    pIdxInfo->estimatedCost = (double)1;
+    pIdxInfo->estimatedRows = 1;
+    pIdxInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+  }
+  return SQLITE_OK;
+}
+
+static int pathParseFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                           const char *idxStr, int argc, sqlite3_value **argv) {
+  path_parse_cursor *pCur = (path_parse_cursor *)pVtabCursor;
+  int rc;
+  pCur->idxNum = idxNum;
+  pCur->iPath = 0;
+  rc = pathBatchLoad(&pCur->batch, argv[0],
+                     (idxNum & PATH_PARSE_INDEX_PATH_IN) != 0);
+  if (rc != SQLITE_OK)
+    return rc;
+  return pathParseLoad(pCur);
+}
+
+static sqlite3_module pathParseModule = {
+    0,                   /* iVersion */
+    0,                   /* xCreate */
+    pathPartsConnect,    /* xConnect */
+    pathParseBestIndex,  /* xBestIndex */
+    pathPartsDisconnect, /* xDisconnect */
+    0,                   /* xDestroy */
+    pathParseOpen,       /* xOpen - open a cursor */
+    pathParseClose,      /* xClose - close a cursor */
+    pathParseFilter,     /* xFilter - configure scan constraints */
+    pathParseNext,       /* xNext - advance a cursor */
+    pathParseEof,        /* xEof - check for end of scan */
+    pathParseColumn,     /* xColumn - read data */
+    pathParseRowid,      /* xRowid - read data */
+    0,                   /* xUpdate */
+    0,                   /* xBegin */
+    0,                   /* xSync */
+    0,                   /* xCommit */
+    0,                   /* xRollback */
+    0,                   /* xFindMethod */
+    0,                   /* xRename */
+    0,                   /* xSavepoint */
+    0,                   /* xRelease */
+    0,                   /* xRollbackTo */
+    0                    /* xShadowName */
+};
+
+/** select * from path_ancestors(path, [max_depth])
+ * Table function that returns every ancestor of the given path, from its
+ * root down to its parent, parsing it once. Each prefix is a slice of the
+ * path as given, not re-derived from the previous one, so it isn't
+ * normalized: wrap the path in path_normalize() first if it needs to be.
+ * Relative paths have no root row. Return a table with the following schema:
+ * ```sql
+ * create table path_ancestors(
+ *  prefix text,          -- the path up to and including this ancestor
+ *  depth int,            -- segments in prefix, 0 for the root
+ *  path text hidden,     -- input path
+ *  max_depth int hidden  -- deepest prefix to return
+ * )
+ * ```
+ */
+
+#define PATH_ANCESTORS_SCHEMA                                                  \
+  "CREATE TABLE x(path hidden, max_depth hidden, prefix text, depth int)"
+
+#define PATH_ANCESTORS_COLUMN_PATH 0
+#define PATH_ANCESTORS_COLUMN_MAX_DEPTH 1
+#define PATH_ANCESTORS_COLUMN_PREFIX 2
+#define PATH_ANCESTORS_COLUMN_DEPTH 3
+
+// "max_depth = ?" was handed to xFilter, after the path
+#define PATH_ANCESTORS_INDEX_MAX_DEPTH 0x01
+// the path is a "path IN (...)" list, processed all at once
+#define PATH_ANCESTORS_INDEX_PATH_IN 0x02
+
+typedef struct path_ancestors_cursor path_ancestors_cursor;
+struct path_ancestors_cursor {
+  // Base class - must be first
+  sqlite3_vtab_cursor base;
+  // PATH_ANCESTORS_INDEX_* flags from xBestIndex
+  int idxNum;
+  sqlite3_int64 iRowid;
+  // deepest prefix to yield, from max_depth
+  int nMaxDepth;
+  // private copy of the paths whose ancestors are yielded
+  path_batch batch;
+  // index in batch of the current path
+  int iPath;
+  // the current path and its type, SQLITE_TEXT or SQLITE_BLOB
+  const char *zPath;
+  int nPath;
+  int eType;
+  // segments of the current path, and the depth of the current prefix and
+  // of the last one to yield
+  path_parsed parsed;
+  int iDepth;
+  int nDepth;
+};
+
+static int pathAncestorsOpen(sqlite3_vtab *pUnused,
+                             sqlite3_vtab_cursor **ppCursor) {
+  path_ancestors_cursor *pCur;
+  (void)pUnused;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0)
+    return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pathParsedInit(&pCur->parsed);
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int pathAncestorsClose(sqlite3_vtab_cursor *cur) {
+  path_ancestors_cursor *pCur = (path_ancestors_cursor *)cur;
+  pathBatchFree(&pCur->batch);
+  pathParsedFree(&pCur->parsed);
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int pathAncestorsEof(sqlite3_vtab_cursor *cur) {
+  path_ancestors_cursor *pCur = (path_ancestors_cursor *)cur;
+  return pCur->iPath >= pCur->batch.nPath;
+}
+
+/*
+** Move to the first ancestor of the current path, or of the next path that
+** has one.
+*/
+static int pathAncestorsLoad(path_ancestors_cursor *pCur) {
+  const path_style *pStyle = pathVtabStyle(pCur->base.pVtab);
+  for (; !pathAncestorsEof(&pCur->base); pCur->iPath++) {
+    int rc;
+    pCur->zPath = pathBatchPath(&pCur->batch, pCur->iPath, &pCur->nPath);
+    pCur->eType = pCur->batch.aPath[pCur->iPath].eType;
+    rc = pathTokenize(pStyle, pCur->zPath, pCur->nPath, &pCur->parsed);
+    if (rc != SQLITE_OK)
+      return rc;
+    // the last segment is the path itself
+    pCur->nDepth = pCur->parsed.nSegment - 1;
+    if (pCur->nDepth > pCur->nMaxDepth)
+      pCur->nDepth = pCur->nMaxDepth;
+    pCur->iDepth = pCur->parsed.nRoot > 0 ? 0 : 1;
+    if (pCur->iDepth <= pCur->nDepth)
+      return SQLITE_OK;
+  }
+  return SQLITE_OK;
+}
+
+static int pathAncestorsNext(sqlite3_vtab_cursor *cur) {
+  path_ancestors_cursor *pCur = (path_ancestors_cursor *)cur;
+  pCur->iRowid++;
+  if (++pCur->iDepth <= pCur->nDepth)
+    return SQLITE_OK;
+  pCur->iPath++;
+  return pathAncestorsLoad(pCur);
+}
+
+static int pathAncestorsColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx,
+                               int i) {
+  path_ancestors_cursor *pCur = (path_ancestors_cursor *)cur;
+  const path_parsed *parsed = &pCur->parsed;
+  switch (i) {
+  case PATH_ANCESTORS_COLUMN_PATH:
+    pathResult(ctx, pCur->eType, pCur->zPath, pCur->nPath, SQLITE_TRANSIENT);
+    break;
+  case PATH_ANCESTORS_COLUMN_MAX_DEPTH:
+    if (pCur->idxNum & PATH_ANCESTORS_INDEX_MAX_DEPTH)
+      sqlite3_result_int(ctx, pCur->nMaxDepth);
+    break;
+  case PATH_ANCESTORS_COLUMN_PREFIX: {
+    int d = pCur->iDepth;
+    int nPrefix =
+        d == 0 ? parsed->nRoot : parsed->aBegin[d - 1] + parsed->aSize[d - 1];
+    pathResult(ctx, pCur->eType, pCur->zPath, nPrefix, SQLITE_TRANSIENT);
+    break;
+  }
+  case PATH_ANCESTORS_COLUMN_DEPTH:
+    sqlite3_result_int(ctx, pCur->iDepth);
+    break;
+  }
+  return SQLITE_OK;
+}
+
+static int pathAncestorsRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+  *pRowid = ((path_ancestors_cursor *)cur)->iRowid;
+  return SQLITE_OK;
+}
+
+/*
+** Besides the path, "max_depth = ?" is handed to xFilter, so deeper
+** prefixes are never yielded.
+*/
+static int pathAncestorsBestIndex(sqlite3_vtab *pVTab,
+                                  sqlite3_index_info *pIdxInfo) {
+  int bIn;
+  int rc = pathBestIndexPath(pVTab, pIdxInfo, &bIn);
+  if (rc != SQLITE_OK)
+    return rc;
+  pIdxInfo->idxNum = bIn ? PATH_ANCESTORS_INDEX_PATH_IN : 0;
+  pIdxInfo->estimatedRows = PATH_PARTS_ESTIMATED_ROWS;
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+    if (pCons->iColumn != PATH_ANCESTORS_COLUMN_MAX_DEPTH ||
+        pCons->op != SQLITE_INDEX_CONSTRAINT_EQ)
+      continue;
+    // like the path, it's an argument that can't be checked afterwards
+    if (!pCons->usable)
+      return SQLITE_CONSTRAINT;
+    pIdxInfo->aConstraintUsage[i].argvIndex = 2;
+    pIdxInfo->aConstraintUsage[i].omit = 1;
+    pIdxInfo->idxNum |= PATH_ANCESTORS_INDEX_MAX_DEPTH;
+    pIdxInfo->estimatedRows = PATH_PARTS_ESTIMATED_ROWS / 2;
+    break;
+  }
+  pIdxInfo->estimatedCost = (double)pIdxInfo->estimatedRows;
+  return SQLITE_OK;
+}
+
+static int pathAncestorsFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                               const char *idxStr, int argc,
+                               sqlite3_value **argv) {
+  path_ancestors_cursor *pCur = (path_ancestors_cursor *)pVtabCursor;
+  int rc;
+  (void)idxStr;
+  (void)argc;
+  pCur->idxNum = idxNum;
+  pCur->iPath = 0;
+  pCur->iRowid = 1;
+  pCur->nMaxDepth = PATH_PARTS_MAX_ROWID;
+  if (idxNum & PATH_ANCESTORS_INDEX_MAX_DEPTH) {
+    // NULL or negative, no prefix is shallow enough
+    sqlite3_int64 iMax = sqlite3_value_type(argv[1]) == SQLITE_NULL
+                             ? -1
+                             : sqlite3_value_int64(argv[1]);
+    pCur->nMaxDepth = iMax < -1                    ? -1
+                      : iMax > PATH_PARTS_MAX_ROWID ? PATH_PARTS_MAX_ROWID
+                                                    : (int)iMax;
+  }
+  rc = pathBatchLoad(&pCur->batch, argv[0],
+                     (idxNum & PATH_ANCESTORS_INDEX_PATH_IN) != 0);
+  if (rc != SQLITE_OK)
+    return rc;
+  return pathAncestorsLoad(pCur);
+}
+
+static sqlite3_module pathAncestorsModule = {
+    0,                      /* iVersion */
+    0,                      /* xCreate */
+    pathPartsConnect,       /* xConnect */
+    pathAncestorsBestIndex, /* xBestIndex */
+    pathPartsDisconnect,    /* xDisconnect */
+    0,                      /* xDestroy */
+    pathAncestorsOpen,      /* xOpen - open a cursor */
+    pathAncestorsClose,     /* xClose - close a cursor */
+    pathAncestorsFilter,    /* xFilter - configure scan constraints */
+    pathAncestorsNext,      /* xNext - advance a cursor */
+    pathAncestorsEof,       /* xEof - check for end of scan */
+    pathAncestorsColumn,    /* xColumn - read data */
+    pathAncestorsRowid,     /* xRowid - read data */
+    0,                      /* xUpdate */
+    0,                      /* xBegin */
+    0,                      /* xSync */
+    0,                      /* xCommit */
+    0,                      /* xRollback */
+    0,                      /* xFindMethod */
+    0,                      /* xRename */
+    0,                      /* xSavepoint */
+    0,                      /* xRelease */
+    0,                      /* xRollbackTo */
+    0                       /* xShadowName */
+};
+
+/** select * from path_synth(n, [seed], [profile])
+ * Table function that generates n synthetic file paths, for building large
+ * test tables inside SQLite. Rows are generated one at a time as they are
+ * read, and each row only depends on its rowid, seed and profile, so the
+ * same arguments always give the same paths and `rowid between ...` ranges
+ * can be generated independently.
+ * ```sql
+ * create table path_synth(
+ *  path text,           -- generated path
+ *  n hidden,            -- number of paths, with rowids 1 through n
+ *  seed hidden,         -- PRNG seed, 0 by default
+ *  profile text hidden  -- 'monorepo' (default), 'home' or 'windows'
+ * )
+ * ```
+ */
+
+#define PATH_SYNTH_SCHEMA                                                      \
+  "CREATE TABLE x(path text, n hidden, seed hidden, profile hidden)"
+
+#define PATH_SYNTH_COLUMN_PATH 0
+#define PATH_SYNTH_COLUMN_N 1
+#define PATH_SYNTH_COLUMN_SEED 2
+#define PATH_SYNTH_COLUMN_PROFILE 3
+
+// idxNum flags of the constraints passed to xFilter, in argv order after n
+#define PATH_SYNTH_INDEX_SEED 0x01
+#define PATH_SYNTH_INDEX_PROFILE 0x02
+#define PATH_SYNTH_INDEX_ROWID_GT 0x04
+#define PATH_SYNTH_INDEX_ROWID_GE 0x08
+#define PATH_SYNTH_INDEX_ROWID_LT 0x10
+#define PATH_SYNTH_INDEX_ROWID_LE 0x20
+
+// n is only known in xFilter, so plans assume a large table
+#define PATH_SYNTH_ESTIMATED_ROWS 1000000
+
+// children a directory can have, ranked by a Zipf distribution
+#define PATH_SYNTH_MAX_FANOUT 64
+// largest number of directories above a generated file
+#define PATH_SYNTH_MAX_DEPTH 16
+
+/*
+** The shape of the paths a profile generates. Directory depth follows
+** aDepth, where aDepth[i] is the relative weight of files that are i+1
+** directories below zRoot. The k-th most popular child of a directory is
+** picked with probability proportional to 1/(k+1)^zipf, and named from
+** azDir, so a few directories hold most of the files like in real trees.
+*/
+typedef struct path_synth_profile path_synth_profile;
+struct path_synth_profile {
+  const char *zName;
+  // prefix of every generated path
+  const char *zRoot;
+  char cSeparator;
+  int nFanout;
+  double zipf;
+  int nDepth;
+  int aDepth[PATH_SYNTH_MAX_DEPTH];
+  int nDir;
+  const char *const *azDir;
+  // percent of files that are dotfiles, ex ".gitignore"
+  int pctHidden;
+};
+
+static const char *const pathSynthMonorepoDirs[] = {
+    "src",   "packages", "node_modules", "lib",      "ext",     "test",
+    "docs",  "components", "utils",      "internal", "pkg",     "cmd",
+    "api",   "core",     "dist",         "build",    "vendor",  "scripts",
+    "config", "assets",  "public",       "app",      "server",  "client",
+    "common", "models",  "services",     "types",    "hooks",   "tools",
+};
+
+static const char *const pathSynthHomeDirs[] = {
+    "Documents", "Downloads", "Pictures", "Music",    "projects", "src",
+    "photos",    "2023",      "2024",     "archive",  "backup",   "notes",
+    "work",      "personal",  "videos",   "code",     ".config",  ".cache",
+};
+
+static const char *const pathSynthWindowsDirs[] = {
+    "AppData",  "Local",         "Roaming", "Microsoft", "Documents",
+    "Desktop",  "Downloads",     "Temp",    "Projects",  "source",
+    "repos",    "Program Files", "bin",     "obj",       "Debug",
+    "Release",
+};
+
+#define PATH_SYNTH_DIRS(a) (int)(sizeof(a) / sizeof(a[0])), a
+
+static const path_synth_profile pathSynthProfiles[] = {
+    {"monorepo", "", '/', 48, 1.1, 12,
+     {2, 4, 8, 12, 14, 14, 12, 10, 8, 6, 4, 3},
+     PATH_SYNTH_DIRS(pathSynthMonorepoDirs), 3},
+    {"home", "/home/user/", '/', 24, 1.0, 8, {6, 10, 12, 10, 7, 4, 2, 1},
+     PATH_SYNTH_DIRS(pathSynthHomeDirs), 8},
+    {"windows", "C:\\Users\\user\\", '\\', 24, 1.0, 8,
+     {4, 8, 12, 12, 9, 6, 3, 2}, PATH_SYNTH_DIRS(pathSynthWindowsDirs), 1},
+};
+
+static const char *const pathSynthFiles[] = {
+    "index",  "main",    "utils",  "test",   "README", "config", "app",
+    "helpers", "types",  "server", "client", "model",  "view",   "handler",
+    "parser", "logo",    "styles", "schema", "build",  "setup",
+};
+
+static const char *const pathSynthDotfiles[] = {
+    ".gitignore", ".env",    ".eslintrc",     ".prettierrc",
+    ".babelrc",   ".npmrc",  ".editorconfig", ".DS_Store",
+};
+
+// extensions and their relative frequency, "" for files without one
+static const struct {
+  const char *zExtension;
+  int weight;
+} pathSynthExtensions[] = {
+    {".js", 20}, {".ts", 15},  {".json", 8}, {".md", 6},  {".py", 6},
+    {".c", 5},   {".h", 4},    {".go", 4},   {".png", 5}, {".rs", 3},
+    {".svg", 3}, {".css", 3},  {".txt", 3},  {".html", 2}, {".yml", 2},
+    {".tar.gz", 1}, {"", 4},
+};
+
+#define PATH_SYNTH_EXTENSIONS                                                  \
+  (int)(sizeof(pathSynthExtensions) / sizeof(pathSynthExtensions[0]))
+
+typedef struct path_synth_cursor path_synth_cursor;
+struct path_synth_cursor {
+  sqlite3_vtab_cursor base;
+  const path_synth_profile *pProfile;
+  sqlite3_uint64 seed;
+  sqlite3_int64 n;
+  sqlite3_int64 iRowid;
+  sqlite3_int64 iLast;
+  // cumulative distributions to sample from, scaled to 2^32
+  sqlite3_uint64 aFanout[PATH_SYNTH_MAX_FANOUT];
+  sqlite3_uint64 aDepth[PATH_SYNTH_MAX_DEPTH];
+  sqlite3_uint64 aExtension[PATH_SYNTH_EXTENSIONS];
+  // path of the current row, generated the first time it's read
+  int bGenerated;
+  int nPath;
+  char zPath[1024];
+};
+
+/*
+** splitmix64, both as the per-row PRNG and to hash a directory's identity
+** into the names of its children.
+*/
+static sqlite3_uint64 pathSynthMix(sqlite3_uint64 x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+static sqlite3_uint64 pathSynthRandom(sqlite3_uint64 *pState) {
+  *pState += 0x9e3779b97f4a7c15ull;
+  return pathSynthMix(*pState);
+}
+
+/*
+** Fill aCdf with the cumulative distribution of the n weights in aWeight,
+** scaled so the last entry is 2^32.
+*/
+static void pathSynthCdf(sqlite3_uint64 *aCdf, int n, const double *aWeight) {
+  double total = 0, sum = 0;
+  for (int i = 0; i < n; i++)
+    total += aWeight[i];
+  for (int i = 0; i < n; i++) {
+    sum += aWeight[i];
+    aCdf[i] = (sqlite3_uint64)(sum / total * 4294967296.0);
+  }
+  aCdf[n - 1] = (sqlite3_uint64)1 << 32;
+}
+
+/*
+** Index of the first entry of aCdf above a random 32-bit value. Distributions
+** are heavy at the front, so a linear scan stops early.
+*/
+static int pathSynthSample(sqlite3_uint64 *pState, const sqlite3_uint64 *aCdf,
+                           int n) {
+  // scaled to the first n entries, so a prefix of aCdf can be sampled from
+  sqlite3_uint64 u = ((pathSynthRandom(pState) >> 32) * aCdf[n - 1]) >> 32;
+  int i = 0;
+  while (i < n - 1 && u >= aCdf[i])
+    i++;
+  return i;
+}
+
+static void pathSynthAppend(path_synth_cursor *pCur, const char *z) {
+  int n = (int)strlen(z);
+  if (n > (int)sizeof(pCur->zPath) - pCur->nPath)
+    n = (int)sizeof(pCur->zPath) - pCur->nPath;
+  memcpy(pCur->zPath + pCur->nPath, z, n);
+  pCur->nPath += n;
+}
+
+/*
+** Generate the path of the current row. Every directory is identified by a
+** hash of its parent's identity and its rank, and its name is picked from
+** that, so files that land on the same ranks share parent directories.
+*/
+static void pathSynthGenerate(path_synth_cursor *pCur) {
+  const path_synth_profile *pProfile = pCur->pProfile;
+  sqlite3_uint64 state = pathSynthMix(pCur->seed ^ pathSynthMix(pCur->iRowid));
+  sqlite3_uint64 dir = pathSynthMix(pCur->seed);
+  int nDepth = pathSynthSample(&state, pCur->aDepth, pProfile->nDepth) + 1;
+  char zNumber[24];
+
+  pCur->nPath = 0;
+  pathSynthAppend(pCur, pProfile->zRoot);
+  for (int i = 0; i < nDepth; i++) {
+    // directories get narrower further down, so deep ones hold many files
+    int nFanout = pProfile->nFanout >> i;
+    int k = pathSynthSample(&state, pCur->aFanout, nFanout > 1 ? nFanout : 1);
+    pathSynthAppend(
+        pCur, pProfile->azDir[(dir + k) % (sqlite3_uint64)pProfile->nDir]);
+    // ranks past the size of the name pool get a number to stay distinct
+    if (k >= pProfile->nDir) {
+      sqlite3_snprintf(sizeof(zNumber), zNumber, "-%d", k / pProfile->nDir);
+      pathSynthAppend(pCur, zNumber);
+    }
+    if (pCur->nPath < (int)sizeof(pCur->zPath))
+      pCur->zPath[pCur->nPath++] = pProfile->cSeparator;
+    dir = pathSynthMix(dir ^ (sqlite3_uint64)(k + 1));
+  }
+
+  if ((int)(pathSynthRandom(&state) % 100) < pProfile->pctHidden) {
+    pathSynthAppend(pCur, pathSynthDotfiles[pathSynthRandom(&state) %
+                                            (sizeof(pathSynthDotfiles) /
+                                             sizeof(pathSynthDotfiles[0]))]);
+  } else {
+    pathSynthAppend(pCur, pathSynthFiles[pathSynthRandom(&state) %
+                                         (sizeof(pathSynthFiles) /
+                                          sizeof(pathSynthFiles[0]))]);
+    if (pathSynthRandom(&state) % 2) {
+      sqlite3_snprintf(sizeof(zNumber), zNumber, "_%d",
+                       (int)(pathSynthRandom(&state) % 1000));
+      pathSynthAppend(pCur, zNumber);
+    }
+    pathSynthAppend(pCur, pathSynthExtensions[pathSynthSample(
+                              &state, pCur->aExtension, PATH_SYNTH_EXTENSIONS)]
+                              .zExtension);
+  }
+  pCur->bGenerated = 1;
+}
+
+/*
+** Build the distributions a profile samples from.
+*/
+static void pathSynthSetup(path_synth_cursor *pCur,
+                           const path_synth_profile *pProfile) {
+  double aWeight[PATH_SYNTH_MAX_FANOUT];
+  if (pCur->pProfile == pProfile)
+    return;
+  pCur->pProfile = pProfile;
+  for (int i = 0; i < pProfile->nFanout; i++)
+    aWeight[i] = 1.0 / pow(i + 1, pProfile->zipf);
+  pathSynthCdf(pCur->aFanout, pProfile->nFanout, aWeight);
+  for (int i = 0; i < pProfile->nDepth; i++)
+    aWeight[i] = pProfile->aDepth[i];
+  pathSynthCdf(pCur->aDepth, pProfile->nDepth, aWeight);
+  for (int i = 0; i < PATH_SYNTH_EXTENSIONS; i++)
+    aWeight[i] = pathSynthExtensions[i].weight;
+  pathSynthCdf(pCur->aExtension, PATH_SYNTH_EXTENSIONS, aWeight);
+}
+
+static int pathSynthOpen(sqlite3_vtab *pUnused,
+                         sqlite3_vtab_cursor **ppCursor) {
+  path_synth_cursor *pCur;
+  (void)pUnused;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0)
+    return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int pathSynthClose(sqlite3_vtab_cursor *cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int pathSynthNext(sqlite3_vtab_cursor *cur) {
+  path_synth_cursor *pCur = (path_synth_cursor *)cur;
+  pCur->iRowid++;
+  pCur->bGenerated = 0;
+  return SQLITE_OK;
+}
+
+static int pathSynthEof(sqlite3_vtab_cursor *cur) {
+  path_synth_cursor *pCur = (path_synth_cursor *)cur;
+  return pCur->iRowid > pCur->iLast;
+}
+
+static int pathSynthColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx,
+                           int i) {
+  path_synth_cursor *pCur = (path_synth_cursor *)cur;
+  switch (i) {
+  case PATH_SYNTH_COLUMN_PATH:
+    if (!pCur->bGenerated)
+      pathSynthGenerate(pCur);
+    sqlite3_result_text(ctx, pCur->zPath, pCur->nPath, SQLITE_TRANSIENT);
+    break;
+  case PATH_SYNTH_COLUMN_N:
+    sqlite3_result_int64(ctx, pCur->n);
+    break;
+  case PATH_SYNTH_COLUMN_SEED:
+    sqlite3_result_int64(ctx, (sqlite3_int64)pCur->seed);
+    break;
+  case PATH_SYNTH_COLUMN_PROFILE:
+    sqlite3_result_text(ctx, pCur->pProfile->zName, -1, SQLITE_STATIC);
+    break;
+  }
+  return SQLITE_OK;
+}
+
+static int pathSynthRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+  *pRowid = ((path_synth_cursor *)cur)->iRowid;
+  return SQLITE_OK;
+}
+
+/*
+** n is required, seed and profile are optional. Bounds on rowid are passed
+** down as well, so a range of rows is generated without the ones before it.
+*/
+static int pathSynthBestIndex(sqlite3_vtab *pVTab,
+                              sqlite3_index_info *pIdxInfo) {
+  // constraint of each xFilter argument: n, seed, profile, lower, upper
+  int aArg[5] = {-1, -1, -1, -1, -1};
+  int hasUnusableN = 0;
+  int nArg = 0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+    int iArg = -1;
+    if (pCons->iColumn >= PATH_SYNTH_COLUMN_N &&
+        pCons->op == SQLITE_INDEX_CONSTRAINT_EQ)
+      iArg = pCons->iColumn - PATH_SYNTH_COLUMN_N;
+    else if (pCons->iColumn == -1 && (pCons->op == SQLITE_INDEX_CONSTRAINT_GT ||
+                                      pCons->op == SQLITE_INDEX_CONSTRAINT_GE))
+      iArg = 3;
+    else if (pCons->iColumn == -1 && (pCons->op == SQLITE_INDEX_CONSTRAINT_LT ||
+                                      pCons->op == SQLITE_INDEX_CONSTRAINT_LE))
+      iArg = 4;
+    if (iArg < 0)
+      continue;
+    if (!pCons->usable) {
+      hasUnusableN |= iArg == 0;
+      continue;
+    }
+    if (aArg[iArg] < 0)
+      aArg[iArg] = i;
+  }
+  if (aArg[0] < 0) {
+    if (hasUnusableN)
+      return SQLITE_CONSTRAINT;
+    pVTab->zErrMsg = sqlite3_mprintf("n argument is required");
+    return SQLITE_ERROR;
+  }
+
+  pIdxInfo->idxNum = 0;
+  for (int j = 0; j < 5; j++) {
+    if (aArg[j] < 0)
+      continue;
+    pIdxInfo->aConstraintUsage[aArg[j]].argvIndex = ++nArg;
+    // rowid bounds only narrow the scan when they're integers, so SQLite
+    // still checks them
+    pIdxInfo->aConstraintUsage[aArg[j]].omit = j < 3;
+    switch (j) {
+    case 1:
+      pIdxInfo->idxNum |= PATH_SYNTH_INDEX_SEED;
+      break;
+    case 2:
+      pIdxInfo->idxNum |= PATH_SYNTH_INDEX_PROFILE;
+      break;
+    case 3:
+      pIdxInfo->idxNum |= pIdxInfo->aConstraint[aArg[j]].op ==
+                                  SQLITE_INDEX_CONSTRAINT_GT
+                              ? PATH_SYNTH_INDEX_ROWID_GT
+                              : PATH_SYNTH_INDEX_ROWID_GE;
+      break;
+    case 4:
+      pIdxInfo->idxNum |= pIdxInfo->aConstraint[aArg[j]].op ==
+                                  SQLITE_INDEX_CONSTRAINT_LT
+                              ? PATH_SYNTH_INDEX_ROWID_LT
+                              : PATH_SYNTH_INDEX_ROWID_LE;
+      break;
+    }
+  }
+  pIdxInfo->estimatedRows = PATH_SYNTH_ESTIMATED_ROWS;
+  if (aArg[3] >= 0 || aArg[4] >= 0)
+    pIdxInfo->estimatedRows /= 4;
+  pIdxInfo->estimatedCost = (double)pIdxInfo->estimatedRows;
+  return SQLITE_OK;
+}
+
+static int pathSynthFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                           const char *idxStr, int argc,
+                           sqlite3_value **argv) {
+  path_synth_cursor *pCur = (path_synth_cursor *)pVtabCursor;
+  sqlite3_vtab *pVtab = pVtabCursor->pVtab;
+  const path_synth_profile *pProfile = &pathSynthProfiles[0];
+  int iArg = 1;
+  (void)idxStr;
+  (void)argc;
+
+  pCur->n = sqlite3_value_int64(argv[0]);
+  pCur->iLast = pCur->n;
+  pCur->seed = 0;
+  if (idxNum & PATH_SYNTH_INDEX_SEED)
+    pCur->seed = (sqlite3_uint64)sqlite3_value_int64(argv[iArg++]);
+  if (idxNum & PATH_SYNTH_INDEX_PROFILE) {
+    const char *zProfile = (const char *)sqlite3_value_text(argv[iArg++]);
+    pProfile = 0;
+    for (size_t i = 0; zProfile && i < sizeof(pathSynthProfiles) /
+                                          sizeof(pathSynthProfiles[0]);
+         i++) {
+      if (sqlite3_stricmp(zProfile, pathSynthProfiles[i].zName) == 0)
+        pProfile = &pathSynthProfiles[i];
+    }
+    if (pProfile == 0) {
+      sqlite3_free(pVtab->zErrMsg);
+      pVtab->zErrMsg = sqlite3_mprintf(
+          "unknown path_synth profile '%s', expected 'monorepo', 'home' or "
+          "'windows'",
+          zProfile ? zProfile : "");
+      return SQLITE_ERROR;
+    }
+  }
+  pCur->iRowid = 1;
+  // reals, text and NULL bounds are left to SQLite, which checks every row
+  if (idxNum & (PATH_SYNTH_INDEX_ROWID_GT | PATH_SYNTH_INDEX_ROWID_GE) &&
+      sqlite3_value_type(argv[iArg++]) == SQLITE_INTEGER) {
+    sqlite3_int64 iLower = sqlite3_value_int64(argv[iArg - 1]);
+    if (idxNum & PATH_SYNTH_INDEX_ROWID_GT)
+      iLower = iLower < pCur->iLast ? iLower + 1 : pCur->iLast + 1;
+    if (iLower > pCur->iRowid)
+      pCur->iRowid = iLower;
+  }
+  if (idxNum & (PATH_SYNTH_INDEX_ROWID_LT | PATH_SYNTH_INDEX_ROWID_LE) &&
+      sqlite3_value_type(argv[iArg++]) == SQLITE_INTEGER) {
+    sqlite3_int64 iUpper = sqlite3_value_int64(argv[iArg - 1]);
+    if (idxNum & PATH_SYNTH_INDEX_ROWID_LT)
+      iUpper = iUpper > 1 ? iUpper - 1 : 0;
+    if (iUpper < pCur->iLast)
+      pCur->iLast = iUpper;
+  }
+  pCur->bGenerated = 0;
+  pathSynthSetup(pCur, pProfile);
+  return SQLITE_OK;
+}
+
+static sqlite3_module pathSynthModule = {
+    0,                   /* iVersion */
+    0,                   /* xCreate */
+    pathPartsConnect,    /* xConnect */
+    pathSynthBestIndex,  /* xBestIndex */
+    pathPartsDisconnect, /* xDisconnect */
+    0,                   /* xDestroy */
+    pathSynthOpen,       /* xOpen - open a cursor */
+    pathSynthClose,      /* xClose - close a cursor */
+    pathSynthFilter,     /* xFilter - configure scan constraints */
+    pathSynthNext,       /* xNext - advance a cursor */
+    pathSynthEof,        /* xEof - check for end of scan */
+    pathSynthColumn,     /* xColumn - read data */
+    pathSynthRowid,      /* xRowid - read data */
+    0,                   /* xUpdate */
+    0,                   /* xBegin */
+    0,                   /* xSync */
+    0,                   /* xCommit */
+    0,                   /* xRollback */
+    0,                   /* xFindMethod */
+    0,                   /* xRename */
+    0,                   /* xSavepoint */
+    0,                   /* xRelease */
+    0,                   /* xRollbackTo */
+    0                    /* xShadowName */
+};
+
+#pragma endregion
+
+#pragma region sqlite - path trie
+
+/** create virtual table idx using path_trie(source_table, column)
+ * A persistent index of the paths in a column of another table, as a trie
+ * of their segments. Every directory and file is a node that knows how many
+ * indexed rows are at or under it, so child listings, subtree scans and
+ * subtree counts only read the nodes they return, never the whole table.
+ *
+ * Nodes live in the shadow table idx_node, and idx_entry maps the rowid of
+ * every indexed row to its node. Triggers on the source table keep both in
+ * sync by writing to idx: `insert into idx(rowid, path)` indexes a row, and
+ * `insert into idx(idx, rowid) values ('delete', rowid)` forgets one, like
+ * FTS5's command column. 'rebuild' re-indexes the whole source table.
+ * Paths are tokenized the same way path_parts does, and normalized.
+ * ```sql
+ * create table idx(
+ *  path text,            -- path of the node
+ *  name text,            -- last segment of path, or its root
+ *  depth int,            -- number of segments in path
+ *  count int,            -- indexed rows at path or under it
+ *  entries int,          -- indexed rows at exactly path
+ *  children hidden,      -- only the nodes right under this directory
+ *  descendants hidden,   -- only the nodes under this directory
+ *  prefix_of hidden,     -- only the nodes on the way to this path
+ *  idx hidden            -- command column, 'delete' or 'rebuild'
+ * )
+ * ```
+ */
+
+#define PATH_TRIE_SCHEMA                                                       \
+  "CREATE TABLE x(path text, name text, depth int, count int, entries int, "   \
+  "children hidden, descendants hidden, prefix_of hidden, \"%w\" hidden)"
+
+#define PATH_TRIE_COLUMN_PATH 0
+#define PATH_TRIE_COLUMN_NAME 1
+#define PATH_TRIE_COLUMN_DEPTH 2
+#define PATH_TRIE_COLUMN_COUNT 3
+#define PATH_TRIE_COLUMN_ENTRIES 4
+#define PATH_TRIE_COLUMN_CHILDREN 5
+#define PATH_TRIE_COLUMN_DESCENDANTS 6
+#define PATH_TRIE_COLUMN_PREFIX_OF 7
+#define PATH_TRIE_COLUMN_COMMAND 8
+
+/** create virtual table tree using path_closure(source_table, column)
+ * The closure of a path_trie: a row for every node and each of its
+ * ancestors, itself included at depth 0. "Everything under X" and
+ * "everything above Y" are then one index range each, instead of expanding
+ * every row with path_parts. Nodes and their rows are kept in sync with the
+ * source table exactly like path_trie, with the same triggers and commands:
+ * `insert into tree(rowid, descendant)` indexes a row, and
+ * `insert into tree(tree, rowid) values ('delete', rowid)` forgets one.
+ *
+ * The pairs live in tree_closure, keyed by (ancestor, depth, descendant)
+ * and indexed by (descendant, depth, ancestor). Constraints on ancestor,
+ * descendant, their ids and depth are pushed down to them. Like path_trie,
+ * ancestor and descendant match the normalized path, so '/srv/' finds the
+ * node '/srv'.
+ * ```sql
+ * create table tree(
+ *  ancestor text,        -- path of the ancestor
+ *  descendant text,      -- path of the descendant
+ *  depth int,            -- segments from ancestor down to descendant
+ *  ancestor_id int,      -- rowid of the ancestor in tree_node
+ *  descendant_id int,    -- rowid of the descendant in tree_node
+ *  tree hidden           -- command column, 'delete' or 'rebuild'
+ * )
+ * ```
+ */
+
+#define PATH_CLOSURE_SCHEMA                                                    \
+  "CREATE TABLE x(ancestor text, descendant text, depth int, "                 \
+  "ancestor_id int, descendant_id int, \"%w\" hidden)"
+
+#define PATH_CLOSURE_COLUMN_ANCESTOR 0
+#define PATH_CLOSURE_COLUMN_DESCENDANT 1
+#define PATH_CLOSURE_COLUMN_DEPTH 2
+#define PATH_CLOSURE_COLUMN_ANCESTOR_ID 3
+#define PATH_CLOSURE_COLUMN_DESCENDANT_ID 4
+#define PATH_CLOSURE_COLUMN_COMMAND 5
+
+// idxNum of each kind of scan, the argument of xFilter is its path
+#define PATH_TRIE_INDEX_ALL 0
+#define PATH_TRIE_INDEX_PATH 1
+#define PATH_TRIE_INDEX_PREFIX_OF 2
+#define PATH_TRIE_INDEX_CHILDREN 3
+#define PATH_TRIE_INDEX_DESCENDANTS 4
+
+// statements on the shadow tables, prepared the first time they're needed
+#define PATH_TRIE_STMT_FIND 0
+#define PATH_TRIE_STMT_FIRST 1
+#define PATH_TRIE_STMT_NEXT 2
+#define PATH_TRIE_STMT_NODE 3
+#define PATH_TRIE_STMT_INSERT 4
+#define PATH_TRIE_STMT_ADD 5
+#define PATH_TRIE_STMT_DELETE 6
+#define PATH_TRIE_STMT_ENTRY 7
+#define PATH_TRIE_STMT_ENTRY_INSERT 8
+#define PATH_TRIE_STMT_ENTRY_DELETE 9
+// path_closure only
+#define PATH_TRIE_STMT_INSERT_PATH 10
+#define PATH_TRIE_STMT_CLOSURE_INSERT 11
+#define PATH_TRIE_STMT_CLOSURE_DELETE 12
+#define PATH_TRIE_STMT_COUNT 13
+
+static const char *const pathTrieSql[PATH_TRIE_STMT_COUNT] = {
+    "SELECT id, count, entries FROM \"%w\".\"%w_node\" "
+    "WHERE parent = ?1 AND name = ?2",
+    "SELECT id, name, count, entries FROM \"%w\".\"%w_node\" "
+    "WHERE parent = ?1 ORDER BY name LIMIT 1",
+    "SELECT id, name, count, entries FROM \"%w\".\"%w_node\" "
+    "WHERE parent = ?1 AND name > ?2 ORDER BY name LIMIT 1",
+    "SELECT parent, count FROM \"%w\".\"%w_node\" WHERE id = ?1",
+    "INSERT INTO \"%w\".\"%w_node\"(parent, name, count, entries) "
+    "VALUES (?1, ?2, 1, ?3)",
+    "UPDATE \"%w\".\"%w_node\" SET count = count + ?2, entries = entries + ?3 "
+    "WHERE id = ?1",
+    "DELETE FROM \"%w\".\"%w_node\" WHERE id = ?1",
+    "SELECT node FROM \"%w\".\"%w_entry\" WHERE id = ?1",
+    "INSERT INTO \"%w\".\"%w_entry\"(id, node) VALUES (?1, ?2)",
+    "DELETE FROM \"%w\".\"%w_entry\" WHERE id = ?1",
+    "INSERT INTO \"%w\".\"%w_node\"(parent, name, count, entries, path) "
+    "VALUES (?1, ?2, 1, ?3, ?4)",
+    // a new node is under every ancestor of its parent, and its parent
+    "INSERT INTO \"%w\".\"%w_closure\"(ancestor, depth, descendant) "
+    "SELECT ancestor, depth + 1, ?2 FROM \"%w\".\"%w_closure\" "
+    "WHERE descendant = ?1 UNION ALL SELECT ?2, 0, ?2",
+    "DELETE FROM \"%w\".\"%w_closure\" WHERE descendant = ?1",
+};
+
+typedef struct path_trie_vtab path_trie_vtab;
+struct path_trie_vtab {
+  // first, so pathVtabStyle() works on path_trie tables too
+  path_vtab base;
+  sqlite3 *db;
+  // path_closure tables share the trie, and keep its closure as well
+  int bClosure;
+  // schema and name of this table, and the table and column it indexes
+  char *zDb;
+  char *zName;
+  char *zSource;
+  char *zColumn;
+  sqlite3_stmt *aStmt[PATH_TRIE_STMT_COUNT];
+};
+
+typedef struct path_trie_cursor path_trie_cursor;
+struct path_trie_cursor {
+  sqlite3_vtab_cursor base;
+  int idxNum;
+  int bEof;
+  // nodes from a root down to the current row. The path of node i is the
+  // first aEnd[i] bytes of path, and its name starts at aBegin[i].
+  sqlite3_int64 *aNode;
+  int *aBegin;
+  int *aEnd;
+  int nNode;
+  int nAlloc;
+  // rows are nodes below the first nBase nodes: the directory of the scan
+  int nBase;
+  path_buffer path;
+  // count and entries of the current row
+  sqlite3_int64 nCount;
+  sqlite3_int64 nEntries;
+  // the argument of a prefix_of scan, and its segments
+  path_buffer target;
+  path_parsed parsed;
+};
+
+/*
+** Strip the quotes from a module argument, like 'files' or "my table".
+*/
+static char *pathTrieDequote(const char *zArg) {
+  int n = (int)strlen(zArg);
+  char cQuote = zArg[0];
+  char *z;
+  if (n < 2 || !(cQuote == '"' || cQuote == '\'' || cQuote == '`' ||
+                 cQuote == '['))
+    return sqlite3_mprintf("%s", zArg);
+  if (cQuote == '[')
+    cQuote = ']';
+  z = sqlite3_malloc(n);
+  if (z) {
+    int j = 0;
+    for (int i = 1; i < n - 1; i++) {
+      z[j++] = zArg[i];
+      // doubled quotes are one quote
+      if (zArg[i] == cQuote && zArg[i + 1] == cQuote)
+        i++;
+    }
+    z[j] = 0;
+  }
+  return z;
+}
+
+static int pathTriePrepare(path_trie_vtab *p, int iStmt,
+                           sqlite3_stmt **ppStmt) {
+  if (p->aStmt[iStmt] == NULL) {
+    char *zSql = sqlite3_mprintf(pathTrieSql[iStmt], p->zDb, p->zName, p->zDb,
+                                 p->zName);
+    int rc;
+    if (zSql == NULL)
+      return SQLITE_NOMEM;
+    rc = sqlite3_prepare_v3(p->db, zSql, -1, SQLITE_PREPARE_PERSISTENT,
+                            &p->aStmt[iStmt], 0);
+    sqlite3_free(zSql);
+    if (rc != SQLITE_OK)
+      return rc;
+  }
+  *ppStmt = p->aStmt[iStmt];
+  return SQLITE_OK;
+}
+
+/*
+** Prepare every statement that changes the trie. Commands do this before
+** their first change: the INSERT that runs a command can't open a SAVEPOINT
+** to undo a failed one, so nothing that can fail on its own, like a schema
+** error, may come up halfway through. I/O errors and OOMs halfway roll the
+** whole transaction back.
+*/
+static int pathTriePrepareAll(path_trie_vtab *p) {
+  int nStmt = p->bClosure ? PATH_TRIE_STMT_COUNT : PATH_TRIE_STMT_INSERT_PATH;
+  sqlite3_stmt *pStmt;
+  int rc = SQLITE_OK;
+  for (int i = 0; rc == SQLITE_OK && i < nStmt; i++)
+    rc = pathTriePrepare(p, i, &pStmt);
+  return rc;
+}
+
+/*
+** Run a statement that returns no rows, and reset it.
+*/
+static int pathTrieExec(sqlite3_stmt *pStmt) {
+  sqlite3_step(pStmt);
+  return sqlite3_reset(pStmt);
+}
+
+static void pathTrieBindName(sqlite3_stmt *pStmt, int i, const char *z,
+                             int n) {
+  // a NULL pointer would bind NULL, but the relative root is an empty name
+  sqlite3_bind_blob(pStmt, i, z ? z : "", n, SQLITE_STATIC);
+}
+
+/*
+** Set *piNode to the child of iParent with the given name, or 0 if there
+** isn't one. Roots are the children of node 0.
+*/
+static int pathTrieFindChild(path_trie_vtab *p, sqlite3_int64 iParent,
+                             const char *zName, int nName,
+                             sqlite3_int64 *piNode) {
+  sqlite3_stmt *pStmt;
+  int rc = pathTriePrepare(p, PATH_TRIE_STMT_FIND, &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1, iParent);
+  pathTrieBindName(pStmt, 2, zName, nName);
+  *piNode = 0;
+  if (sqlite3_step(pStmt) == SQLITE_ROW)
+    *piNode = sqlite3_column_int64(pStmt, 0);
+  return sqlite3_reset(pStmt);
+}
+
+/*
+** Create a child of iParent with the given name, that counts one row. For
+** path_closure, the nPath bytes of zPath are its path, and it's added to the
+** closure of its ancestors.
+*/
+static int pathTrieInsertChild(path_trie_vtab *p, sqlite3_int64 iParent,
+                               const char *zName, int nName, int bLeaf,
+                               const char *zPath, int nPath,
+                               sqlite3_int64 *piNode) {
+  sqlite3_stmt *pStmt;
+  int rc = pathTriePrepare(
+      p, p->bClosure ? PATH_TRIE_STMT_INSERT_PATH : PATH_TRIE_STMT_INSERT,
+      &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1, iParent);
+  pathTrieBindName(pStmt, 2, zName, nName);
+  sqlite3_bind_int(pStmt, 3, bLeaf);
+  if (p->bClosure)
+    sqlite3_bind_text(pStmt, 4, zPath ? zPath : "", nPath, SQLITE_STATIC);
+  rc = pathTrieExec(pStmt);
+  *piNode = sqlite3_last_insert_rowid(p->db);
+  if (rc != SQLITE_OK || !p->bClosure)
+    return rc;
+
+  rc = pathTriePrepare(p, PATH_TRIE_STMT_CLOSURE_INSERT, &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1, iParent);
+  sqlite3_bind_int64(pStmt, 2, *piNode);
+  return pathTrieExec(pStmt);
+}
+
+static int pathTrieAddCounts(path_trie_vtab *p, sqlite3_int64 iNode,
+                             int nCount, int nEntries) {
+  sqlite3_stmt *pStmt;
+  int rc = pathTriePrepare(p, PATH_TRIE_STMT_ADD, &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1, iNode);
+  sqlite3_bind_int(pStmt, 2, nCount);
+  sqlite3_bind_int(pStmt, 3, nEntries);
+  return pathTrieExec(pStmt);
+}
+
+/*
+** Index the row iRowid of the source table, with the nPath bytes of zPath.
+** Every node from its root down to it counts one more row.
+*/
+static int pathTrieInsert(path_trie_vtab *p, sqlite3_int64 iRowid,
+                          const char *zPath, int nPath) {
+  path_parsed parsed;
+  // normalized path of the current node, only kept for path_closure
+  path_buffer path = {0, 0};
+  int nNodePath = 0;
+  sqlite3_int64 iNode = 0;
+  sqlite3_stmt *pStmt;
+  int bNew = 0;
+  int rc;
+
+  pathParsedInit(&parsed);
+  rc = pathTokenize(p->base.pStyle, zPath, nPath, &parsed);
+  if (rc != SQLITE_OK)
+    goto done;
+  pathResolveSegments(&parsed);
+  for (int i = -1; i < parsed.nSegment && rc == SQLITE_OK; i++) {
+    const char *zName = i < 0 ? zPath : zPath + parsed.aBegin[i];
+    int nName = i < 0 ? parsed.nRoot : parsed.aSize[i];
+    int bLeaf = i == parsed.nSegment - 1;
+    sqlite3_int64 iChild = 0;
+    // once a node is new, so is everything under it
+    if (!bNew)
+      rc = pathTrieFindChild(p, iNode, zName, nName, &iChild);
+    if (rc != SQLITE_OK)
+      break;
+    bNew = iChild == 0;
+    if (p->bClosure) {
+      // the same spelling pathTriePush gives the node
+      rc = pathBufferReserve(&path, (sqlite3_int64)nNodePath + nName + 2);
+      if (rc != SQLITE_OK)
+        break;
+      if (nNodePath > 0 &&
+          !pathIsSeparator(p->base.pStyle->eStyle, path.z[nNodePath - 1]))
+        path.z[nNodePath++] = p->base.pStyle->cSeparator;
+      if (nName > 0)
+        memcpy(path.z + nNodePath, zName, nName);
+      nNodePath += nName;
+    }
+    if (bNew) {
+      rc = pathTrieInsertChild(p, iNode, zName, nName, bLeaf, path.z,
+                               nNodePath, &iNode);
+    } else {
+      iNode = iChild;
+      rc = pathTrieAddCounts(p, iNode, 1, bLeaf);
+    }
+  }
+  if (rc == SQLITE_OK)
+    rc = pathTriePrepare(p, PATH_TRIE_STMT_ENTRY_INSERT, &pStmt);
+  if (rc == SQLITE_OK) {
+    sqlite3_bind_int64(pStmt, 1, iRowid);
+    sqlite3_bind_int64(pStmt, 2, iNode);
+    rc = pathTrieExec(pStmt);
+  }
+
+done:
+  pathParsedFree(&parsed);
+  pathBufferFree(&path);
+  return rc;
+}
+
+/*
+** Forget the row iRowid of the source table, if it's indexed. Nodes that
+** no longer have any rows at or under them are deleted.
+*/
+static int pathTrieDelete(path_trie_vtab *p, sqlite3_int64 iRowid) {
+  sqlite3_stmt *pStmt;
+  sqlite3_int64 iNode = 0;
+  int bLeaf = 1;
+  int rc = pathTriePrepareAll(p);
+  if (rc == SQLITE_OK)
+    rc = pathTriePrepare(p, PATH_TRIE_STMT_ENTRY, &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1, iRowid);
+  if (sqlite3_step(pStmt) == SQLITE_ROW)
+    iNode = sqlite3_column_int64(pStmt, 0);
+  rc = sqlite3_reset(pStmt);
+  if (rc != SQLITE_OK || iNode == 0)
+    return rc;
+
+  rc = pathTriePrepare(p, PATH_TRIE_STMT_ENTRY_DELETE, &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1, iRowid);
+  rc = pathTrieExec(pStmt);
+
+  while (rc == SQLITE_OK && iNode != 0) {
+    sqlite3_int64 iParent = 0, nCount = 0;
+    rc = pathTriePrepare(p, PATH_TRIE_STMT_NODE, &pStmt);
+    if (rc != SQLITE_OK)
+      break;
+    sqlite3_bind_int64(pStmt, 1, iNode);
+    if (sqlite3_step(pStmt) == SQLITE_ROW) {
+      iParent = sqlite3_column_int64(pStmt, 0);
+      nCount = sqlite3_column_int64(pStmt, 1);
+    }
+    rc = sqlite3_reset(pStmt);
+    if (rc != SQLITE_OK)
+      break;
+    if (nCount > 1) {
+      rc = pathTrieAddCounts(p, iNode, -1, -bLeaf);
+    } else {
+      rc = pathTriePrepare(p, PATH_TRIE_STMT_DELETE, &pStmt);
+      if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(pStmt, 1, iNode);
+        rc = pathTrieExec(pStmt);
+      }
+      // its descendants are already gone, only its ancestors are left
+      if (rc == SQLITE_OK && p->bClosure)
+        rc = pathTriePrepare(p, PATH_TRIE_STMT_CLOSURE_DELETE, &pStmt);
+      if (rc == SQLITE_OK && p->bClosure) {
+        sqlite3_bind_int64(pStmt, 1, iNode);
+        rc = pathTrieExec(pStmt);
+      }
+    }
+    bLeaf = 0;
+    iNode = iParent;
+  }
+  return rc;
+}
+
+/*
+** Read the name of the source table from the insert trigger on it, if there
+** is one yet. ALTER TABLE RENAME updates the trigger when the source table is
+** renamed, but not the arguments of the virtual table.
+*/
+static int pathTrieSource(path_trie_vtab *p) {
+  sqlite3_stmt *pStmt;
+  char *zSql = sqlite3_mprintf("SELECT tbl_name FROM \"%w\".sqlite_master "
+                               "WHERE type = 'trigger' AND name = '%q_insert'",
+                               p->zDb, p->zName);
+  int rc;
+  if (zSql == NULL)
+    return SQLITE_NOMEM;
+  rc = sqlite3_prepare_v2(p->db, zSql, -1, &pStmt, 0);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK)
+    return rc;
+  if (sqlite3_step(pStmt) == SQLITE_ROW) {
+    char *zSource =
+        sqlite3_mprintf("%s", (const char *)sqlite3_column_text(pStmt, 0));
+    if (zSource == NULL) {
+      sqlite3_finalize(pStmt);
+      return SQLITE_NOMEM;
+    }
+    sqlite3_free(p->zSource);
+    p->zSource = zSource;
+  }
+  return sqlite3_finalize(pStmt);
+}
+
+/*
+** Empty the trie and index every row of the source table again.
+*/
+static int pathTrieRebuild(path_trie_vtab *p) {
+  sqlite3_stmt *pStmt;
+  char *zSql;
+  int rc = pathTrieSource(p);
+  if (rc == SQLITE_OK)
+    rc = pathTriePrepareAll(p);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  // prepare the scan of the source table before emptying the trie, so a
+  // source table or column that's gone fails the rebuild without changes
+  // the column is qualified, since a missing "column" is a string otherwise
+  zSql = sqlite3_mprintf("SELECT s.rowid, s.\"%w\" FROM \"%w\".\"%w\" AS s",
+                         p->zColumn, p->zDb, p->zSource);
+  if (zSql == NULL)
+    return SQLITE_NOMEM;
+  rc = sqlite3_prepare_v2(p->db, zSql, -1, &pStmt, 0);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  zSql = sqlite3_mprintf(
+      "DELETE FROM \"%w\".\"%w_node\"; DELETE FROM \"%w\".\"%w_entry\";%z",
+      p->zDb, p->zName, p->zDb, p->zName,
+      p->bClosure ? sqlite3_mprintf("DELETE FROM \"%w\".\"%w_closure\";",
+                                    p->zDb, p->zName)
+                  : NULL);
+  if (zSql == NULL)
+    rc = SQLITE_NOMEM;
+  else
+    rc = sqlite3_exec(p->db, zSql, 0, 0, 0);
+  sqlite3_free(zSql);
+  while (rc == SQLITE_OK && sqlite3_step(pStmt) == SQLITE_ROW) {
+    sqlite3_value *value = sqlite3_column_value(pStmt, 1);
+    const char *zPath;
+    int nPath;
+    if (sqlite3_value_type(value) == SQLITE_NULL)
+      continue;
+    zPath = pathValue(value, &nPath);
+    if (zPath == NULL)
+      rc = SQLITE_NOMEM;
+    else
+      rc = pathTrieInsert(p, sqlite3_column_int64(pStmt, 0), zPath, nPath);
+  }
+  if (rc == SQLITE_OK)
+    return sqlite3_finalize(pStmt);
+  sqlite3_finalize(pStmt);
+  return rc;
+}
+
+static int pathTrieDisconnect(sqlite3_vtab *pVtab) {
+  path_trie_vtab *p = (path_trie_vtab *)pVtab;
+  for (int i = 0; i < PATH_TRIE_STMT_COUNT; i++)
+    sqlite3_finalize(p->aStmt[i]);
+  sqlite3_free(p->zDb);
+  sqlite3_free(p->zName);
+  sqlite3_free(p->zSource);
+  sqlite3_free(p->zColumn);
+  sqlite3_free(p);
+  return SQLITE_OK;
+}
+
+static int pathTrieConnect(sqlite3 *db, void *pAux, int argc,
+                           const char *const *argv, sqlite3_vtab **ppVtab,
+                           char **pzErr) {
+  const path_module *pModule = (const path_module *)pAux;
+  path_trie_vtab *pNew;
+  char *zSchema;
+  int rc;
+
+  if (argc != 5) {
+    *pzErr = sqlite3_mprintf("path_%s takes a source table and a column, "
+                             "like path_%s(files, path)",
+                             pModule->zName, pModule->zName);
+    return SQLITE_ERROR;
+  }
+  pNew = sqlite3_malloc(sizeof(*pNew));
+  if (pNew == 0)
+    return SQLITE_NOMEM;
+  memset(pNew, 0, sizeof(*pNew));
+  pNew->base.pStyle = pModule->pStyle;
+  pNew->db = db;
+  pNew->bClosure = strcmp(pModule->zName, "closure") == 0;
+  pNew->zDb = sqlite3_mprintf("%s", argv[1]);
+  pNew->zName = sqlite3_mprintf("%s", argv[2]);
+  pNew->zSource = pathTrieDequote(argv[3]);
+  pNew->zColumn = pathTrieDequote(argv[4]);
+  zSchema = sqlite3_mprintf(pModule->zSchema, argv[2]);
+  if (!pNew->zDb || !pNew->zName || !pNew->zSource || !pNew->zColumn ||
+      !zSchema) {
+    sqlite3_free(zSchema);
+    pathTrieDisconnect(&pNew->base.base);
+    return SQLITE_NOMEM;
+  }
+  rc = sqlite3_declare_vtab(db, zSchema);
+  sqlite3_free(zSchema);
+  if (rc != SQLITE_OK) {
+    pathTrieDisconnect(&pNew->base.base);
+    return rc;
+  }
+  *ppVtab = &pNew->base.base;
+  return SQLITE_OK;
+}
+
+/*
+** SQL that creates the triggers on the source table, which keep the table in
+** sync with it.
+*/
+static char *pathTrieTriggerSql(path_trie_vtab *p) {
+  const char *zPathColumn = p->bClosure ? "descendant" : "path";
+  return sqlite3_mprintf(
+      "CREATE TRIGGER \"%w\".\"%w_insert\" AFTER INSERT ON \"%w\" BEGIN "
+      "INSERT INTO \"%w\"(rowid, %s) VALUES (new.rowid, new.\"%w\"); END;"
+      "CREATE TRIGGER \"%w\".\"%w_delete\" AFTER DELETE ON \"%w\" BEGIN "
+      "INSERT INTO \"%w\"(\"%w\", rowid) VALUES ('delete', old.rowid); END;"
+      "CREATE TRIGGER \"%w\".\"%w_update\" AFTER UPDATE ON \"%w\" "
+      "WHEN old.rowid IS NOT new.rowid OR old.\"%w\" IS NOT new.\"%w\" BEGIN "
+      "INSERT INTO \"%w\"(\"%w\", rowid) VALUES ('delete', old.rowid); "
+      "INSERT INTO \"%w\"(rowid, %s) VALUES (new.rowid, new.\"%w\"); END;",
+      // insert trigger
+      p->zDb, p->zName, p->zSource, p->zName, zPathColumn, p->zColumn,
+      // delete trigger
+      p->zDb, p->zName, p->zSource, p->zName, p->zName,
+      // update trigger
+      p->zDb, p->zName, p->zSource, p->zColumn, p->zColumn, p->zName,
+      p->zName, p->zName, zPathColumn, p->zColumn);
+}
+
+/*
+** Create the shadow tables and the triggers on the source table, then index
+** what's already in it.
+*/
+static int pathTrieCreate(sqlite3 *db, void *pAux, int argc,
+                          const char *const *argv, sqlite3_vtab **ppVtab,
+                          char **pzErr) {
+  path_trie_vtab *p;
+  char *zTriggers;
+  char *zSql = NULL;
+  int rc = pathTrieConnect(db, pAux, argc, argv, ppVtab, pzErr);
+  if (rc != SQLITE_OK)
+    return rc;
+  p = (path_trie_vtab *)*ppVtab;
+  zTriggers = pathTrieTriggerSql(p);
+  // path_closure nodes keep their path, and the closure of the trie. Its
+  // index by descendant is a constraint, not a named index, so that it's
+  // renamed along with the table.
+  if (zTriggers)
+    zSql = sqlite3_mprintf(
+        "CREATE TABLE \"%w\".\"%w_node\"(id INTEGER PRIMARY KEY, "
+        "parent INTEGER NOT NULL, name BLOB NOT NULL, count INTEGER NOT NULL, "
+        "entries INTEGER NOT NULL%s, UNIQUE(parent, name));"
+        "CREATE TABLE \"%w\".\"%w_entry\"(id INTEGER PRIMARY KEY, "
+        "node INTEGER NOT NULL);%s%z",
+        p->zDb, p->zName, p->bClosure ? ", path TEXT NOT NULL" : "", p->zDb,
+        p->zName, zTriggers,
+        p->bClosure ? sqlite3_mprintf(
+                          "CREATE TABLE \"%w\".\"%w_closure\"("
+                          "ancestor INTEGER NOT NULL, depth INTEGER NOT NULL, "
+                          "descendant INTEGER NOT NULL, "
+                          "PRIMARY KEY(ancestor, depth, descendant), "
+                          "UNIQUE(descendant, depth, ancestor)) WITHOUT ROWID;",
+                          p->zDb, p->zName)
+                    : NULL);
+  if (zSql == NULL)
+    rc = SQLITE_NOMEM;
+  else
+    rc = sqlite3_exec(db, zSql, 0, 0, pzErr);
+  sqlite3_free(zSql);
+  sqlite3_free(zTriggers);
+  if (rc == SQLITE_OK)
+    rc = pathTrieRebuild(p);
+  if (rc != SQLITE_OK) {
+    if (*pzErr == NULL)
+      *pzErr = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+    pathTrieDisconnect(*ppVtab);
+    *ppVtab = NULL;
+  }
+  return rc;
+}
+
+static int pathTrieDestroy(sqlite3_vtab *pVtab) {
+  path_trie_vtab *p = (path_trie_vtab *)pVtab;
+  char *zSql = sqlite3_mprintf(
+      "DROP TRIGGER IF EXISTS \"%w\".\"%w_insert\";"
+      "DROP TRIGGER IF EXISTS \"%w\".\"%w_delete\";"
+      "DROP TRIGGER IF EXISTS \"%w\".\"%w_update\";"
+      "DROP TABLE IF EXISTS \"%w\".\"%w_node\";"
+      "DROP TABLE IF EXISTS \"%w\".\"%w_entry\";"
+      "DROP TABLE IF EXISTS \"%w\".\"%w_closure\";",
+      p->zDb, p->zName, p->zDb, p->zName, p->zDb, p->zName, p->zDb, p->zName,
+      p->zDb, p->zName, p->zDb, p->zName);
+  int rc;
+  if (zSql == NULL)
+    return SQLITE_NOMEM;
+  rc = sqlite3_exec(p->db, zSql, 0, 0, 0);
+  sqlite3_free(zSql);
+  if (rc == SQLITE_OK)
+    pathTrieDisconnect(pVtab);
+  return rc;
+}
+
+/*
+** Rename the shadow tables with the table, and recreate the triggers on the
+** source table under the new name, like FTS5 does. The triggers are read for
+** the name of the source table first, in case it was renamed too.
+*/
+static int pathTrieRename(sqlite3_vtab *pVtab, const char *zNew) {
+  path_trie_vtab *p = (path_trie_vtab *)pVtab;
+  char *zName = sqlite3_mprintf("%s", zNew);
+  char *zSql = NULL;
+  int rc = zName ? pathTrieSource(p) : SQLITE_NOMEM;
+  if (rc == SQLITE_OK) {
+    zSql = sqlite3_mprintf(
+        "DROP TRIGGER IF EXISTS \"%w\".\"%w_insert\";"
+        "DROP TRIGGER IF EXISTS \"%w\".\"%w_delete\";"
+        "DROP TRIGGER IF EXISTS \"%w\".\"%w_update\";"
+        "ALTER TABLE \"%w\".\"%w_node\" RENAME TO \"%w_node\";"
+        "ALTER TABLE \"%w\".\"%w_entry\" RENAME TO \"%w_entry\";%z",
+        p->zDb, p->zName, p->zDb, p->zName, p->zDb, p->zName, p->zDb,
+        p->zName, zNew, p->zDb, p->zName, zNew,
+        p->bClosure ? sqlite3_mprintf("ALTER TABLE \"%w\".\"%w_closure\" "
+                                      "RENAME TO \"%w_closure\";",
+                                      p->zDb, p->zName, zNew)
+                    : NULL);
+    rc = zSql ? sqlite3_exec(p->db, zSql, 0, 0, 0) : SQLITE_NOMEM;
+    sqlite3_free(zSql);
+  }
+  if (rc == SQLITE_OK) {
+    // the prepared statements name the old shadow tables
+    for (int i = 0; i < PATH_TRIE_STMT_COUNT; i++) {
+      sqlite3_finalize(p->aStmt[i]);
+      p->aStmt[i] = NULL;
+    }
+    sqlite3_free(p->zName);
+    p->zName = zName;
+    zName = NULL;
+    zSql = pathTrieTriggerSql(p);
+    rc = zSql ? sqlite3_exec(p->db, zSql, 0, 0, 0) : SQLITE_NOMEM;
+    sqlite3_free(zSql);
+  }
+  sqlite3_free(zName);
+  if (rc != SQLITE_OK && rc != SQLITE_NOMEM)
+    pVtab->zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(p->db));
+  return rc;
+}
+
+static int pathTrieShadowName(const char *zName) {
+  return sqlite3_stricmp(zName, "node") == 0 ||
+         sqlite3_stricmp(zName, "entry") == 0;
+}
+
+static int pathClosureShadowName(const char *zName) {
+  return pathTrieShadowName(zName) || sqlite3_stricmp(zName, "closure") == 0;
+}
+
+static int pathTrieOpen(sqlite3_vtab *pUnused,
+                        sqlite3_vtab_cursor **ppCursor) {
+  path_trie_cursor *pCur;
+  (void)pUnused;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0)
+    return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pathParsedInit(&pCur->parsed);
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int pathTrieClose(sqlite3_vtab_cursor *cur) {
+  path_trie_cursor *pCur = (path_trie_cursor *)cur;
+  sqlite3_free(pCur->aNode);
+  sqlite3_free(pCur->aBegin);
+  sqlite3_free(pCur->aEnd);
+  pathBufferFree(&pCur->path);
+  pathBufferFree(&pCur->target);
+  pathParsedFree(&pCur->parsed);
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+/*
+** Make node iNode, named with the nName bytes of zName, the deepest node of
+** the cursor, under the node that's currently deepest.
+*/
+static int pathTriePush(path_trie_cursor *pCur, sqlite3_int64 iNode,
+                        const char *zName, int nName, sqlite3_int64 nCount,
+                        sqlite3_int64 nEntries) {
+  const path_style *pStyle = pathVtabStyle(pCur->base.pVtab);
+  int iBegin = pCur->nNode > 0 ? pCur->aEnd[pCur->nNode - 1] : 0;
+  int rc;
+  if (pCur->nNode == pCur->nAlloc) {
+    int nAlloc = pCur->nAlloc ? pCur->nAlloc * 2 : 16;
+    sqlite3_int64 *aNode =
+        sqlite3_realloc64(pCur->aNode, nAlloc * sizeof(*aNode));
+    int *aBegin, *aEnd;
+    if (aNode == NULL)
+      return SQLITE_NOMEM;
+    pCur->aNode = aNode;
+    aBegin = sqlite3_realloc64(pCur->aBegin, nAlloc * sizeof(*aBegin));
+    if (aBegin == NULL)
+      return SQLITE_NOMEM;
+    pCur->aBegin = aBegin;
+    aEnd = sqlite3_realloc64(pCur->aEnd, nAlloc * sizeof(*aEnd));
+    if (aEnd == NULL)
+      return SQLITE_NOMEM;
+    pCur->aEnd = aEnd;
+    pCur->nAlloc = nAlloc;
+  }
+  rc = pathBufferReserve(&pCur->path, (sqlite3_int64)iBegin + nName + 1);
+  if (rc != SQLITE_OK)
+    return rc;
+  // segments are separated, roots like "/" already end with a separator
+  if (iBegin > 0 && !pathIsSeparator(pStyle->eStyle, pCur->path.z[iBegin - 1]))
+    pCur->path.z[iBegin++] = pStyle->cSeparator;
+  if (nName > 0)
+    memcpy(pCur->path.z + iBegin, zName, nName);
+  pCur->aNode[pCur->nNode] = iNode;
+  pCur->aBegin[pCur->nNode] = iBegin;
+  pCur->aEnd[pCur->nNode] = iBegin + nName;
+  pCur->nNode++;
+  pCur->nCount = nCount;
+  pCur->nEntries = nEntries;
+  return SQLITE_OK;
+}
+
+/*
+** Push the child of the deepest node named zName, if there is one. Sets
+** *pbFound to whether there was.
+*/
+static int pathTrieSeekChild(path_trie_cursor *pCur, const char *zName,
+                             int nName, int *pbFound) {
+  path_trie_vtab *p = (path_trie_vtab *)pCur->base.pVtab;
+  sqlite3_stmt *pStmt;
+  sqlite3_int64 iNode = 0, nCount = 0, nEntries = 0;
+  int rc = pathTriePrepare(p, PATH_TRIE_STMT_FIND, &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1,
+                     pCur->nNode > 0 ? pCur->aNode[pCur->nNode - 1] : 0);
+  pathTrieBindName(pStmt, 2, zName, nName);
+  *pbFound = sqlite3_step(pStmt) == SQLITE_ROW;
+  if (*pbFound) {
+    iNode = sqlite3_column_int64(pStmt, 0);
+    nCount = sqlite3_column_int64(pStmt, 1);
+    nEntries = sqlite3_column_int64(pStmt, 2);
+  }
+  rc = sqlite3_reset(pStmt);
+  if (rc == SQLITE_OK && *pbFound)
+    rc = pathTriePush(pCur, iNode, zName, nName, nCount, nEntries);
+  return rc;
+}
+
+/*
+** Push the first child of the deepest node whose name sorts after the
+** nAfter bytes of zAfter, or its first child at all when zAfter is NULL, if
+** there is one. Sets *pbFound to whether there was.
+*/
+static int pathTrieNextChild(path_trie_cursor *pCur, const char *zAfter,
+                             int nAfter, int *pbFound) {
+  path_trie_vtab *p = (path_trie_vtab *)pCur->base.pVtab;
+  sqlite3_stmt *pStmt;
+  int rc = pathTriePrepare(
+      p, zAfter ? PATH_TRIE_STMT_NEXT : PATH_TRIE_STMT_FIRST, &pStmt);
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_bind_int64(pStmt, 1,
+                     pCur->nNode > 0 ? pCur->aNode[pCur->nNode - 1] : 0);
+  // zAfter points into the cursor's path, which pathTriePush() overwrites
+  if (zAfter)
+    sqlite3_bind_blob(pStmt, 2, zAfter, nAfter, SQLITE_TRANSIENT);
+  *pbFound = sqlite3_step(pStmt) == SQLITE_ROW;
+  if (*pbFound)
+    rc = pathTriePush(pCur, sqlite3_column_int64(pStmt, 0),
+                      sqlite3_column_blob(pStmt, 1),
+                      sqlite3_column_bytes(pStmt, 1),
+                      sqlite3_column_int64(pStmt, 2),
+                      sqlite3_column_int64(pStmt, 3));
+  if (rc == SQLITE_OK)
+    rc = sqlite3_reset(pStmt);
+  else
+    sqlite3_reset(pStmt);
+  return rc;
+}
+
+/*
+** Move to the next node in depth-first order, or only to the next sibling
+** when bDescend is false, without leaving the directory of the scan.
+*/
+static int pathTrieStep(path_trie_cursor *pCur, int bDescend) {
+  int bFound = 0;
+  int rc = SQLITE_OK;
+  if (bDescend) {
+    rc = pathTrieNextChild(pCur, NULL, 0, &bFound);
+    if (rc != SQLITE_OK || bFound)
+      return rc;
+  }
+  while (pCur->nNode > pCur->nBase) {
+    int iTop = --pCur->nNode;
+    rc = pathTrieNextChild(pCur, pCur->path.z + pCur->aBegin[iTop],
+                           pCur->aEnd[iTop] - pCur->aBegin[iTop], &bFound);
+    if (rc != SQLITE_OK || bFound)
+      return rc;
+  }
+  pCur->bEof = 1;
+  return SQLITE_OK;
+}
+
+/*
+** Push the nodes of the normalized path, from its root down. Sets *pbFound
+** to whether every one of them is in the trie.
+*/
+static int pathTrieSeek(path_trie_cursor *pCur, sqlite3_value *value,
+                        int *pbFound) {
+  const path_style *pStyle = pathVtabStyle(pCur->base.pVtab);
+  path_parsed *parsed = &pCur->parsed;
+  const char *zPath;
+  int nPath;
+  int rc;
+
+  *pbFound = 0;
+  if (sqlite3_value_type(value) == SQLITE_NULL)
+    return SQLITE_OK;
+  zPath = pathValue(value, &nPath);
+  if (zPath == NULL)
+    return SQLITE_NOMEM;
+  // the value can change under a prefix_of scan, keep a copy
+  rc = pathBufferReserve(&pCur->target, nPath + 1);
+  if (rc != SQLITE_OK)
+    return rc;
+  memcpy(pCur->target.z, zPath, nPath);
+  rc = pathTokenize(pStyle, pCur->target.z, nPath, parsed);
+  if (rc != SQLITE_OK)
+    return rc;
+  pathResolveSegments(parsed);
+
+  rc = pathTrieSeekChild(pCur, pCur->target.z, parsed->nRoot, pbFound);
+  // a prefix_of scan pushes the rest one row at a time
+  if (pCur->idxNum == PATH_TRIE_INDEX_PREFIX_OF)
+    return rc;
+  for (int i = 0; i < parsed->nSegment && rc == SQLITE_OK && *pbFound; i++)
+    rc = pathTrieSeekChild(pCur, pCur->target.z + parsed->aBegin[i],
+                           parsed->aSize[i], pbFound);
+  return rc;
+}
+
+static int pathTrieFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                          const char *idxStr, int argc, sqlite3_value **argv) {
+  path_trie_cursor *pCur = (path_trie_cursor *)pVtabCursor;
+  int bFound = 1;
+  int rc = SQLITE_OK;
+  (void)idxStr;
+  (void)argc;
+
+  pCur->idxNum = idxNum;
+  pCur->nNode = 0;
+  pCur->nBase = 0;
+  pCur->bEof = 0;
+  if (idxNum != PATH_TRIE_INDEX_ALL) {
+    rc = pathTrieSeek(pCur, argv[0], &bFound);
+    if (rc != SQLITE_OK || !bFound) {
+      pCur->bEof = 1;
+      return rc;
+    }
+  }
+  switch (idxNum) {
+  case PATH_TRIE_INDEX_PATH:
+  case PATH_TRIE_INDEX_PREFIX_OF:
+    // the row is the node that was found
+    break;
+  case PATH_TRIE_INDEX_CHILDREN:
+  case PATH_TRIE_INDEX_DESCENDANTS:
+  case PATH_TRIE_INDEX_ALL:
+    pCur->nBase = pCur->nNode;
+    rc = pathTrieStep(pCur, 1);
+    break;
+  }
+  return rc;
+}
+
+static int pathTrieNext(sqlite3_vtab_cursor *cur) {
+  path_trie_cursor *pCur = (path_trie_cursor *)cur;
+  int iSegment = pCur->nNode - 1;
+  int bFound;
+  int rc;
+  switch (pCur->idxNum) {
+  case PATH_TRIE_INDEX_PATH:
+    pCur->bEof = 1;
+    return SQLITE_OK;
+  case PATH_TRIE_INDEX_PREFIX_OF:
+    if (iSegment >= pCur->parsed.nSegment) {
+      pCur->bEof = 1;
+      return SQLITE_OK;
+    }
+    rc = pathTrieSeekChild(pCur, pCur->target.z + pCur->parsed.aBegin[iSegment],
+                           pCur->parsed.aSize[iSegment], &bFound);
+    pCur->bEof = !bFound;
+    return rc;
+  case PATH_TRIE_INDEX_CHILDREN:
+    return pathTrieStep(pCur, 0);
+  default:
+    return pathTrieStep(pCur, 1);
+  }
+}
+
+static int pathTrieEof(sqlite3_vtab_cursor *cur) {
+  return ((path_trie_cursor *)cur)->bEof;
+}
+
+static int pathTrieColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx,
+                          int i) {
+  path_trie_cursor *pCur = (path_trie_cursor *)cur;
+  int iTop = pCur->nNode - 1;
+  switch (i) {
+  case PATH_TRIE_COLUMN_PATH:
+    sqlite3_result_text(ctx, pCur->path.z, pCur->aEnd[iTop], SQLITE_TRANSIENT);
+    break;
+  case PATH_TRIE_COLUMN_NAME:
+    sqlite3_result_text(ctx, pCur->path.z + pCur->aBegin[iTop],
+                        pCur->aEnd[iTop] - pCur->aBegin[iTop],
+                        SQLITE_TRANSIENT);
+    break;
+  case PATH_TRIE_COLUMN_DEPTH:
+    sqlite3_result_int(ctx, iTop);
+    break;
+  case PATH_TRIE_COLUMN_COUNT:
+    sqlite3_result_int64(ctx, pCur->nCount);
+    break;
+  case PATH_TRIE_COLUMN_ENTRIES:
+    sqlite3_result_int64(ctx, pCur->nEntries);
+    break;
+  }
+  return SQLITE_OK;
+}
+
+static int pathTrieRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+  path_trie_cursor *pCur = (path_trie_cursor *)cur;
+  *pRowid = pCur->aNode[pCur->nNode - 1];
+  return SQLITE_OK;
+}
+
+/*
+** Any one of path, prefix_of, children and descendants picks the nodes to
+** scan, in that order of preference. path_under(path, dir) is the same as
+** descendants = dir, see pathTrieFindFunction().
+*/
+static int pathTrieBestIndex(sqlite3_vtab *pVTab,
+                             sqlite3_index_info *pIdxInfo) {
+  static const double aCost[] = {1000000.0, 1.0, 10.0, 100.0, 1000.0};
+  int iCons = -1;
+  int idxNum = PATH_TRIE_INDEX_ALL;
+  (void)pVTab;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+    int iIndex = PATH_TRIE_INDEX_ALL;
+    if (pCons->op == SQLITE_INDEX_CONSTRAINT_FUNCTION &&
+        pCons->iColumn == PATH_TRIE_COLUMN_PATH)
+      iIndex = PATH_TRIE_INDEX_DESCENDANTS;
+    else if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ)
+      continue;
+    else if (pCons->iColumn == PATH_TRIE_COLUMN_PATH)
+      iIndex = PATH_TRIE_INDEX_PATH;
+    else if (pCons->iColumn == PATH_TRIE_COLUMN_PREFIX_OF)
+      iIndex = PATH_TRIE_INDEX_PREFIX_OF;
+    else if (pCons->iColumn == PATH_TRIE_COLUMN_CHILDREN)
+      iIndex = PATH_TRIE_INDEX_CHILDREN;
+    else if (pCons->iColumn == PATH_TRIE_COLUMN_DESCENDANTS)
+      iIndex = PATH_TRIE_INDEX_DESCENDANTS;
+    if (iIndex == PATH_TRIE_INDEX_ALL)
+      continue;
+    // hidden columns are only inputs, they can't be filtered on afterwards
+    if (!pCons->usable) {
+      if (pCons->iColumn >= PATH_TRIE_COLUMN_CHILDREN)
+        return SQLITE_CONSTRAINT;
+      continue;
+    }
+    if (idxNum == PATH_TRIE_INDEX_ALL || iIndex < idxNum) {
+      idxNum = iIndex;
+      iCons = i;
+    }
+  }
+  pIdxInfo->idxNum = idxNum;
+  pIdxInfo->estimatedCost = aCost[idxNum];
+  pIdxInfo->estimatedRows = (sqlite3_int64)aCost[idxNum];
+  if (idxNum == PATH_TRIE_INDEX_PATH)
+    pIdxInfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+  if (iCons >= 0) {
+    pIdxInfo->aConstraintUsage[iCons].argvIndex = 1;
+    pIdxInfo->aConstraintUsage[iCons].omit = 1;
+  }
+  return SQLITE_OK;
+}
+
+// path_under() as called on a path_trie's path column
+static path_function pathTrieUnderFunction = {0, &pathStyleUnix,
+                                              pathUnderFunc, 0, 0};
+
+/*
+** Overloads path_under(path, dir), so SQLite hands it to xBestIndex as a
+** constraint instead of calling it on every node.
+*/
+static int pathTrieFindFunction(sqlite3_vtab *pVtab, int nArg,
+                                const char *zName,
+                                void (**pxFunc)(sqlite3_context *, int,
+                                                sqlite3_value **),
+                                void **ppArg) {
+  (void)pVtab;
+  if (nArg != 2 || sqlite3_stricmp(zName, "path_under") != 0)
+    return 0;
+  *pxFunc = pathUnderFunc;
+  *ppArg = &pathTrieUnderFunction;
+  return SQLITE_INDEX_CONSTRAINT_FUNCTION;
+}
+
+/*
+** Inserts index a row of the source table, and the command column removes
+** one or rebuilds the index. Rows can't be updated or deleted directly.
+*/
+static int pathTrieUpdate(sqlite3_vtab *pVtab, int argc, sqlite3_value **argv,
+                          sqlite3_int64 *pRowid) {
+  path_trie_vtab *p = (path_trie_vtab *)pVtab;
+  sqlite3_value *command;
+  const char *zPath;
+  int nPath;
+  int rc;
+  const char *zModule = p->bClosure ? "path_closure" : "path_trie";
+  int iPath =
+      p->bClosure ? PATH_CLOSURE_COLUMN_DESCENDANT : PATH_TRIE_COLUMN_PATH;
+  (void)pRowid;
+
+  if (argc == 1 || sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+    pVtab->zErrMsg = sqlite3_mprintf("%s tables follow %s, change it instead",
+                                     zModule, p->zSource);
+    return SQLITE_ERROR;
+  }
+  command = argv[2 + (p->bClosure ? PATH_CLOSURE_COLUMN_COMMAND
+                                  : PATH_TRIE_COLUMN_COMMAND)];
+  if (sqlite3_value_type(command) != SQLITE_NULL) {
+    const char *zCommand = (const char *)sqlite3_value_text(command);
+    if (zCommand && sqlite3_stricmp(zCommand, "rebuild") == 0) {
+      rc = pathTrieRebuild(p);
+    } else if (zCommand && sqlite3_stricmp(zCommand, "delete") == 0) {
+      rc = pathTrieDelete(p, sqlite3_value_int64(argv[1]));
+    } else {
+      pVtab->zErrMsg = sqlite3_mprintf(
+          "unknown %s command '%s', expected 'delete' or 'rebuild'", zModule,
+          zCommand ? zCommand : "");
+      return SQLITE_ERROR;
+    }
+  } else if (sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    pVtab->zErrMsg = sqlite3_mprintf(
+        "%s needs the rowid of the row in %s to index", zModule, p->zSource);
+    return SQLITE_ERROR;
+  } else {
+    // indexing a rowid again replaces its path
+    rc = pathTrieDelete(p, sqlite3_value_int64(argv[1]));
+    if (rc == SQLITE_OK &&
+        sqlite3_value_type(argv[2 + iPath]) != SQLITE_NULL) {
+      zPath = pathValue(argv[2 + iPath], &nPath);
+      if (zPath == NULL)
+        return SQLITE_NOMEM;
+      rc = pathTrieInsert(p, sqlite3_value_int64(argv[1]), zPath, nPath);
+    }
+  }
+  // the statements on the shadow tables and the source table left the
+  // reason in the connection, not in the table
+  if (rc != SQLITE_OK && rc != SQLITE_NOMEM)
+    pVtab->zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(p->db));
+  return rc;
+}
+
+static sqlite3_module pathTrieModule = {
+    3,                    /* iVersion */
+    pathTrieCreate,       /* xCreate */
+    pathTrieConnect,      /* xConnect */
+    pathTrieBestIndex,    /* xBestIndex */
+    pathTrieDisconnect,   /* xDisconnect */
+    pathTrieDestroy,      /* xDestroy */
+    pathTrieOpen,         /* xOpen - open a cursor */
+    pathTrieClose,        /* xClose - close a cursor */
+    pathTrieFilter,       /* xFilter - configure scan constraints */
+    pathTrieNext,         /* xNext - advance a cursor */
+    pathTrieEof,          /* xEof - check for end of scan */
+    pathTrieColumn,       /* xColumn - read data */
+    pathTrieRowid,        /* xRowid - read data */
+    pathTrieUpdate,       /* xUpdate */
+    0,                    /* xBegin */
+    0,                    /* xSync */
+    0,                    /* xCommit */
+    0,                    /* xRollback */
+    pathTrieFindFunction, /* xFindMethod */
+    pathTrieRename,       /* xRename */
+    0,                    /* xSavepoint */
+    0,                    /* xRelease */
+    0,                    /* xRollbackTo */
+    pathTrieShadowName    /* xShadowName */
+};
+
+// idxNum bits of a path_closure scan. xFilter gets the ancestor, then the
+// descendant, then the lowest and the highest depth, for the bits that are
+// set. A path, rather than an id, is looked up in the trie first.
+#define PATH_CLOSURE_INDEX_ANCESTOR 0x01
+#define PATH_CLOSURE_INDEX_DESCENDANT 0x02
+#define PATH_CLOSURE_INDEX_ANCESTOR_PATH 0x04
+#define PATH_CLOSURE_INDEX_DESCENDANT_PATH 0x08
+#define PATH_CLOSURE_INDEX_DEPTH_EQ 0x10
+#define PATH_CLOSURE_INDEX_DEPTH_GE 0x20
+#define PATH_CLOSURE_INDEX_DEPTH_GT 0x40
+#define PATH_CLOSURE_INDEX_DEPTH_LE 0x80
+#define PATH_CLOSURE_INDEX_DEPTH_LT 0x100
+
+// the scan of each combination of ancestor and descendant, in ?1 and ?2,
+// between the depths ?3 and ?4
+static const char *const pathClosureSql[] = {
+    "",
+    " WHERE c.ancestor = ?1 AND c.depth BETWEEN ?3 AND ?4",
+    " WHERE c.descendant = ?2 AND c.depth BETWEEN ?3 AND ?4",
+    " WHERE c.ancestor = ?1 AND c.descendant = ?2 "
+    "AND c.depth BETWEEN ?3 AND ?4",
+};
+
+typedef struct path_closure_cursor path_closure_cursor;
+struct path_closure_cursor {
+  sqlite3_vtab_cursor base;
+  // the scan, kept prepared for the next xFilter of the same plan
+  sqlite3_stmt *pStmt;
+  int iPlan;
+  int bEof;
+  sqlite3_int64 iRowid;
+};
+
+/*
+** Set *piNode to the node of the path in value, or 0 if it isn't indexed.
+*/
+static int pathTrieLookup(path_trie_vtab *p, sqlite3_value *value,
+                          sqlite3_int64 *piNode) {
+  path_parsed parsed;
+  const char *zPath;
+  int nPath;
+  int rc;
+
+  *piNode = 0;
+  if (sqlite3_value_type(value) == SQLITE_NULL)
+    return SQLITE_OK;
+  zPath = pathValue(value, &nPath);
+  if (zPath == NULL)
+    return SQLITE_NOMEM;
+  pathParsedInit(&parsed);
+  rc = pathTokenize(p->base.pStyle, zPath, nPath, &parsed);
+  if (rc == SQLITE_OK) {
+    pathResolveSegments(&parsed);
+    rc = pathTrieFindChild(p, 0, zPath, parsed.nRoot, piNode);
+  }
+  for (int i = 0; i < parsed.nSegment && rc == SQLITE_OK && *piNode != 0; i++)
+    rc = pathTrieFindChild(p, *piNode, zPath + parsed.aBegin[i],
+                           parsed.aSize[i], piNode);
+  pathParsedFree(&parsed);
+  return rc;
+}
+
+static int pathClosureOpen(sqlite3_vtab *pUnused,
+                           sqlite3_vtab_cursor **ppCursor) {
+  path_closure_cursor *pCur;
+  (void)pUnused;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0)
+    return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int pathClosureClose(sqlite3_vtab_cursor *cur) {
+  path_closure_cursor *pCur = (path_closure_cursor *)cur;
+  sqlite3_finalize(pCur->pStmt);
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+/*
+** Narrow [*piLow, *piHigh] to the depths that satisfy depth <op> value.
+** Values that aren't numbers leave it as is, SQLite checks those itself.
+*/
+static void pathClosureBound(int op, sqlite3_value *value,
+                             sqlite3_int64 *piLow, sqlite3_int64 *piHigh) {
+  double r;
+  sqlite3_int64 iFloor, iCeil;
+  int eType = sqlite3_value_type(value);
+  if (eType != SQLITE_INTEGER && eType != SQLITE_FLOAT)
+    return;
+  r = sqlite3_value_double(value);
+  // depths are small, anything out of this range selects all or nothing
+  if (r < -1.0)
+    r = -1.0;
+  if (r > 1e9)
+    r = 1e9;
+  iFloor = (sqlite3_int64)r;
+  if ((double)iFloor > r)
+    iFloor--;
+  iCeil = (double)iFloor < r ? iFloor + 1 : iFloor;
+  switch (op) {
+  case PATH_CLOSURE_INDEX_DEPTH_GE:
+    if (iCeil > *piLow)
+      *piLow = iCeil;
+    break;
+  case PATH_CLOSURE_INDEX_DEPTH_GT:
+    if (iFloor + 1 > *piLow)
+      *piLow = iFloor + 1;
+    break;
+  case PATH_CLOSURE_INDEX_DEPTH_LE:
+    if (iFloor < *piHigh)
+      *piHigh = iFloor;
+    break;
+  case PATH_CLOSURE_INDEX_DEPTH_LT:
+    if (iCeil - 1 < *piHigh)
+      *piHigh = iCeil - 1;
+    break;
+  }
+}
+
+/*
+** The node id in value, compared the way SQLite compares with the int id
+** columns: 2, 2.0 and '2' are all node 2. Anything else is no node, 0.
+*/
+static sqlite3_int64 pathClosureId(sqlite3_value *value) {
+  double r;
+  switch (sqlite3_value_numeric_type(value)) {
+  case SQLITE_INTEGER:
+    return sqlite3_value_int64(value);
+  case SQLITE_FLOAT:
+    r = sqlite3_value_double(value);
+    // only a whole number in range can be a rowid
+    if (r >= -9.2e18 && r <= 9.2e18 && r == (double)(sqlite3_int64)r)
+      return (sqlite3_int64)r;
+    break;
+  }
+  return 0;
+}
+
+static int pathClosureNext(sqlite3_vtab_cursor *cur) {
+  path_closure_cursor *pCur = (path_closure_cursor *)cur;
+  int rc = sqlite3_step(pCur->pStmt);
+  pCur->iRowid++;
+  if (rc == SQLITE_ROW)
+    return SQLITE_OK;
+  pCur->bEof = 1;
+  rc = sqlite3_reset(pCur->pStmt);
+  if (rc != SQLITE_OK && cur->pVtab->zErrMsg == NULL)
+    cur->pVtab->zErrMsg = sqlite3_mprintf(
+        "%s", sqlite3_errmsg(((path_trie_vtab *)cur->pVtab)->db));
+  return rc;
+}
+
+static int pathClosureFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                             const char *idxStr, int argc,
+                             sqlite3_value **argv) {
+  path_closure_cursor *pCur = (path_closure_cursor *)pVtabCursor;
+  path_trie_vtab *p = (path_trie_vtab *)pVtabCursor->pVtab;
+  static const int aBound[] = {
+      PATH_CLOSURE_INDEX_DEPTH_GE, PATH_CLOSURE_INDEX_DEPTH_GT,
+      PATH_CLOSURE_INDEX_DEPTH_LE, PATH_CLOSURE_INDEX_DEPTH_LT};
+  int iPlan = idxNum &
+              (PATH_CLOSURE_INDEX_ANCESTOR | PATH_CLOSURE_INDEX_DESCENDANT);
+  sqlite3_int64 aNode[2] = {0, 0};
+  sqlite3_int64 iLow = 0, iHigh = 1000000000;
+  int iArg = 0;
+  int rc = SQLITE_OK;
+  (void)idxStr;
+  (void)argc;
+
+  pCur->bEof = 1;
+  pCur->iRowid = 0;
+  if (pCur->pStmt && pCur->iPlan != iPlan) {
+    sqlite3_finalize(pCur->pStmt);
+    pCur->pStmt = NULL;
+  }
+  if (pCur->pStmt == NULL) {
+    char *zSql = sqlite3_mprintf(
+        "SELECT a.path, d.path, c.depth, c.ancestor, c.descendant "
+        "FROM \"%w\".\"%w_closure\" c "
+        "JOIN \"%w\".\"%w_node\" a ON a.id = c.ancestor "
+        "JOIN \"%w\".\"%w_node\" d ON d.id = c.descendant%s",
+        p->zDb, p->zName, p->zDb, p->zName, p->zDb, p->zName,
+        pathClosureSql[iPlan]);
+    if (zSql == NULL)
+      return SQLITE_NOMEM;
+    rc = sqlite3_prepare_v3(p->db, zSql, -1, SQLITE_PREPARE_PERSISTENT,
+                            &pCur->pStmt, 0);
+    sqlite3_free(zSql);
+    if (rc != SQLITE_OK)
+      return rc;
+    pCur->iPlan = iPlan;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    if (!(idxNum & (PATH_CLOSURE_INDEX_ANCESTOR << i)))
+      continue;
+    if (idxNum & (PATH_CLOSURE_INDEX_ANCESTOR_PATH << i))
+      rc = pathTrieLookup(p, argv[iArg], &aNode[i]);
+    else
+      aNode[i] = pathClosureId(argv[iArg]);
+    iArg++;
+    // an unknown path or id has no pairs
+    if (rc != SQLITE_OK || aNode[i] == 0)
+      return rc;
+    sqlite3_bind_int64(pCur->pStmt, i + 1, aNode[i]);
+  }
+  if (idxNum & PATH_CLOSURE_INDEX_DEPTH_EQ) {
+    pathClosureBound(PATH_CLOSURE_INDEX_DEPTH_GE, argv[iArg], &iLow, &iHigh);
+    pathClosureBound(PATH_CLOSURE_INDEX_DEPTH_LE, argv[iArg], &iLow, &iHigh);
+    iArg++;
+  }
+  for (int i = 0; i < 4; i++) {
+    if (idxNum & aBound[i])
+      pathClosureBound(aBound[i], argv[iArg++], &iLow, &iHigh);
+  }
+  if (iLow > iHigh)
+    return SQLITE_OK;
+  sqlite3_bind_int64(pCur->pStmt, 3, iLow);
+  sqlite3_bind_int64(pCur->pStmt, 4, iHigh);
+  pCur->bEof = 0;
+  pCur->iRowid = 0;
+  return pathClosureNext(pVtabCursor);
+}
+
+static int pathClosureEof(sqlite3_vtab_cursor *cur) {
+  return ((path_closure_cursor *)cur)->bEof;
+}
+
+static int pathClosureColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx,
+                             int i) {
+  path_closure_cursor *pCur = (path_closure_cursor *)cur;
+  // the scan's columns are in the same order as the table's
+  if (i < PATH_CLOSURE_COLUMN_COMMAND)
+    sqlite3_result_value(ctx, sqlite3_column_value(pCur->pStmt, i));
+  return SQLITE_OK;
+}
+
+static int pathClosureRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+  *pRowid = ((path_closure_cursor *)cur)->iRowid;
+  return SQLITE_OK;
+}
+
+/*
+** An ancestor or descendant, by path or id, narrows the scan to one index
+** range of the closure, and depth constraints narrow that range further.
+*/
+static int pathClosureBestIndex(sqlite3_vtab *pVTab,
+                                sqlite3_index_info *pIdxInfo) {
+  // the constraint that gives the ancestor, descendant and each depth bound
+  int aCons[7] = {-1, -1, -1, -1, -1, -1, -1};
+  static const int aFlag[7] = {
+      PATH_CLOSURE_INDEX_ANCESTOR,  PATH_CLOSURE_INDEX_DESCENDANT,
+      PATH_CLOSURE_INDEX_DEPTH_EQ,  PATH_CLOSURE_INDEX_DEPTH_GE,
+      PATH_CLOSURE_INDEX_DEPTH_GT,  PATH_CLOSURE_INDEX_DEPTH_LE,
+      PATH_CLOSURE_INDEX_DEPTH_LT};
+  double rCost = 1000000.0;
+  int idxNum = 0;
+  int iArg = 0;
+  (void)pVTab;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
+    int iSlot = -1, bPath = 0;
+    if (!pCons->usable)
+      continue;
+    switch (pCons->iColumn) {
+    case PATH_CLOSURE_COLUMN_ANCESTOR:
+    case PATH_CLOSURE_COLUMN_ANCESTOR_ID:
+    case PATH_CLOSURE_COLUMN_DESCENDANT:
+    case PATH_CLOSURE_COLUMN_DESCENDANT_ID:
+      if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ)
+        break;
+      iSlot = pCons->iColumn == PATH_CLOSURE_COLUMN_ANCESTOR ||
+                      pCons->iColumn == PATH_CLOSURE_COLUMN_ANCESTOR_ID
+                  ? 0
+                  : 1;
+      bPath = pCons->iColumn < PATH_CLOSURE_COLUMN_DEPTH;
+      // an id is cheaper than a path, which has to be looked up first
+      if (aCons[iSlot] >= 0 && bPath)
+        iSlot = -1;
+      break;
+    case PATH_CLOSURE_COLUMN_DEPTH:
+      switch (pCons->op) {
+      case SQLITE_INDEX_CONSTRAINT_EQ:
+        iSlot = 2;
+        break;
+      case SQLITE_INDEX_CONSTRAINT_GE:
+        iSlot = 3;
+        break;
+      case SQLITE_INDEX_CONSTRAINT_GT:
+        iSlot = 4;
+        break;
+      case SQLITE_INDEX_CONSTRAINT_LE:
+        iSlot = 5;
+        break;
+      case SQLITE_INDEX_CONSTRAINT_LT:
+        iSlot = 6;
+        break;
+      }
+      break;
+    }
+    if (iSlot < 0)
+      continue;
+    aCons[iSlot] = i;
+    idxNum |= aFlag[iSlot];
+    if (iSlot < 2) {
+      int bitPath = PATH_CLOSURE_INDEX_ANCESTOR_PATH << iSlot;
+      idxNum = bPath ? idxNum | bitPath : idxNum & ~bitPath;
+    }
+  }
+
+  for (int i = 0; i < 7; i++) {
+    if (aCons[i] < 0)
+      continue;
+    pIdxInfo->aConstraintUsage[aCons[i]].argvIndex = ++iArg;
+    // depths might not be integers, SQLite compares those again
+    pIdxInfo->aConstraintUsage[aCons[i]].omit = i < 2;
+  }
+  if ((idxNum & PATH_CLOSURE_INDEX_ANCESTOR) &&
+      (idxNum & PATH_CLOSURE_INDEX_DESCENDANT)) {
+    rCost = 1.0;
+    pIdxInfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+  } else if (idxNum & PATH_CLOSURE_INDEX_DESCENDANT) {
+    rCost = 10.0;
+  } else if (idxNum & PATH_CLOSURE_INDEX_ANCESTOR) {
+    rCost = 1000.0;
+  }
+  if (idxNum & PATH_CLOSURE_INDEX_DEPTH_EQ)
+    rCost /= 10.0;
+  else if (idxNum & ~0xf)
+    rCost /= 2.0;
+  pIdxInfo->idxNum = idxNum;
+  pIdxInfo->estimatedCost = rCost;
+  pIdxInfo->estimatedRows = rCost < 1.0 ? 1 : (sqlite3_int64)rCost;
+  return SQLITE_OK;
+}
+
+static sqlite3_module pathClosureModule = {
+    3,                    /* iVersion */
+    pathTrieCreate,       /* xCreate */
+    pathTrieConnect,      /* xConnect */
+    pathClosureBestIndex, /* xBestIndex */
+    pathTrieDisconnect,   /* xDisconnect */
+    pathTrieDestroy,      /* xDestroy */
+    pathClosureOpen,      /* xOpen - open a cursor */
+    pathClosureClose,     /* xClose - close a cursor */
+    pathClosureFilter,    /* xFilter - configure scan constraints */
+    pathClosureNext,      /* xNext - advance a cursor */
+    pathClosureEof,       /* xEof - check for end of scan */
+    pathClosureColumn,    /* xColumn - read data */
+    pathClosureRowid,     /* xRowid - read data */
+    pathTrieUpdate,       /* xUpdate */
+    0,                    /* xBegin */
+    0,                    /* xSync */
+    0,                    /* xCommit */
+    0,                    /* xRollback */
+    0,                    /* xFindMethod */
+    pathTrieRename,       /* xRename */
+    0,                    /* xSavepoint */
+    0,                    /* xRelease */
+    0,                    /* xRollbackTo */
+    pathClosureShadowName /* xShadowName */
+};
+
+#pragma endregion
+
+#pragma region sqlite - path aggregates
+
+// aggregates that return JSON tag it with the subtype of SQLite's JSON
+// functions, so json_each() and friends take it as is
+#define PATH_JSON_SUBTYPE 'J'
+#ifdef SQLITE_RESULT_SUBTYPE
+#define PATH_JSON_FLAGS SQLITE_RESULT_SUBTYPE
+#else
+#define PATH_JSON_FLAGS 0
+#endif
+// and the ones that take JSON arguments read their subtype
+#ifdef SQLITE_SUBTYPE
+#define PATH_JSON_ARG_FLAGS SQLITE_SUBTYPE
+#else
+#define PATH_JSON_ARG_FLAGS 0
+#endif
+
+/*
+** A JSON document built in a growable buffer. Appends after a failed one
+** are no-ops, so rc only needs to be checked once at the end.
+*/
+typedef struct path_json path_json;
+struct path_json {
+  path_buffer buf;
+  sqlite3_int64 n;
+  int rc;
+};
+
+static void pathJsonAppend(path_json *p, const char *z, sqlite3_int64 n) {
+  if (p->rc != SQLITE_OK)
+    return;
+  // doubled, documents are built a few bytes at a time
+  if (p->n + n + 1 > p->buf.nAlloc)
+    p->rc = pathBufferReserve(&p->buf, (p->n + n + 1) * 2);
+  if (p->rc != SQLITE_OK)
+    return;
+  memcpy(p->buf.z + p->n, z, n);
+  p->n += n;
+}
+
+/*
+** Append n bytes of z as a JSON string. Paths are passed through as they
+** are, besides the characters JSON requires to be escaped.
+*/
+static void pathJsonString(path_json *p, const char *z, sqlite3_int64 n) {
+  static const char aHex[] = "0123456789abcdef";
+  sqlite3_int64 iStart = 0;
+  pathJsonAppend(p, "\"", 1);
+  for (sqlite3_int64 i = 0; i < n; i++) {
+    unsigned char c = (unsigned char)z[i];
+    char aEscape[6] = {'\\', 'u', '0', '0', 0, 0};
+    int nEscape = 2;
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    pathJsonAppend(p, z + iStart, i - iStart);
+    iStart = i + 1;
+    switch (c) {
+    case '"':
+    case '\\':
+      aEscape[1] = (char)c;
+      break;
+    case '\n':
+      aEscape[1] = 'n';
+      break;
+    case '\t':
+      aEscape[1] = 't';
+      break;
+    default:
+      aEscape[4] = aHex[c >> 4];
+      aEscape[5] = aHex[c & 0xf];
+      nEscape = 6;
+    }
+    pathJsonAppend(p, aEscape, nEscape);
+  }
+  pathJsonAppend(p, z + iStart, n - iStart);
+  pathJsonAppend(p, "\"", 1);
+}
+
+static void pathJsonInt(path_json *p, sqlite3_int64 i) {
+  char zNum[32];
+  sqlite3_snprintf(sizeof(zNum), zNum, "%lld", i);
+  pathJsonAppend(p, zNum, strlen(zNum));
+}
+
+static void pathJsonReal(path_json *p, double r) {
+  char zNum[32];
+  // JSON has no NaN or infinity, SQLite's own JSON writes them the same way
+  if (r != r)
+    sqlite3_snprintf(sizeof(zNum), zNum, "null");
+  else if (r > 1e308 || r < -1e308)
+    sqlite3_snprintf(sizeof(zNum), zNum, "%s9e999", r < 0 ? "-" : "");
+  else
+    sqlite3_snprintf(sizeof(zNum), zNum, "%!.15g", r);
+  pathJsonAppend(p, zNum, strlen(zNum));
+}
+
+/*
+** Hand the document to SQLite as the result of an aggregate, or its error.
+*/
+static void pathJsonResult(sqlite3_context *context, path_json *p) {
+  if (p->rc == SQLITE_OK)
+    p->rc = pathBufferReserve(&p->buf, p->n + 1);
+  if (p->rc != SQLITE_OK) {
+    pathBufferFree(&p->buf);
+    sqlite3_result_error_code(context, p->rc);
+    return;
+  }
+  p->buf.z[p->n] = 0;
+  sqlite3_result_text64(context, p->buf.z, p->n, sqlite3_free, SQLITE_UTF8);
+  sqlite3_result_subtype(context, PATH_JSON_SUBTYPE);
+  p->buf.z = NULL;
+  p->buf.nAlloc = 0;
+}
+
+/** path_rollup(path, value)
+ * Aggregate that adds value to every ancestor of path, like
+ * `sum(value) ... group by path_ancestors(path).prefix`, but in one pass
+ * over the rows instead of sorting depth×N of them. Returns a JSON object
+ * of every ancestor's normalized path and its total, depth first:
+ * `{"/": 7, "/srv": 7, "/srv/a": 3, "/srv/b": 4}`. Use json_each() on it
+ * for a table. Rows with a NULL path or value are skipped. Totals are
+ * integers like sum(), unless any value was a real.
+ *
+ * The ancestors are kept in a trie of segments, hashed by their parent and
+ * name, so memory grows with the number of directories, not of rows.
+ */
+
+typedef struct path_rollup_node path_rollup_node;
+struct path_rollup_node {
+  // index of the parent node, or -1 for a root
+  int iParent;
+  int nName;
+  // offset of the name in path_rollup.names
+  sqlite3_int64 iName;
+  unsigned int iHash;
+  sqlite3_int64 iSum;
+  double rSum;
+  // path_tree's payload of the row with this path, where it starts in
+  // path_rollup.payloads and its size, 0 for none
+  sqlite3_int64 iPayload;
+  int nPayload;
+};
+
+typedef struct path_rollup path_rollup;
+struct path_rollup {
+  // the aggregate context starts out zeroed, so this says it's set up
+  int bInit;
+  int rc;
+  // whether any value was a real, and whether the integer sums overflowed
+  int bReal;
+  int bOverflow;
+  const path_style *pStyle;
+  path_rollup_node *aNode;
+  int nNode;
+  int nNodeAlloc;
+  // open addressing table of node index + 1, 0 for an empty slot
+  int *aHash;
+  int nHash;
+  // names of every node, back to back
+  path_buffer names;
+  sqlite3_int64 nNames;
+  // segments of the current row's path
+  path_parsed parsed;
+  // path_tree's payloads, as JSON back to back
+  path_json payloads;
+  // path_tree's order and max_children, read from the first row
+  int bTreeArgs;
+  int iTreeOrder;
+  int nTreeMaxChildren;
+};
+
+/*
+** Hash of a child's name. With bFold set, names that pathCompareWindows()
+** finds equal hash the same: ASCII case and '\\' are folded first.
+*/
+static unsigned int pathRollupHash(int iParent, const char *z, int n,
+                                   int bFold) {
+  // FNV-1a, seeded with the parent so equal names of siblings' children
+  // hash apart
+  unsigned int h = 2166136261u ^ (unsigned int)iParent;
+  for (int i = 0; i < n; i++) {
+    unsigned char c = (unsigned char)z[i];
+    if (bFold)
+      c = c == '\\' ? '/' : (unsigned char)tolower(c);
+    h = (h ^ c) * 16777619u;
+  }
+  return h;
+}
+
+/*
+** Double the hash table, and put every node back in it.
+*/
+static int pathRollupRehash(path_rollup *p) {
+  int nHash = p->nHash ? p->nHash * 2 : 1024;
+  int *aHash = sqlite3_malloc64(sizeof(*aHash) * nHash);
+  if (aHash == NULL)
+    return SQLITE_NOMEM;
+  memset(aHash, 0, sizeof(*aHash) * nHash);
+  for (int i = 0; i < p->nNode; i++) {
+    unsigned int iSlot = p->aNode[i].iHash & (nHash - 1);
+    while (aHash[iSlot])
+      iSlot = (iSlot + 1) & (nHash - 1);
+    aHash[iSlot] = i + 1;
+  }
+  sqlite3_free(p->aHash);
+  p->aHash = aHash;
+  p->nHash = nHash;
+  return SQLITE_OK;
+}
+
+/*
+** Set *piNode to the child of iParent named with the n bytes of z, adding
+** it if there's none yet. Names match the way the style compares them, so
+** Windows children differ by more than case, and keep their first spelling.
+*/
+static int pathRollupChild(path_rollup *p, int iParent, const char *z, int n,
+                           int *piNode) {
+  unsigned int iHash = pathRollupHash(
+      iParent, z, n, p->pStyle->eStyle == PATH_STYLE_WINDOWS);
+  unsigned int iSlot;
+  path_rollup_node *pNode;
+  int rc;
+
+  // kept at most half full
+  if (p->nNode * 2 >= p->nHash) {
+    rc = pathRollupRehash(p);
+    if (rc != SQLITE_OK)
+      return rc;
+  }
+  for (iSlot = iHash & (p->nHash - 1); p->aHash[iSlot];
+       iSlot = (iSlot + 1) & (p->nHash - 1)) {
+    pNode = &p->aNode[p->aHash[iSlot] - 1];
+    if (pNode->iHash == iHash && pNode->iParent == iParent &&
+        pNode->nName == n &&
+        (n == 0 || p->pStyle->xCompare(p->names.z + pNode->iName, z, n) == 0)) {
+      *piNode = p->aHash[iSlot] - 1;
+      return SQLITE_OK;
+    }
+  }
+
+  if (p->nNode == p->nNodeAlloc) {
+    int nAlloc;
+    path_rollup_node *aNode;
+    // node indexes, plus one, need to fit in the hash table's ints
+    if (p->nNodeAlloc > INT_MAX / 4)
+      return SQLITE_TOOBIG;
+    nAlloc = p->nNodeAlloc ? p->nNodeAlloc * 2 : 256;
+    aNode = sqlite3_realloc64(p->aNode, sizeof(*aNode) * nAlloc);
+    if (aNode == NULL)
+      return SQLITE_NOMEM;
+    p->aNode = aNode;
+    p->nNodeAlloc = nAlloc;
+  }
+  if (p->nNames + n > p->names.nAlloc) {
+    rc = pathBufferReserve(&p->names, (p->nNames + n) * 2);
+    if (rc != SQLITE_OK)
+      return rc;
+  }
+  if (n > 0)
+    memcpy(p->names.z + p->nNames, z, n);
+  pNode = &p->aNode[p->nNode];
+  memset(pNode, 0, sizeof(*pNode));
+  pNode->iParent = iParent;
+  pNode->nName = n;
+  pNode->iName = p->nNames;
+  pNode->iHash = iHash;
+  p->nNames += n;
+  p->aHash[iSlot] = p->nNode + 1;
+  *piNode = p->nNode++;
+  return SQLITE_OK;
+}
+
+/*
+** The aggregate context of path_rollup and path_tree, set up on the first
+** row. NULL, with the error set, on an OOM.
+*/
+static path_rollup *pathRollupContext(sqlite3_context *context) {
+  path_rollup *p = sqlite3_aggregate_context(context, sizeof(*p));
+  if (p == NULL) {
+    sqlite3_result_error_nomem(context);
+    return NULL;
+  }
+  if (!p->bInit) {
+    p->bInit = 1;
+    p->pStyle = (const path_style *)sqlite3_user_data(context);
+    pathParsedInit(&p->parsed);
+  }
+  return p;
+}
+
+static void pathRollupFree(path_rollup *p) {
+  sqlite3_free(p->aNode);
+  sqlite3_free(p->aHash);
+  pathBufferFree(&p->names);
+  pathBufferFree(&p->payloads.buf);
+  pathParsedFree(&p->parsed);
+}
+
+/*
+** Add iValue and rValue to the node of every ancestor of the path in value,
+** and to the path's own node if bSelf, setting *piNode to the last of them.
+*/
+static int pathRollupAdd(path_rollup *p, sqlite3_value *value, int bSelf,
+                         sqlite3_int64 iValue, double rValue, int *piNode) {
+  path_parsed *parsed = &p->parsed;
+  const char *zPath;
+  int nPath, iNode, rc;
+
+  zPath = pathValue(value, &nPath);
+  if (zPath == NULL)
+    return SQLITE_NOMEM;
+  rc = pathTokenize(p->pStyle, zPath, nPath, parsed);
+  if (rc != SQLITE_OK)
+    return rc;
+  pathResolveSegments(parsed);
+
+  // the root, then every segment, but the last one only if bSelf
+  rc = pathRollupChild(p, -1, zPath, parsed->nRoot, &iNode);
+  for (int i = 0; rc == SQLITE_OK; i++) {
+    path_rollup_node *pNode = &p->aNode[iNode];
+    if (iValue > 0 ? pNode->iSum > LLONG_MAX - iValue
+                   : pNode->iSum < LLONG_MIN - iValue)
+      p->bOverflow = 1;
+    else
+      pNode->iSum += iValue;
+    pNode->rSum += rValue;
+    if (i >= parsed->nSegment - 1 + bSelf)
+      break;
+    rc = pathRollupChild(p, iNode, zPath + parsed->aBegin[i],
+                         parsed->aSize[i], &iNode);
+  }
+  *piNode = iNode;
+  return rc;
+}
+
+static void pathRollupStep(sqlite3_context *context, int argc,
+                           sqlite3_value **argv) {
+  path_rollup *p = pathRollupContext(context);
+  sqlite3_int64 iValue = 0;
+  int iNode, eType;
+  (void)argc;
+
+  if (p == NULL || p->rc != SQLITE_OK ||
+      sqlite3_value_type(argv[0]) == SQLITE_NULL ||
+      sqlite3_value_type(argv[1]) == SQLITE_NULL)
+    return;
+
+  // text values count as numbers, the same as in sum()
+  eType = sqlite3_value_numeric_type(argv[1]);
+  if (eType == SQLITE_INTEGER)
+    iValue = sqlite3_value_int64(argv[1]);
+  else
+    p->bReal = 1;
+  p->rc = pathRollupAdd(p, argv[0], 0, iValue, sqlite3_value_double(argv[1]),
+                        &iNode);
+}
+
+typedef struct path_rollup_order path_rollup_order;
+struct path_rollup_order {
+  int iParent;
+  int nName;
+  const char *zName;
+  int iNode;
+  sqlite3_int64 iSum;
+};
+
+// siblings next to each other, ordered by name
+static int pathRollupCompare(const void *pA, const void *pB) {
+  const path_rollup_order *a = (const path_rollup_order *)pA;
+  const path_rollup_order *b = (const path_rollup_order *)pB;
+  int c;
+  if (a->iParent != b->iParent)
+    return a->iParent < b->iParent ? -1 : 1;
+  c = memcmp(a->zName, b->zName, a->nName < b->nName ? a->nName : b->nName);
+  return c ? c : a->nName - b->nName;
+}
+
+// siblings with the most rows first, then by name
+static int pathTreeCompareCount(const void *pA, const void *pB) {
+  const path_rollup_order *a = (const path_rollup_order *)pA;
+  const path_rollup_order *b = (const path_rollup_order *)pB;
+  if (a->iParent == b->iParent && a->iSum != b->iSum)
+    return a->iSum > b->iSum ? -1 : 1;
+  return pathRollupCompare(pA, pB);
+}
+
+// siblings in the order their first row came in, which is the node order
+static int pathTreeCompareInput(const void *pA, const void *pB) {
+  const path_rollup_order *a = (const path_rollup_order *)pA;
+  const path_rollup_order *b = (const path_rollup_order *)pB;
+  if (a->iParent != b->iParent)
+    return a->iParent < b->iParent ? -1 : 1;
+  return a->iNode - b->iNode;
+}
+
+/*
+** Sort the nodes into *paOrder, siblings next to each other and ordered by
+** xCompare, and set *pnOrder to their number. (*paChild)[i + 1] is where the
+** children of node i start in it, and (*paChild)[i + 2] where they end, with
+** (*paChild)[0] and (*paChild)[1] for the roots. With bFlatten, the root of
+** relative paths is left out and its children are roots instead.
+*/
+static int pathRollupOrder(path_rollup *p,
+                           int (*xCompare)(const void *, const void *),
+                           int bFlatten, path_rollup_order **paOrder,
+                           int **paChild, int *pnOrder) {
+  path_rollup_order *aOrder;
+  int *aChild;
+  int nOrder = 0;
+
+  aOrder = sqlite3_malloc64(sizeof(*aOrder) * (p->nNode + 1));
+  aChild = sqlite3_malloc64(sizeof(*aChild) * (p->nNode + 2));
+  if (!aOrder || !aChild) {
+    sqlite3_free(aOrder);
+    sqlite3_free(aChild);
+    return SQLITE_NOMEM;
+  }
+  for (int i = 0; i < p->nNode; i++) {
+    const path_rollup_node *pNode = &p->aNode[i];
+    int iParent = pNode->iParent;
+    if (bFlatten && iParent < 0 && pNode->nName == 0)
+      continue;
+    if (bFlatten && iParent >= 0 && p->aNode[iParent].iParent < 0 &&
+        p->aNode[iParent].nName == 0)
+      iParent = -1;
+    aOrder[nOrder].iParent = iParent;
+    aOrder[nOrder].nName = pNode->nName;
+    aOrder[nOrder].zName = p->names.z + pNode->iName;
+    aOrder[nOrder].iNode = i;
+    aOrder[nOrder].iSum = pNode->iSum;
+    nOrder++;
+  }
+  qsort(aOrder, nOrder, sizeof(*aOrder), xCompare);
+  for (int i = 0, j = 0; i <= p->nNode + 1; i++) {
+    while (j < nOrder && aOrder[j].iParent < i - 1)
+      j++;
+    aChild[i] = j;
+  }
+  *paOrder = aOrder;
+  *paChild = aChild;
+  *pnOrder = nOrder;
+  return SQLITE_OK;
+}
+
+/*
+** Write every node but the root of relative paths as "path": total, depth
+** first.
+*/
+static void pathRollupJson(path_rollup *p, path_json *pJson) {
+  path_rollup_order *aOrder = NULL;
+  int *aChild = NULL;
+  // nodes from a root down to the current one, the next sibling to visit at
+  // each depth, and where each one's name starts in path
+  int *aStack;
+  int *aBegin;
+  path_buffer path = {0, 0};
+  int nOrder = 0;
+  int nStack = 0;
+
+  pathJsonAppend(pJson, "{", 1);
+  aStack = sqlite3_malloc64(sizeof(*aStack) * (p->nNode + 1));
+  aBegin = sqlite3_malloc64(sizeof(*aBegin) * (p->nNode + 1));
+  if (!aStack || !aBegin) {
+    pJson->rc = SQLITE_NOMEM;
+    goto done;
+  }
+  pJson->rc = pathRollupOrder(p, pathRollupCompare, 0, &aOrder, &aChild,
+                              &nOrder);
+  if (pJson->rc != SQLITE_OK)
+    goto done;
+
+  // aStack[d] is the position in aOrder of the node at depth d
+  aStack[nStack] = aChild[0];
+  while (nStack >= 0 && pJson->rc == SQLITE_OK) {
+    int iPos = aStack[nStack];
+    int iParent = nStack > 0 ? aOrder[aStack[nStack - 1]].iNode : -1;
+    const path_rollup_node *pNode;
+    int iBegin;
+    if (iPos >= nOrder || aOrder[iPos].iParent != iParent) {
+      // no more siblings, back to the parent's next one
+      if (--nStack >= 0)
+        aStack[nStack]++;
+      continue;
+    }
+    pNode = &p->aNode[aOrder[iPos].iNode];
+    iBegin = nStack > 0 ? aBegin[nStack - 1] + p->aNode[iParent].nName : 0;
+    pJson->rc = pathBufferReserve(&path, (sqlite3_int64)iBegin +
+                                             pNode->nName + 1);
+    if (pJson->rc != SQLITE_OK)
+      break;
+    // segments are separated, roots like "/" already end with a separator
+    if (iBegin > 0 && !pathIsSeparator(p->pStyle->eStyle, path.z[iBegin - 1]))
+      path.z[iBegin++] = p->pStyle->cSeparator;
+    if (pNode->nName > 0)
+      memcpy(path.z + iBegin, p->names.z + pNode->iName, pNode->nName);
+    aBegin[nStack] = iBegin;
+    if (nStack > 0 || pNode->nName > 0) {
+      if (pJson->n > 1)
+        pathJsonAppend(pJson, ",", 1);
+      pathJsonString(pJson, path.z, iBegin + pNode->nName);
+      pathJsonAppend(pJson, ":", 1);
+      if (p->bReal)
+        pathJsonReal(pJson, pNode->rSum);
+      else
+        pathJsonInt(pJson, pNode->iSum);
+    }
+    // then its children
+    nStack++;
+    aStack[nStack] = aChild[aOrder[iPos].iNode + 1];
+  }
+  pathJsonAppend(pJson, "}", 1);
+
+done:
+  sqlite3_free(aOrder);
+  sqlite3_free(aChild);
+  sqlite3_free(aStack);
+  sqlite3_free(aBegin);
+  pathBufferFree(&path);
+}
+
+static void pathRollupFinal(sqlite3_context *context) {
+  path_rollup *p = sqlite3_aggregate_context(context, 0);
+  path_json json = {{0, 0}, 0, SQLITE_OK};
+  if (p == NULL || !p->bInit) {
+    pathJsonAppend(&json, "{}", 2);
+    pathJsonResult(context, &json);
+    return;
+  }
+  if (p->rc != SQLITE_OK)
+    sqlite3_result_error_code(context, p->rc);
+  else if (p->bOverflow && !p->bReal)
+    sqlite3_result_error(context, "integer overflow", -1);
+  else {
+    pathRollupJson(p, &json);
+    pathJsonResult(context, &json);
+  }
+  pathRollupFree(p);
+}
+
+/** path_tree(path, [payload], [order], [max_children])
+ * Aggregate that builds the directory tree of every path in one pass, as
+ * nested JSON a tree view can render as is:
+ * `{"count":2,"children":[{"name":"/","count":2,"children":[...]}]}`. Each
+ * node has its name and the number of rows at or under it, and "children"
+ * when it has any. The node of a row's own path gets the row's payload,
+ * the first one given for that path. JSON payloads, like the result of
+ * json_object(), are nested as they are. Rows with a NULL path are skipped,
+ * and the top level of relative paths is their first segment.
+ *
+ * Children are sorted by order: 'name' (the default), 'count' for the most
+ * rows first, or 'input' for the order of their first rows. Only the first
+ * max_children of them are written, with "truncated" for how many were left
+ * out, and 0 (the default) writes all of them. Both are read from the first
+ * row.
+ *
+ * The tree is path_rollup's trie, counting rows instead of summing values,
+ * so it's only walked once, in xFinal.
+ */
+
+static const struct {
+  const char *zName;
+  int (*xCompare)(const void *, const void *);
+} pathTreeOrders[] = {
+    {"name", pathRollupCompare},
+    {"count", pathTreeCompareCount},
+    {"input", pathTreeCompareInput},
+};
+
+#define PATH_TREE_ORDER_COUNT                                                  \
+  (int)(sizeof(pathTreeOrders) / sizeof(pathTreeOrders[0]))
+
+/*
+** Read path_tree's order and max_children arguments into p, or set the
+** aggregate's error.
+*/
+static int pathTreeArgs(sqlite3_context *context, path_rollup *p, int argc,
+                        sqlite3_value **argv) {
+  if (argc > 2 && sqlite3_value_type(argv[2]) != SQLITE_NULL) {
+    const char *zOrder = (const char *)sqlite3_value_text(argv[2]);
+    int i = 0;
+    while (i < PATH_TREE_ORDER_COUNT &&
+           (zOrder == NULL ||
+            sqlite3_stricmp(zOrder, pathTreeOrders[i].zName) != 0))
+      i++;
+    if (i == PATH_TREE_ORDER_COUNT) {
+      sqlite3_result_error(
+          context, "path_tree order must be 'name', 'count' or 'input'", -1);
+      return SQLITE_ERROR;
+    }
+    p->iTreeOrder = i;
+  }
+  if (argc > 3 && sqlite3_value_type(argv[3]) != SQLITE_NULL) {
+    sqlite3_int64 n = sqlite3_value_int64(argv[3]);
+    if (sqlite3_value_numeric_type(argv[3]) != SQLITE_INTEGER || n < 0 ||
+        n > INT_MAX) {
+      sqlite3_result_error(
+          context, "path_tree max_children must be 0 or a positive integer",
+          -1);
+      return SQLITE_ERROR;
+    }
+    p->nTreeMaxChildren = (int)n;
+  }
+  return SQLITE_OK;
+}
+
+static void pathTreeStep(sqlite3_context *context, int argc,
+                         sqlite3_value **argv) {
+  path_rollup *p = pathRollupContext(context);
+  path_rollup_node *pNode;
+  path_json *pPayloads;
+  sqlite3_int64 iStart;
+  int iNode;
+
+  if (argc < 1 || argc > 4) {
+    sqlite3_result_error(context,
+                         "path_tree takes a path, and optionally a payload, "
+                         "an order and max_children",
+                         -1);
+    return;
+  }
+  if (p == NULL || p->rc != SQLITE_OK)
+    return;
+  if (!p->bTreeArgs) {
+    p->bTreeArgs = 1;
+    p->rc = pathTreeArgs(context, p, argc, argv);
+    if (p->rc != SQLITE_OK)
+      return;
+  }
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    return;
+  p->rc = pathRollupAdd(p, argv[0], 1, 1, 1.0, &iNode);
+  if (p->rc != SQLITE_OK || argc < 2 || p->aNode[iNode].nPayload > 0)
+    return;
+
+  pPayloads = &p->payloads;
+  iStart = pPayloads->n;
+  switch (sqlite3_value_type(argv[1])) {
+  case SQLITE_NULL:
+    return;
+  case SQLITE_INTEGER:
+    pathJsonInt(pPayloads, sqlite3_value_int64(argv[1]));
+    break;
+  case SQLITE_FLOAT:
+    pathJsonReal(pPayloads, sqlite3_value_double(argv[1]));
+    break;
+  case SQLITE_BLOB:
+    sqlite3_result_error(context, "JSON cannot hold BLOB values", -1);
+    return;
+  default: {
+    const char *z = (const char *)sqlite3_value_text(argv[1]);
+    int n = sqlite3_value_bytes(argv[1]);
+    if (z == NULL) {
+      p->rc = SQLITE_NOMEM;
+      return;
+    }
+    if (sqlite3_value_subtype(argv[1]) == PATH_JSON_SUBTYPE)
+      pathJsonAppend(pPayloads, z, n);
+    else
+      pathJsonString(pPayloads, z, n);
+  }
+  }
+  p->rc = pPayloads->rc;
+  if (p->rc == SQLITE_OK && pPayloads->n - iStart > INT_MAX)
+    p->rc = SQLITE_TOOBIG;
+  pNode = &p->aNode[iNode];
+  pNode->iPayload = iStart;
+  pNode->nPayload = (int)(pPayloads->n - iStart);
+}
+
+/*
+** Write the tree as nested objects, from a top level one holding the roots.
+*/
+static void pathTreeJson(path_rollup *p, path_json *pJson) {
+  path_rollup_order *aOrder = NULL;
+  int *aChild = NULL;
+  // aStack[d] is the position in aOrder of the node at depth d, below the
+  // top level object at depth 0, and aCount[d] how many of its siblings
+  // were written before it
+  int *aStack;
+  int *aCount;
+  int nOrder = 0;
+  int nStack = 0;
+  sqlite3_int64 nRows = 0;
 
-/** path_relative(path)
- * Returns 1 if the given path is relative, 0 if not, or null if path is null.
+  aStack = sqlite3_malloc64(sizeof(*aStack) * (p->nNode + 2));
+  aCount = sqlite3_malloc64(sizeof(*aCount) * (p->nNode + 2));
+  if (!aStack || !aCount) {
+    pJson->rc = SQLITE_NOMEM;
+    goto done;
+  }
+  pJson->rc = pathRollupOrder(p, pathTreeOrders[p->iTreeOrder].xCompare, 1,
+                              &aOrder, &aChild, &nOrder);
+  if (pJson->rc != SQLITE_OK)
+    goto done;
 
- */
-static void pathRelativeFunc(sqlite3_context *context, int argc,
-                             sqlite3_value **argv) {
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
-    return;
+  // every row is counted in exactly one root
+  for (int i = 0; i < p->nNode; i++)
+    if (p->aNode[i].iParent < 0)
+      nRows += p->aNode[i].iSum;
+  pathJsonAppend(pJson, "{\"count\":", 9);
+  pathJsonInt(pJson, nRows);
+  aStack[0] = aChild[0];
+  aCount[0] = 0;
+  while (nStack >= 0 && pJson->rc == SQLITE_OK) {
+    int iPos = aStack[nStack];
+    int iParent = nStack > 0 ? aOrder[aStack[nStack - 1]].iNode : -1;
+    int iEnd = aChild[iParent + 2];
+    const path_rollup_node *pNode;
+    if (iPos < iEnd && (p->nTreeMaxChildren == 0 ||
+                        aCount[nStack] < p->nTreeMaxChildren)) {
+      pNode = &p->aNode[aOrder[iPos].iNode];
+      if (aCount[nStack] == 0)
+        pathJsonAppend(pJson, ",\"children\":[", 13);
+      else
+        pathJsonAppend(pJson, ",", 1);
+      pathJsonAppend(pJson, "{\"name\":", 8);
+      pathJsonString(pJson, p->names.z + pNode->iName, pNode->nName);
+      pathJsonAppend(pJson, ",\"count\":", 9);
+      pathJsonInt(pJson, pNode->iSum);
+      if (pNode->nPayload > 0) {
+        pathJsonAppend(pJson, ",\"payload\":", 11);
+        pathJsonAppend(pJson, p->payloads.buf.z + pNode->iPayload,
+                       pNode->nPayload);
+      }
+      // then its children
+      nStack++;
+      aStack[nStack] = aChild[aOrder[iPos].iNode + 1];
+      aCount[nStack] = 0;
+      continue;
+    }
+    // no more children to write, close the node and back to its next sibling
+    if (aCount[nStack] > 0)
+      pathJsonAppend(pJson, "]", 1);
+    if (iPos < iEnd) {
+      pathJsonAppend(pJson, ",\"truncated\":", 13);
+      pathJsonInt(pJson, iEnd - iPos);
+    }
+    pathJsonAppend(pJson, "}", 1);
+    if (--nStack >= 0) {
+      aStack[nStack]++;
+      aCount[nStack]++;
+    }
   }
 
-  sqlite3_result_int(
-      context, cwk_path_is_relative((const char *)sqlite3_value_text(argv[0])));
+done:
+  sqlite3_free(aOrder);
+  sqlite3_free(aChild);
+  sqlite3_free(aStack);
+  sqlite3_free(aCount);
 }
 
-/** path_root(path)
- * Returns the root portion of the given path, or null if it cannot be computed.
- *
- */
-static void pathRootFunc(sqlite3_context *context, int argc,
-                         sqlite3_value **argv) {
-  const char *path = (const char *)sqlite3_value_text(argv[0]);
-  size_t length;
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
+static void pathTreeFinal(sqlite3_context *context) {
+  path_rollup *p = sqlite3_aggregate_context(context, 0);
+  path_json json = {{0, 0}, 0, SQLITE_OK};
+  if (p == NULL || !p->bInit) {
+    pathJsonAppend(&json, "{\"count\":0}", 11);
+    pathJsonResult(context, &json);
     return;
   }
-  cwk_path_get_root(path, &length);
-  sqlite3_result_text(context, path, length, SQLITE_TRANSIENT);
+  if (p->rc != SQLITE_OK)
+    sqlite3_result_error_code(context, p->rc);
+  else {
+    pathTreeJson(p, &json);
+    pathJsonResult(context, &json);
+  }
+  pathRollupFree(p);
 }
 
-/** path_part_at(path, at)
- ** path_at(path, at)
- * Returns the path segment in the given path at the specified index.
- * If 'at' is positive, then '0' is the first segment and counts to the end.
- * If 'at' is negative, then '-1' is the last segment and continue to the
- * beginning. If 'at' "overflows" in either direction, then returns NULL.
+/** path_common_prefix(path)
+ * Aggregate and window function that returns the longest directory every
+ * path has in common, like path_intersection() over the whole group:
+ * `path_common_prefix` of /srv/a/x and /srv/a/b/y is /srv/a. The result is
+ * a prefix of the latest path, as given. NULL paths are skipped, and the
+ * result is NULL when the paths share nothing, not even their root.
  *
+ * The common prefix of a sequence of paths is the shortest common prefix of
+ * two adjacent ones. So only the latest path is kept, with a sliding minimum
+ * of how many segments each adjacent pair shares. Rows leave a window frame
+ * oldest first, which is all xInverse needs. The queue only holds increasing
+ * segment counts, so it stays as short as the deepest path, however many
+ * rows the group has.
  */
-static void pathPartAtFunc(sqlite3_context *context, int argc,
-                           sqlite3_value **argv) {
-  const char *path = (const char *)sqlite3_value_text(argv[0]);
-  int at = sqlite3_value_int(argv[1]);
-  struct cwk_segment segment;
 
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
-    return;
+typedef struct path_common_prefix path_common_prefix;
+struct path_common_prefix {
+  // the aggregate context starts out zeroed, so this says it's set up
+  int bInit;
+  int rc;
+  const path_style *pStyle;
+  // non-NULL paths in the group, or the window frame
+  sqlite3_int64 nRows;
+  // the latest path, and the one before it, which is parsed into the other
+  // slot while they're compared
+  struct path_common_prefix_row {
+    path_buffer bytes;
+    int nPath;
+    int eType;
+    path_parsed parsed;
+  } aRow[2];
+  int iLatest;
+  // adjacent pairs pushed so far, and removed from the frame so far
+  sqlite3_int64 nPairs;
+  sqlite3_int64 nRemoved;
+  // the sliding minimum: pairs from oldest to newest, with increasing
+  // nCommon, each the smallest until a newer pair leaves the frame
+  struct path_common_prefix_pair {
+    int nCommon;
+    sqlite3_int64 iPair;
+  } *aQueue;
+  int iHead;
+  int nQueue;
+  int nQueueAlloc;
+};
+
+static path_common_prefix *pathCommonPrefixContext(sqlite3_context *context) {
+  path_common_prefix *p = sqlite3_aggregate_context(context, sizeof(*p));
+  if (p == NULL) {
+    sqlite3_result_error_nomem(context);
+    return NULL;
   }
+  if (!p->bInit) {
+    p->bInit = 1;
+    p->pStyle = (const path_style *)sqlite3_user_data(context);
+    pathParsedInit(&p->aRow[0].parsed);
+    pathParsedInit(&p->aRow[1].parsed);
+  }
+  return p;
+}
 
-  // TODO both: if first/last returns false
-  if (at >= 0) {
-    int overflow = 0;
-    cwk_path_get_first_segment(path, &segment);
-    for (int i = 0; i < at; i++) {
-      if (!cwk_path_get_next_segment(&segment)) {
-        overflow = 1;
-        break;
-      }
-    }
-    if (overflow) {
-      sqlite3_result_null(context);
+static int pathCommonPrefixPush(path_common_prefix *p, int nCommon) {
+  // newer pairs that share as little leave later, so larger ones never count
+  while (p->nQueue > 0 &&
+         p->aQueue[p->iHead + p->nQueue - 1].nCommon >= nCommon)
+    p->nQueue--;
+  if (p->iHead + p->nQueue == p->nQueueAlloc) {
+    if (p->iHead > 0) {
+      memmove(p->aQueue, p->aQueue + p->iHead, sizeof(*p->aQueue) * p->nQueue);
+      p->iHead = 0;
     } else {
-      sqlite3_result_text(context, segment.begin, segment.size,
-                          SQLITE_TRANSIENT);
+      int nAlloc = p->nQueueAlloc ? p->nQueueAlloc * 2 : 16;
+      struct path_common_prefix_pair *aQueue =
+          sqlite3_realloc64(p->aQueue, sizeof(*aQueue) * nAlloc);
+      if (aQueue == NULL)
+        return SQLITE_NOMEM;
+      p->aQueue = aQueue;
+      p->nQueueAlloc = nAlloc;
     }
+  }
+  p->aQueue[p->iHead + p->nQueue].nCommon = nCommon;
+  p->aQueue[p->iHead + p->nQueue].iPair = p->nPairs++;
+  p->nQueue++;
+  return SQLITE_OK;
+}
+
+static void pathCommonPrefixStep(sqlite3_context *context, int argc,
+                                 sqlite3_value **argv) {
+  path_common_prefix *p = pathCommonPrefixContext(context);
+  struct path_common_prefix_row *pRow;
+  const char *zPath;
+  int nPath;
+  (void)argc;
+
+  if (p == NULL || p->rc != SQLITE_OK ||
+      sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    return;
+  zPath = pathValue(argv[0], &nPath);
+  if (zPath == NULL) {
+    p->rc = SQLITE_NOMEM;
     return;
   }
-  int overflow = 0;
-  cwk_path_get_last_segment(path, &segment);
-  for (int i = -1; i > at; i--) {
-    if (!cwk_path_get_previous_segment(&segment)) {
-      overflow = 1;
-      break;
-    }
+  // the other slot, its buffers are only reallocated for longer paths
+  pRow = &p->aRow[1 - p->iLatest];
+  p->rc = pathBufferReserve(&pRow->bytes, (sqlite3_int64)nPath + 1);
+  if (p->rc != SQLITE_OK)
+    return;
+  if (nPath > 0)
+    memcpy(pRow->bytes.z, zPath, nPath);
+  pRow->nPath = nPath;
+  pRow->eType = sqlite3_value_type(argv[0]);
+  p->rc = pathTokenize(p->pStyle, pRow->bytes.z, nPath, &pRow->parsed);
+  if (p->rc != SQLITE_OK)
+    return;
+  pathResolveSegments(&pRow->parsed);
+
+  if (p->nRows > 0) {
+    const struct path_common_prefix_row *pLatest = &p->aRow[p->iLatest];
+    p->rc = pathCommonPrefixPush(
+        p, pathCommonSegments(p->pStyle, pLatest->bytes.z, &pLatest->parsed,
+                              pRow->bytes.z, &pRow->parsed));
+    if (p->rc != SQLITE_OK)
+      return;
   }
-  if (overflow) {
-    sqlite3_result_null(context);
-  } else {
-    sqlite3_result_text(context, segment.begin, segment.size, SQLITE_TRANSIENT);
+  p->iLatest = 1 - p->iLatest;
+  p->nRows++;
+}
+
+static void pathCommonPrefixInverse(sqlite3_context *context, int argc,
+                                    sqlite3_value **argv) {
+  path_common_prefix *p = pathCommonPrefixContext(context);
+  (void)argc;
+  if (p == NULL || p->rc != SQLITE_OK ||
+      sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    return;
+  if (--p->nRows == 0) {
+    p->nPairs = p->nRemoved = 0;
+    p->iHead = p->nQueue = 0;
+    return;
+  }
+  // the oldest row takes the pair it's the first of with it
+  if (p->nQueue > 0 && p->aQueue[p->iHead].iPair == p->nRemoved) {
+    p->iHead++;
+    p->nQueue--;
   }
+  p->nRemoved++;
 }
 
-/** path_length(path)
- * Returns the number of segments in the given path.
- *
- */
-static void pathLengthFunc(sqlite3_context *context, int argc,
-                           sqlite3_value **argv) {
-  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
-    sqlite3_result_null(context);
+static void pathCommonPrefixValue(sqlite3_context *context) {
+  path_common_prefix *p = pathCommonPrefixContext(context);
+  const struct path_common_prefix_row *pLatest;
+  int nSegment, nCommon;
+  if (p == NULL)
+    return;
+  if (p->rc != SQLITE_OK) {
+    sqlite3_result_error_code(context, p->rc);
+    return;
+  }
+  if (p->nRows == 0) {
+    pathResultNull(context);
     return;
   }
-  const char *path = (const char *)sqlite3_value_text(argv[0]);
-  int c = 0;
-  
-  struct cwk_segment segment;
+  pLatest = &p->aRow[p->iLatest];
+  nSegment = p->nQueue > 0 ? p->aQueue[p->iHead].nCommon
+                           : pLatest->parsed.nSegment;
+  if (nSegment < 0)
+    nCommon = 0;
+  else if (nSegment == 0)
+    nCommon = pLatest->parsed.nRoot;
+  else
+    nCommon = pLatest->parsed.aBegin[nSegment - 1] +
+              pLatest->parsed.aSize[nSegment - 1];
+  if (nCommon == 0) {
+    pathResultNull(context);
+    return;
+  }
+  pathResult(context, pLatest->eType, pLatest->bytes.z, nCommon,
+             SQLITE_TRANSIENT);
+}
 
-  if(!cwk_path_get_first_segment(path, &segment)) {
-    sqlite3_result_int(context, c);
+static void pathCommonPrefixFinal(sqlite3_context *context) {
+  path_common_prefix *p = sqlite3_aggregate_context(context, 0);
+  if (p == NULL || !p->bInit) {
+    pathResultNull(context);
     return;
   }
-  
-  do {
-    c++;
-  } while(cwk_path_get_next_segment(&segment));
-  
-  sqlite3_result_int(context, c);
-  return;
+  pathCommonPrefixValue(context);
+  for (int i = 0; i < 2; i++) {
+    pathBufferFree(&p->aRow[i].bytes);
+    pathParsedFree(&p->aRow[i].parsed);
+  }
+  sqlite3_free(p->aQueue);
 }
+
 #pragma endregion
 
-#pragma region sqlite - path table functions
-/** select * from path_parts(path)
- * Table function that returns each segment for the given path.
- * Return a table with the following schema:
+#pragma region sqlite - path function registry
+
+/*
+** Every scalar function sqlite3_path_init() registers. Functions that take
+** paths are registered once per style, with the style's prefix in front of
+** their name, ex path_basename and path_win_basename. A function's index in
+** this table is its counter slot in path_stats.
+*/
+static const struct {
+  const char *zName;
+  int nArg;
+  void (*xFunc)(sqlite3_context *, int, sqlite3_value **);
+  int bStyled;
+} pathFunctions[] = {
+    {"version", 0, pathVersionFunc, 0},
+    {"debug", 0, pathDebugFunc, 0},
+    {"join", -1, pathJoinFunc, 1},
+    {"dirname", 1, pathDirnameFunc, 1},
+    {"basename", 1, pathBasenameFunc, 1},
+    {"extension", 1, pathExtensionFunc, 1},
+    {"name", 1, pathNameFunc, 1},
+    {"part_at", 2, pathPartAtFunc, 1},
+    {"at", 2, pathPartAtFunc, 1},
+    {"length", 1, pathLengthFunc, 1},
+    {"absolute", 1, pathAbsoluteFunc, 1},
+    {"relative", 1, pathRelativeFunc, 1},
+    {"root", 1, pathRootFunc, 1},
+    {"normalize", 1, pathNormalizeFunc, 1},
+    {"intersection", 2, pathIntersectionFunc, 1},
+    {"sort_key", 1, pathSortKeyFunc, 1},
+    {"subtree_upper", 1, pathSubtreeUpperFunc, 1},
+    {"under", 2, pathUnderFunc, 1},
+};
+
+#define PATH_FUNCTION_COUNT                                                    \
+  (int)(sizeof(pathFunctions) / sizeof(pathFunctions[0]))
+
+// every function needs its own counter slot in path_stats
+typedef char path_functions_fit_stats[PATH_FUNCTION_COUNT <= PATH_MAX_FUNCTIONS
+                                          ? 1
+                                          : -1];
+
+/*
+** Every aggregate sqlite3_path_init() registers, prefixed like the scalar
+** functions. Their user data is the path style. xValue and xInverse are
+** only set for aggregates that are also window functions.
+*/
+static const struct {
+  const char *zName;
+  int nArg;
+  void (*xStep)(sqlite3_context *, int, sqlite3_value **);
+  void (*xFinal)(sqlite3_context *);
+  void (*xValue)(sqlite3_context *);
+  void (*xInverse)(sqlite3_context *, int, sqlite3_value **);
+  int iFlags;
+} pathAggregates[] = {
+    {"rollup", 2, pathRollupStep, pathRollupFinal, 0, 0, PATH_JSON_FLAGS},
+    {"tree", -1, pathTreeStep, pathTreeFinal, 0, 0,
+     PATH_JSON_FLAGS | PATH_JSON_ARG_FLAGS},
+    {"common_prefix", 1, pathCommonPrefixStep, pathCommonPrefixFinal,
+     pathCommonPrefixValue, pathCommonPrefixInverse, 0},
+};
+
+#pragma endregion
+
+#pragma region sqlite - path stats table
+
+/** select * from path_stats
+ * Table of the counters collected while stats are on, summed over every
+ * thread. One row per registered function, and per path_parts method.
  * ```sql
- * create table path_parts(
- *  type text,        --
- *  part text,       --x
- *  path text hidden  -- input path
+ * create table path_stats(
+ *  name text,          -- function name, ex 'path_basename'
+ *  calls int,          -- number of calls
+ *  bytes_in int,       -- bytes of TEXT and BLOB arguments
+ *  bytes_out int,      -- bytes of TEXT and BLOB results
+ *  nulls int,          -- number of NULL results
+ *  ns int,             -- nanoseconds spent in the function
+ *  cache_hits int,     -- parses served from the parse cache
+ *  cache_misses int    -- parses that tokenized the path
  * )
  * ```
- *
  */
 
-#define PATH_PARTS_COLUMN_ROWID -1
-#define PATH_PARTS_COLUMN_PATH 0
-#define PATH_PARTS_COLUMN_TYPE 1
-#define PATH_PARTS_COLUMN_SEGMENT 2
+#define PATH_STATS_SCHEMA                                                      \
+  "CREATE TABLE x(name text, calls int, bytes_in int, bytes_out int, "         \
+  "nulls int, ns int, cache_hits int, cache_misses int)"
 
-typedef struct path_parts_cursor path_parts_cursor;
-struct path_parts_cursor {
-  // Base class - must be first
+#define PATH_STATS_COLUMN_NAME 0
+#define PATH_STATS_COLUMN_CALLS 1
+#define PATH_STATS_COLUMN_BYTES_IN 2
+#define PATH_STATS_COLUMN_BYTES_OUT 3
+#define PATH_STATS_COLUMN_NULLS 4
+#define PATH_STATS_COLUMN_NS 5
+#define PATH_STATS_COLUMN_CACHE_HITS 6
+#define PATH_STATS_COLUMN_CACHE_MISSES 7
+
+typedef struct path_stats_cursor path_stats_cursor;
+struct path_stats_cursor {
   sqlite3_vtab_cursor base;
-  sqlite3_int64 iRowid;
-  // pointer to current segment
-  struct cwk_segment *segment;
-  // whether or not there's a next segment to yield
-  bool next;
+  // current slot, which is also the rowid
+  int iSlot;
+  path_stats_counters total;
+  char zName[64];
 };
 
 /*
-** The pathPartsReadConnect() method is invoked to create a new
-** pathParts_vtab that describes the pathParts_read virtual table.
-**
-** Think of this routine as the constructor for pathParts_vtab objects.
-**
-** All this routine needs to do is:
-**
-**    (1) Allocate the pathParts_vtab object and initialize all fields.
-**
-**    (2) Tell SQLite (via the sqlite3_declare_vtab() interface) what the
-**        result set of queries against pathParts_read will look like.
+** Name of a counter slot, or 0 if no function uses it.
 */
-static int pathPartsConnect(sqlite3 *db, void *pUnused, int argcUnused,
-                            const char *const *argvUnused,
-                            sqlite3_vtab **ppVtab, char **pzErrUnused) {
-  sqlite3_vtab *pNew;
-  int rc;
-  (void)pUnused;
-  (void)argcUnused;
-  (void)argvUnused;
-  (void)pzErrUnused;
-  rc = sqlite3_declare_vtab(
-      db, "CREATE TABLE x(path hidden, type text, part text)");
-  if (rc == SQLITE_OK) {
-    pNew = *ppVtab = sqlite3_malloc(sizeof(*pNew));
-    if (pNew == 0)
-      return SQLITE_NOMEM;
-    memset(pNew, 0, sizeof(*pNew));
-    sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+static int pathStatsName(int iSlot, char *zName, int nName) {
+  static const path_style *aStyle[] = {&pathStyleUnix, &pathStyleWindows};
+  if (iSlot < PATH_STATS_PARTS_FILTER) {
+    int iFunc = iSlot % PATH_MAX_FUNCTIONS;
+    int eStyle = iSlot / PATH_MAX_FUNCTIONS;
+    if (iFunc >= PATH_FUNCTION_COUNT ||
+        (eStyle > 0 && !pathFunctions[iFunc].bStyled))
+      return 0;
+    sqlite3_snprintf(nName, zName, "%s%s", aStyle[eStyle]->zPrefix,
+                     pathFunctions[iFunc].zName);
+  } else {
+    int eStyle = (iSlot - PATH_STATS_PARTS_FILTER) % 2;
+    sqlite3_snprintf(nName, zName, "%sparts.%s", aStyle[eStyle]->zPrefix,
+                     iSlot < PATH_STATS_PARTS_NEXT ? "xFilter" : "xNext");
   }
-  return rc;
+  return 1;
 }
 
 /*
-** This method is the destructor for path_parts_cursor objects.
+** Move the cursor to the first slot from iSlot on that has a name.
 */
-static int pathPartsDisconnect(sqlite3_vtab *pVtab) {
-  sqlite3_free(pVtab);
-  return SQLITE_OK;
+static void pathStatsSeek(path_stats_cursor *pCur, int iSlot) {
+  while (iSlot < PATH_STATS_SLOTS &&
+         !pathStatsName(iSlot, pCur->zName, sizeof(pCur->zName)))
+    iSlot++;
+  pCur->iSlot = iSlot;
+  if (iSlot < PATH_STATS_SLOTS)
+    pathStatsSum(iSlot, &pCur->total);
 }
 
-/*
-** Constructor for a new path_parts_cursor object.
-*/
-static int pathPartsOpen(sqlite3_vtab *pUnused,
+static int pathStatsOpen(sqlite3_vtab *pUnused,
                          sqlite3_vtab_cursor **ppCursor) {
-  path_parts_cursor *pCur;
+  path_stats_cursor *pCur;
   (void)pUnused;
   pCur = sqlite3_malloc(sizeof(*pCur));
   if (pCur == 0)
@@ -441,155 +6581,91 @@ static int pathPartsOpen(sqlite3_vtab *pUnused,
   return SQLITE_OK;
 }
 
-/*
-** Destructor for a path_parts_cursor.
-*/
-static int pathPartsClose(sqlite3_vtab_cursor *cur) {
+static int pathStatsClose(sqlite3_vtab_cursor *cur) {
   sqlite3_free(cur);
   return SQLITE_OK;
 }
 
-/*
-** Advance a path_parts_cursor to its next row of output.
-*/
-static int pathPartsNext(sqlite3_vtab_cursor *cur) {
-  path_parts_cursor *pCur = (path_parts_cursor *)cur;
-  pCur->next = cwk_path_get_next_segment(pCur->segment);
-  pCur->iRowid++;
+static int pathStatsNext(sqlite3_vtab_cursor *cur) {
+  path_stats_cursor *pCur = (path_stats_cursor *)cur;
+  pathStatsSeek(pCur, pCur->iSlot + 1);
   return SQLITE_OK;
 }
 
-/*
-** Return TRUE if the cursor has been moved off of the last
-** row of output.
-*/
-static int pathPartsEof(sqlite3_vtab_cursor *cur) {
-  path_parts_cursor *pCur = (path_parts_cursor *)cur;
-  return !pCur->next;
+static int pathStatsEof(sqlite3_vtab_cursor *cur) {
+  return ((path_stats_cursor *)cur)->iSlot >= PATH_STATS_SLOTS;
 }
 
-/*
-** Return values of columns for the row at which the path_parts_cursor
-** is currently pointing.
-*/
-static int pathPartsColumn(
-    sqlite3_vtab_cursor *cur, /* The cursor */
-    sqlite3_context *ctx,     /* First argument to sqlite3_result_...() */
-    int i                     /* Which column to return */
-) {
-  path_parts_cursor *pCur = (path_parts_cursor *)cur;
-  sqlite3_int64 x = 0;
+static int pathStatsColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx,
+                           int i) {
+  path_stats_cursor *pCur = (path_stats_cursor *)cur;
   switch (i) {
-  case PATH_PARTS_COLUMN_PATH: {
-    sqlite3_result_null(ctx);
+  case PATH_STATS_COLUMN_NAME:
+    sqlite3_result_text(ctx, pCur->zName, -1, SQLITE_TRANSIENT);
     break;
-  }
-  case PATH_PARTS_COLUMN_TYPE: {
-    switch (cwk_path_get_segment_type(pCur->segment)) {
-    case CWK_NORMAL:
-      sqlite3_result_text(ctx, "normal", -1, SQLITE_STATIC);
-      break;
-    case CWK_CURRENT:
-      sqlite3_result_text(ctx, "current", -1, SQLITE_STATIC);
-      break;
-    case CWK_BACK:
-      sqlite3_result_text(ctx, "back", -1, SQLITE_STATIC);
-      break;
-    }
+  case PATH_STATS_COLUMN_CALLS:
+    sqlite3_result_int64(ctx, pCur->total.nCall);
     break;
-  }
-  case PATH_PARTS_COLUMN_SEGMENT: {
-    sqlite3_result_text(ctx, pCur->segment->begin, pCur->segment->size,
-                        SQLITE_TRANSIENT);
+  case PATH_STATS_COLUMN_BYTES_IN:
+    sqlite3_result_int64(ctx, pCur->total.nBytesIn);
+    break;
+  case PATH_STATS_COLUMN_BYTES_OUT:
+    sqlite3_result_int64(ctx, pCur->total.nBytesOut);
+    break;
+  case PATH_STATS_COLUMN_NULLS:
+    sqlite3_result_int64(ctx, pCur->total.nNull);
+    break;
+  case PATH_STATS_COLUMN_NS:
+    sqlite3_result_int64(ctx, pCur->total.nNs);
+    break;
+  case PATH_STATS_COLUMN_CACHE_HITS:
+    sqlite3_result_int64(ctx, pCur->total.nCacheHit);
+    break;
+  case PATH_STATS_COLUMN_CACHE_MISSES:
+    sqlite3_result_int64(ctx, pCur->total.nCacheMiss);
     break;
-  }
   }
   return SQLITE_OK;
 }
 
-/*
-** Return the rowid for the current row. In this implementation, the
-** first row returned is assigned rowid value 1, and each subsequent
-** row a value 1 more than that of the previous.
-*/
-static int pathPartsRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
-  path_parts_cursor *pCur = (path_parts_cursor *)cur;
-  *pRowid = pCur->iRowid;
+static int pathStatsRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+  *pRowid = ((path_stats_cursor *)cur)->iSlot;
   return SQLITE_OK;
 }
 
-/*
-** SQLite will invoke this method one or more times while planning a query
-** that uses the pathParts_read virtual table.  This routine needs to create
-** a query plan for each invocation and compute an estimated cost for that
-** plan.
-*/
-
-static int pathPartsBestIndex(sqlite3_vtab *pVTab,
+static int pathStatsBestIndex(sqlite3_vtab *pUnused,
                               sqlite3_index_info *pIdxInfo) {
-  int hasPath = 0;
-
-  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
-    const struct sqlite3_index_constraint *pCons = &pIdxInfo->aConstraint[i];
-    switch (pCons->iColumn) {
-    case PATH_PARTS_COLUMN_PATH: {
-      if (!hasPath && !pCons->usable || pCons->op != SQLITE_INDEX_CONSTRAINT_EQ)
-        return SQLITE_CONSTRAINT;
-      hasPath = 1;
-      pIdxInfo->aConstraintUsage[i].argvIndex = 1;
-      pIdxInfo->aConstraintUsage[i].omit = 1;
-      break;
-    }
-    }
-  }
-  if (!hasPath) {
-    pVTab->zErrMsg = sqlite3_mprintf("path argument is required");
-    return SQLITE_ERROR;
-  }
-  pIdxInfo->idxNum = 1;
-  pIdxInfo->estimatedCost = (double)100000;
-  pIdxInfo->estimatedRows = 100000;
-
+  (void)pUnused;
+  pIdxInfo->estimatedCost = (double)PATH_STATS_SLOTS;
+  pIdxInfo->estimatedRows = PATH_STATS_SLOTS;
   return SQLITE_OK;
 }
 
-/*
-** This method is called to "rewind" the path_parts_cursor object back
-** to the first row of output.  This method is always called at least
-** once prior to any call to xColumn() or xRowid() or xEof().
-**
-** This routine should initialize the cursor and position it so that it
-** is pointing at the first row, or pointing off the end of the table
-** (so that xEof() will return true) if the table is empty.
-*/
-static int pathPartsFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
-                           const char *idxStr, int argc, sqlite3_value **argv) {
-  path_parts_cursor *pCur = (path_parts_cursor *)pVtabCursor;
-  struct cwk_segment *segment;
-  pCur->segment = sqlite3_malloc(sizeof(*segment));
-  if (pCur->segment == NULL)
-    return SQLITE_NOMEM;
-  memset(pCur->segment, 0, sizeof(*pCur->segment));
-
-  pCur->next = cwk_path_get_first_segment(
-      (const char *)sqlite3_value_text(argv[0]), pCur->segment);
+static int pathStatsFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                           const char *idxStr, int argc,
+                           sqlite3_value **argv) {
+  (void)idxNum;
+  (void)idxStr;
+  (void)argc;
+  (void)argv;
+  pathStatsSeek((path_stats_cursor *)pVtabCursor, 0);
   return SQLITE_OK;
 }
 
-static sqlite3_module pathPartsModule = {
+static sqlite3_module pathStatsModule = {
     0,                   /* iVersion */
     0,                   /* xCreate */
     pathPartsConnect,    /* xConnect */
-    pathPartsBestIndex,  /* xBestIndex */
+    pathStatsBestIndex,  /* xBestIndex */
     pathPartsDisconnect, /* xDisconnect */
     0,                   /* xDestroy */
-    pathPartsOpen,       /* xOpen - open a cursor */
-    pathPartsClose,      /* xClose - close a cursor */
-    pathPartsFilter,     /* xFilter - configure scan constraints */
-    pathPartsNext,       /* xNext - advance a cursor */
-    pathPartsEof,        /* xEof - check for end of scan */
-    pathPartsColumn,     /* xColumn - read data */
-    pathPartsRowid,      /* xRowid - read data */
+    pathStatsOpen,       /* xOpen - open a cursor */
+    pathStatsClose,      /* xClose - close a cursor */
+    pathStatsFilter,     /* xFilter - configure scan constraints */
+    pathStatsNext,       /* xNext - advance a cursor */
+    pathStatsEof,        /* xEof - check for end of scan */
+    pathStatsColumn,     /* xColumn - read data */
+    pathStatsRowid,      /* xRowid - read data */
     0,                   /* xUpdate */
     0,                   /* xBegin */
     0,                   /* xSync */
@@ -613,75 +6689,102 @@ __declspec(dllexport)
     int sqlite3_path_init(sqlite3 *db, char **pzErrMsg,
                           const sqlite3_api_routines *pApi) {
   int rc = SQLITE_OK;
+  path_context *pCtx;
+  static const path_style *aStyle[] = {&pathStyleUnix, &pathStyleWindows};
+  static const path_module aModule[] = {
+      {"parts", PATH_PARTS_SCHEMA, &pathStyleUnix},
+      {"parse", PATH_PARSE_SCHEMA, &pathStyleUnix},
+      {"parts", PATH_PARTS_SCHEMA, &pathStyleWindows},
+      {"parse", PATH_PARSE_SCHEMA, &pathStyleWindows},
+      {"ancestors", PATH_ANCESTORS_SCHEMA, &pathStyleUnix},
+      {"ancestors", PATH_ANCESTORS_SCHEMA, &pathStyleWindows},
+      {"synth", PATH_SYNTH_SCHEMA, &pathStyleUnix},
+      {"stats", PATH_STATS_SCHEMA, &pathStyleUnix},
+      {"trie", PATH_TRIE_SCHEMA, &pathStyleUnix},
+      {"closure", PATH_CLOSURE_SCHEMA, &pathStyleUnix},
+  };
+  static const sqlite3_module *aModuleImpl[] = {
+      &pathPartsModule,     &pathParseModule, &pathPartsModule,
+      &pathParseModule,     &pathAncestorsModule, &pathAncestorsModule,
+      &pathSynthModule,     &pathStatsModule, &pathTrieModule,
+      &pathClosureModule};
+  char zName[64];
   SQLITE_EXTENSION_INIT2(pApi);
 
-  // Just unix for now - maybe should be configurable?
-  cwk_path_set_style(CWK_STYLE_UNIX);
+  pathSelectKernels();
 
   (void)pzErrMsg; /* Unused parameter */
+
+  pCtx = sqlite3_malloc(sizeof(*pCtx));
+  if (pCtx == NULL)
+    return SQLITE_NOMEM;
+  memset(pCtx, 0, sizeof(*pCtx));
+  for (int i = 0; i < PATH_CACHE_SIZE; i++)
+    pathParsedInit(&pCtx->aEntry[i].parsed);
+  // held until the end of this function, so a failed registration
+  // can't free pCtx while other functions still need to be registered
+  pCtx->nRef = 1;
+
+  for (int s = 0; s < 2 && rc == SQLITE_OK; s++) {
+    for (int i = 0; i < PATH_FUNCTION_COUNT && rc == SQLITE_OK; i++) {
+      path_function *pFunc = &pCtx->aFunction[s][i];
+      if (s > 0 && !pathFunctions[i].bStyled)
+        continue;
+      pFunc->pCtx = pCtx;
+      pFunc->pStyle = aStyle[s];
+      pFunc->xFunc = pathFunctions[i].xFunc;
+      pFunc->zName = pathFunctions[i].zName;
+      pFunc->iSlot = s * PATH_MAX_FUNCTIONS + i;
+      sqlite3_snprintf(sizeof(zName), zName, "%s%s", pFunc->pStyle->zPrefix,
+                       pathFunctions[i].zName);
+      pCtx->nRef++;
+      rc = sqlite3_create_function_v2(
+          db, zName, pathFunctions[i].nArg,
+          SQLITE_UTF8 | SQLITE_INNOCUOUS | SQLITE_DETERMINISTIC, pFunc,
+          pathFunctionCall, 0, 0, pathFunctionRelease);
+    }
+  }
+  pathContextRelease(pCtx);
+
+  for (int s = 0; s < 2 && rc == SQLITE_OK; s++) {
+    for (size_t i = 0;
+         i < sizeof(pathAggregates) / sizeof(pathAggregates[0]) &&
+         rc == SQLITE_OK;
+         i++) {
+      sqlite3_snprintf(sizeof(zName), zName, "%s%s", aStyle[s]->zPrefix,
+                       pathAggregates[i].zName);
+      rc = sqlite3_create_window_function(
+          db, zName, pathAggregates[i].nArg,
+          SQLITE_UTF8 | SQLITE_INNOCUOUS | SQLITE_DETERMINISTIC |
+              pathAggregates[i].iFlags,
+          (void *)aStyle[s], pathAggregates[i].xStep, pathAggregates[i].xFinal,
+          pathAggregates[i].xValue, pathAggregates[i].xInverse, 0);
+    }
+  }
+
   if (rc == SQLITE_OK)
-    rc = sqlite3_create_function(db, "path_version", 0,
-                                 SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                     SQLITE_DETERMINISTIC,
-                                 0, pathVersionFunc, 0, 0);
+    rc = sqlite3_create_collation_v2(db, "PATH", SQLITE_UTF8, 0,
+                                     pathCollateBinary, 0);
   if (rc == SQLITE_OK)
-    rc = sqlite3_create_function(db, "path_debug", 0,
-                                 SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                     SQLITE_DETERMINISTIC,
-                                 0, pathDebugFunc, 0, 0);
+    rc = sqlite3_create_collation_v2(db, "PATH_NOCASE", SQLITE_UTF8, 0,
+                                     pathCollateNocase, 0);
   if (rc == SQLITE_OK)
-    rc = sqlite3_create_function(db, "path_join", -1,
-                                 SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                     SQLITE_DETERMINISTIC,
-                                 0, pathJoinFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_dirname", 1,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathDirnameFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_basename", 1,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathBasenameFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_extension", 1,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathExtensionFunc, 0, 0);
-  rc = sqlite3_create_function(
-      db, "path_name", 1, SQLITE_UTF8 | SQLITE_INNOCUOUS | SQLITE_DETERMINISTIC,
-      0, pathNameFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_part_at", 2,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathPartAtFunc, 0, 0);
-  rc = sqlite3_create_function(
-      db, "path_at", 2, SQLITE_UTF8 | SQLITE_INNOCUOUS | SQLITE_DETERMINISTIC,
-      0, pathPartAtFunc, 0, 0);
-  rc = sqlite3_create_function(
-      db, "path_length", 1, SQLITE_UTF8 | SQLITE_INNOCUOUS | SQLITE_DETERMINISTIC,
-      0, pathLengthFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_absolute", 1,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathAbsoluteFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_relative", 1,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathRelativeFunc, 0, 0);
-  rc = sqlite3_create_function(
-      db, "path_root", 1, SQLITE_UTF8 | SQLITE_INNOCUOUS | SQLITE_DETERMINISTIC,
-      0, pathRootFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_normalize", 1,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathNormalizeFunc, 0, 0);
-  rc = sqlite3_create_function(db, "path_intersection", 2,
-                               SQLITE_UTF8 | SQLITE_INNOCUOUS |
-                                   SQLITE_DETERMINISTIC,
-                               0, pathIntersectionFunc, 0, 0);
+    rc = sqlite3_create_collation_v2(db, "PATH_NATURAL", SQLITE_UTF8, 0,
+                                     pathCollateNatural, 0);
 
+  // changes process-wide settings, so only top-level SQL can call it
   if (rc == SQLITE_OK)
-    rc = sqlite3_create_module(db, "path_parts", &pathPartsModule, 0);
+    rc = sqlite3_create_function_v2(db, "path_config", -1,
+                                    SQLITE_UTF8 | SQLITE_DIRECTONLY, 0,
+                                    pathConfigFunc, 0, 0, 0);
+
+  for (size_t i = 0;
+       i < sizeof(aModule) / sizeof(aModule[0]) && rc == SQLITE_OK; i++) {
+    sqlite3_snprintf(sizeof(zName), zName, "%s%s", aModule[i].pStyle->zPrefix,
+                     aModule[i].zName);
+    rc = sqlite3_create_module(db, zName, aModuleImpl[i], (void *)&aModule[i]);
+  }
   return rc;
 }
 
-#pragma endregion
\ No newline at end of file
+#pragma endregion
@@ -1,4 +1,9 @@
 import sqlite3
+import json
+import os
+import subprocess
+import sys
+import threading
 import unittest
 
 EXT_PATH="./dist/path0"
@@ -36,6 +41,8 @@ FUNCTIONS = [
   "path_absolute",
   "path_at",
   "path_basename",
+  "path_common_prefix",
+  "path_config",
   "path_debug",
   "path_dirname",
   "path_extension",
@@ -46,12 +53,45 @@ FUNCTIONS = [
   "path_normalize",
   "path_part_at",
   "path_relative",
+  "path_rollup",
   "path_root",
+  "path_sort_key",
+  "path_subtree_upper",
+  "path_tree",
+  "path_under",
   "path_version",
+  "path_win_absolute",
+  "path_win_at",
+  "path_win_basename",
+  "path_win_common_prefix",
+  "path_win_dirname",
+  "path_win_extension",
+  "path_win_intersection",
+  "path_win_join",
+  "path_win_length",
+  "path_win_name",
+  "path_win_normalize",
+  "path_win_part_at",
+  "path_win_relative",
+  "path_win_rollup",
+  "path_win_root",
+  "path_win_sort_key",
+  "path_win_subtree_upper",
+  "path_win_tree",
+  "path_win_under",
 ]
 
 MODULES = [
+  "path_ancestors",
+  "path_closure",
+  "path_parse",
   "path_parts",
+  "path_stats",
+  "path_synth",
+  "path_trie",
+  "path_win_ancestors",
+  "path_win_parse",
+  "path_win_parts",
 ]
 class TestPath(unittest.TestCase):
   def test_funcs(self):
@@ -71,13 +111,105 @@ class TestPath(unittest.TestCase):
 
   def test_path_debug(self):
     debug = db.execute("select path_debug()").fetchone()[0].split('\n')
-    self.assertEqual(len(debug), 4)
+    self.assertEqual(len(debug), 5)
 
     self.assertTrue(debug[0].startswith("Version: v"))
     self.assertTrue(debug[1].startswith("Date: "))
     self.assertTrue(debug[2].startswith("Source: "))
     self.assertTrue(debug[3].startswith("cwalk version:"))
+    self.assertIn(debug[4], ["Scan kernel: avx2", "Scan kernel: sse2", "Scan kernel: bytes"])
+
+  def test_scan_kernels(self):
+    # every kernel, forced with SQLITE_PATH_SCAN in a fresh process, tokenizes
+    # paths around vector and window sizes the same as the plain byte loop
+    child = """
+import json, sqlite3, sys
+db = sqlite3.connect(":memory:")
+db.enable_load_extension(True)
+db.load_extension(sys.argv[1])
+paths = []
+for n in [15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 256, 257, 511, 512, 513]:
+  for unit in ["/ab.c", "a//.b", "x\\\\y.", "..//"]:
+    path = (unit * n)[:n]
+    paths += [path, path[:-1] + "/", "/" + path[1:]]
+sql = (
+  "select path_normalize(?1), path_dirname(?1), path_basename(?1), path_extension(?1),"
+  " path_name(?1), path_length(?1), path_part_at(?1, -1), path_part_at(?1, 3),"
+  " path_win_normalize(?1), path_win_length(?1), path_win_extension(?1),"
+  " (select json_group_array(part) from path_parts(?1))"
+)
+rows = [list(db.execute(sql, [p]).fetchone()) for p in paths]
+kernel = db.execute("select path_debug()").fetchone()[0].split(chr(10))[-1]
+print(json.dumps([kernel, rows]))
+"""
+    def run(kernel):
+      env = dict(os.environ, SQLITE_PATH_SCAN=kernel)
+      out = subprocess.run([sys.executable, "-c", child, EXT_PATH], env=env, check=True, capture_output=True)
+      return json.loads(out.stdout)
+    name, expected = run("bytes")
+    self.assertEqual(name, "Scan kernel: bytes")
+    for kernel in ["sse2", "avx2"]:
+      name, rows = run(kernel)
+      # kernels the CPU doesn't have fall back to a narrower one
+      self.assertIn(name, ["Scan kernel: " + kernel, "Scan kernel: sse2", "Scan kernel: bytes"])
+      self.assertEqual(rows, expected, kernel)
   
+  def test_path_config(self):
+    stats = db.execute("select path_config('stats')").fetchone()[0]
+    self.assertEqual(db.execute("select path_config('stats', 1)").fetchone()[0], 1)
+    self.assertEqual(db.execute("select path_config('stats')").fetchone()[0], 1)
+    self.assertEqual(db.execute("select path_config('stats', 0)").fetchone()[0], 0)
+    with self.assertRaisesRegex(sqlite3.OperationalError, "unknown path_config setting 'nope'"):
+      db.execute("select path_config('nope')").fetchone()
+    db.execute("select path_config('stats', ?)", [stats])
+
+  def test_path_stats(self):
+    def stats(name):
+      return execute_all("select calls, bytes_in, bytes_out, nulls, cache_hits, cache_misses from path_stats where name = ?", [name])[0]
+
+    names = [row["name"] for row in execute_all("select name from path_stats")]
+    self.assertIn("path_basename", names)
+    self.assertIn("path_win_basename", names)
+    self.assertIn("path_parts.xFilter", names)
+    self.assertIn("path_win_parts.xNext", names)
+    self.assertNotIn("path_win_version", names)
+
+    db.execute("select path_config('stats', 1)")
+    db.execute("select path_config('stats', 'reset')")
+    self.assertEqual(stats("path_basename"), {"calls": 0, "bytes_in": 0, "bytes_out": 0, "nulls": 0, "cache_hits": 0, "cache_misses": 0})
+
+    db.execute("select path_basename('stats/a.txt'), path_dirname('stats/a.txt'), path_basename('stats/'), path_basename(null)").fetchall()
+    self.assertEqual(stats("path_basename"), {"calls": 3, "bytes_in": 17, "bytes_out": 5 + 5, "nulls": 1, "cache_hits": 0, "cache_misses": 2})
+    # path_dirname reuses the parse path_basename cached
+    self.assertEqual(stats("path_dirname")["cache_hits"], 1)
+
+    db.execute("select * from path_parts('a/b/c')").fetchall()
+    self.assertEqual(stats("path_parts.xFilter")["calls"], 1)
+    self.assertEqual(stats("path_parts.xFilter")["bytes_in"], 5)
+    self.assertEqual(stats("path_parts.xNext")["calls"], 3)
+    self.assertGreater(db.execute("select ns from path_stats where name = 'path_parts.xFilter'").fetchone()[0], 0)
+
+    # nothing is counted while stats are off
+    db.execute("select path_config('stats', 0)")
+    db.execute("select path_basename('stats/a.txt')").fetchall()
+    self.assertEqual(stats("path_basename")["calls"], 3)
+
+    # the counts of a thread are kept after it exits
+    db.execute("select path_config('stats', 1)")
+    def count_in_thread():
+      other = sqlite3.connect(":memory:")
+      other.enable_load_extension(True)
+      other.load_extension(EXT_PATH)
+      other.execute("select path_basename('a/b'), path_basename('c/d')").fetchall()
+      other.close()
+    thread = threading.Thread(target=count_in_thread)
+    thread.start()
+    thread.join()
+    self.assertEqual(stats("path_basename")["calls"], 5)
+    db.execute("select path_config('stats', 'reset')")
+    self.assertEqual(stats("path_basename")["calls"], 0)
+    db.execute("select path_config('stats', 0)")
+
   def test_path_absolute(self):
     path_absolute = lambda arg: db.execute("select path_absolute(?)", [arg]).fetchone()[0]
     self.assertEqual(path_absolute("/a"), 1)
@@ -134,6 +266,17 @@ class TestPath(unittest.TestCase):
     self.assertEqual(path_intersection('', ''), None)
     self.assertEqual(path_intersection('', None), None)
     self.assertEqual(path_intersection(None, ''), None)
+    self.assertEqual(path_intersection('/a/./b/../c/d', '/a/c/e'), '/a/./b/../c')
+    # . and .. are resolved before segments are compared
+    self.assertEqual(path_intersection('/a/b/c.txt', '/a/./b'), '/a/b')
+    self.assertEqual(path_intersection('/a/./b', '/a/b/c.txt'), '/a/./b')
+    self.assertEqual(path_intersection('/a/../..', '/a'), '/')
+    self.assertEqual(path_intersection('a/../b', 'b/c'), 'a/../b')
+    self.assertEqual(path_intersection('.', '.'), None)
+    self.assertEqual(path_intersection('..', '..'), '..')
+    self.assertEqual(path_intersection('a/b', '/a/b'), None)
+    self.assertEqual(path_intersection('../a/b', '../a/c'), '../a')
+    self.assertEqual(path_intersection(b'/a/\xff/b', b'/a/\xff/c'), b'/a/\xff')
   
   def test_path_join(self):
     path_join = lambda *a: db.execute("select path_join({args})".format(args=spread_args(a)), a).fetchone()[0]
@@ -146,6 +289,14 @@ class TestPath(unittest.TestCase):
     self.assertEqual(path_join("/a", "..", "..", "b"), "/b")
     self.assertEqual(path_join("a", None), 'a')
     self.assertEqual(path_join(None, 'a'), None)
+    self.assertEqual(path_join("a", None, "b", None), 'a/b')
+    self.assertEqual(path_join("a/b", "../../..", "c"), '../c')
+    self.assertEqual(path_join("/a/b", "../c/./d", "..", "e"), '/a/c/e')
+    self.assertEqual(path_join("", ""), '.')
+
+    # no longer truncated at FILENAME_MAX
+    long = "/".join(["x" * 50] * 200)
+    self.assertEqual(path_join(long, long, "z"), long + "/" + long + "/z")
 
     with self.assertRaisesRegex(sqlite3.OperationalError, 'at least 2 paths are required for path_join'):
       path_join()
@@ -167,6 +318,9 @@ class TestPath(unittest.TestCase):
     self.assertEqual(path_normalize("~/../a/b/./c/../ayoo"), "a/b/ayoo")
     self.assertEqual(path_normalize("/a/b/c/../../x"), "/a/x")
     self.assertEqual(path_normalize(None), None)
+    self.assertEqual(path_normalize(""), ".")
+    self.assertEqual(path_normalize("//a//b//"), "/a/b")
+    self.assertEqual(path_normalize("a/../.."), "..")
   
   def test_path_relative(self):
     path_relative = lambda arg: db.execute("select path_relative(?)", [arg]).fetchone()[0]
@@ -221,6 +375,130 @@ class TestPath(unittest.TestCase):
     self.assertEqual(path_part_at(None, 1), None)
     self.assertEqual(path_part_at(PATH, None), "home")
   
+  def test_path_sort_key(self):
+    path_sort_key = lambda arg: db.execute("select path_sort_key(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_sort_key("/a/b"), b"\x00a\x00b")
+    self.assertEqual(path_sort_key("a/b"), b"a\x00b")
+    self.assertEqual(path_sort_key("/"), b"\x00")
+    self.assertEqual(path_sort_key(""), b"")
+    self.assertEqual(path_sort_key(None), None)
+    # separator runs and trailing separators don't change the key
+    self.assertEqual(path_sort_key("/a//b/"), path_sort_key("/a/b"))
+    # 0x00 and 0x01 are escaped so the separator sorts below them
+    self.assertEqual(path_sort_key("a\x00b\x01"), b"a\x01\x01b\x01\x02")
+    self.assertEqual(path_sort_key(b"a\x00b"), b"a\x01\x01b")
+
+    # keys sort depth first, where plain text puts /a-b between /a and /a/b
+    paths = ["/a-b", "/a/b/c", "/a", "/a.txt", "/a/b", "/b", "/a/b-c", "/a/b/c/d", "/a\x00"]
+    # bound one by one, json_each() cuts strings at \u0000 before SQLite 3.45
+    tree = [row[0] for row in db.execute(
+      "select column1 from (values %s) order by path_sort_key(column1)" % ",".join("(?)" for _ in paths), paths
+    )]
+    self.assertEqual(tree, ["/a", "/a/b", "/a/b/c", "/a/b/c/d", "/a/b-c", "/a\x00", "/a-b", "/a.txt", "/b"])
+
+  def test_path_subtree_upper(self):
+    path_subtree_upper = lambda arg: db.execute("select path_subtree_upper(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_subtree_upper("/a"), b"\x00a\x01")
+    self.assertEqual(path_subtree_upper("/a/"), b"\x00a\x01")
+    self.assertEqual(path_subtree_upper("/"), b"\x01")
+    self.assertEqual(path_subtree_upper(""), None)
+    self.assertEqual(path_subtree_upper(None), None)
+
+    db.execute("create table subtree(path text)")
+    db.executemany("insert into subtree values (?)", [[p] for p in [
+      "/srv/data/a", "/srv/data/a/x.csv", "/srv/data/a/b/y.csv", "/srv/data/a-b/z.csv",
+      "/srv/data/a.txt", "/srv/data/ab", "/srv/data", "/srv/other/a/x.csv",
+    ]])
+    db.execute("create index subtree_tree on subtree(path_sort_key(path))")
+    sql = """
+      select path from subtree
+      where path_sort_key(path) >= path_sort_key(?)
+        and path_sort_key(path) < path_subtree_upper(?)
+      order by path_sort_key(path)
+    """
+    self.assertEqual(
+      [row[0] for row in db.execute(sql, ["/srv/data/a", "/srv/data/a"])],
+      ["/srv/data/a", "/srv/data/a/b/y.csv", "/srv/data/a/x.csv"]
+    )
+    self.assertEqual(
+      [row[0] for row in db.execute(sql, ["/", "/"])],
+      [row[0] for row in db.execute("select path from subtree order by path_sort_key(path)")]
+    )
+    plan = " ".join(row[3] for row in db.execute("explain query plan " + sql, ["/srv", "/srv"]))
+    self.assertIn("USING INDEX subtree_tree", plan)
+    db.execute("drop table subtree")
+
+  def test_path_under(self):
+    path_under = lambda a, b: db.execute("select path_under(?, ?)", [a, b]).fetchone()[0]
+    self.assertEqual(path_under("/srv/data/a/x.csv", "/srv/data/a"), 1)
+    self.assertEqual(path_under("/srv/data/a/b/y.csv", "/srv/data/a/"), 1)
+    self.assertEqual(path_under("/srv/data/a", "/srv/data/a"), 0)
+    self.assertEqual(path_under("/srv/data/a-b/z.csv", "/srv/data/a"), 0)
+    self.assertEqual(path_under("/srv/data/ab", "/srv/data/a"), 0)
+    self.assertEqual(path_under("/srv/data", "/srv/data/a"), 0)
+    self.assertEqual(path_under("/a", "/"), 1)
+    self.assertEqual(path_under("a/b", "/a"), 0)
+    self.assertEqual(path_under("/a/b", "a"), 0)
+    self.assertEqual(path_under("a/b", "a"), 1)
+    # normalized first
+    self.assertEqual(path_under("/a/b/../c", "/a"), 1)
+    self.assertEqual(path_under("/a/../b", "/a"), 0)
+    self.assertEqual(path_under("/a//b", "/x/../a/."), 1)
+    self.assertEqual(path_under(None, "/a"), None)
+    self.assertEqual(path_under("/a/b", None), None)
+
+    # the index range rewrite gives the same rows
+    db.execute("create table under_files as select path from path_synth(2000, 7)")
+    db.execute("create index under_files_tree on under_files(path_sort_key(path))")
+    for d in ["src", "src/lib", "vendor/lib/core", "nothing/here"]:
+      scan = db.execute("select path from under_files where path_under(path, ?) order by path", [d]).fetchall()
+      ranged = db.execute(
+        """select path from under_files
+           where path_sort_key(path) > path_sort_key(?1) and path_sort_key(path) < path_subtree_upper(?1)
+           order by path""", [d]).fetchall()
+      self.assertEqual(scan, ranged)
+    self.assertGreater(len(db.execute("select 1 from under_files where path_under(path, 'src')").fetchall()), 0)
+    db.execute("drop table under_files")
+
+  def test_collations(self):
+    def order(collation, paths):
+      return [row[0] for row in db.execute(
+        f"select value from json_each(?) order by value collate {collation}", [json.dumps(paths)]
+      )]
+    paths = ["/a-b", "/a/b", "/a", "/a.txt", "/a/b/c", "/b", "/A"]
+    self.assertEqual(order("binary", paths), ["/A", "/a", "/a-b", "/a.txt", "/a/b", "/a/b/c", "/b"])
+    self.assertEqual(order("PATH", paths), ["/A", "/a", "/a/b", "/a/b/c", "/a-b", "/a.txt", "/b"])
+    # PATH matches the order of path_sort_key
+    self.assertEqual(
+      order("PATH", paths),
+      [row[0] for row in db.execute("select value from json_each(?) order by path_sort_key(value)", [json.dumps(paths)])]
+    )
+    self.assertEqual(db.execute("select '/a//b/' = '/a/b' collate PATH").fetchone()[0], 1)
+    self.assertEqual(db.execute("select '/' = '' collate PATH").fetchone()[0], 0)
+
+    self.assertEqual(order("PATH_NOCASE", ["/b", "/A/x", "/a", "/B/c"]), ["/a", "/A/x", "/b", "/B/c"])
+    self.assertEqual(db.execute("select 'Photos/ÉTÉ.JPG' = 'photos/été.jpg' collate PATH_NOCASE").fetchone()[0], 1)
+    self.assertEqual(db.execute("select 'ΑΘΗΝΑ' = 'αθηνα' collate PATH_NOCASE").fetchone()[0], 1)
+    # one side a prefix of the other, which is all the shorter side has to read
+    self.assertEqual(tuple(db.execute("select 'a/b' < 'a/bé' collate PATH_NOCASE, 'A/BÉ' > 'a/b' collate PATH_NOCASE").fetchone()), (1, 1))
+
+    self.assertEqual(
+      order("PATH_NATURAL", ["file10", "file2", "file1", "file02", "dir/file10", "dir/file9", "dir-1"]),
+      ["dir/file9", "dir/file10", "dir-1", "file1", "file2", "file02", "file10"]
+    )
+    # numbers with leading zeros aren't equal to the same number without
+    self.assertEqual(db.execute("select 'a2' = 'a02' collate PATH_NATURAL").fetchone()[0], 0)
+
+    # usable in indexes, so tree order comes from the index
+    db.execute("create table collated(path text collate PATH)")
+    db.executemany("insert into collated values (?)", [[p] for p in paths])
+    db.execute("create index collated_path on collated(path)")
+    self.assertEqual([row[0] for row in db.execute("select path from collated order by path")], order("PATH", paths))
+    plan = " ".join(row[3] for row in db.execute("explain query plan select path from collated order by path"))
+    self.assertIn("collated_path", plan)
+    self.assertNotIn("TEMP B-TREE", plan)
+    db.execute("drop table collated")
+
   def test_path_parts(self):
     self.assertEqual(execute_all("select rowid, * from path_parts('/home/root/.././.ssh/keys')"), [
       {"rowid": 0, "part": "home", "type": "normal"},
@@ -230,6 +508,744 @@ class TestPath(unittest.TestCase):
       {"rowid": 4, "part": ".ssh", "type": "normal"},
       {"rowid": 5, "part": "keys", "type": "normal"},
     ])
+
+    # deeper than the tokenizer's inline segment storage
+    deep = "/".join("s%d" % i for i in range(100))
+    self.assertEqual(db.execute("select count(*), max(rowid), max(part) from path_parts(?)", [deep]).fetchone()[:], (100, 99, "s99"))
+    self.assertEqual(db.execute("select path_length(?), path_part_at(?, 40), path_part_at(?, -100)", [deep, deep, deep]).fetchone()[:], (100, "s40", "s0"))
+
+    # rescans start over at rowid 0
+    self.assertEqual(execute_all("select v.value as path, p.rowid, p.part from json_each('[\"a/b\", \"c/d/e\"]') v, path_parts(v.value) p"), [
+      {"path": "a/b", "rowid": 0, "part": "a"},
+      {"path": "a/b", "rowid": 1, "part": "b"},
+      {"path": "c/d/e", "rowid": 0, "part": "c"},
+      {"path": "c/d/e", "rowid": 1, "part": "d"},
+      {"path": "c/d/e", "rowid": 2, "part": "e"},
+    ])
+    self.assertEqual(execute_all("select * from path_parts(null)"), [])
+
+    # constraints on part, type and rowid are pushed down to the cursor
+    path = "/a/node_modules/b/../node_modules/./c"
+    parts = lambda where, *args: [(row["rowid"], row["part"]) for row in execute_all(
+      "select rowid, part from path_parts(?) where " + where, [path, *args])]
+    self.assertEqual(parts("part = 'node_modules'"), [(1, "node_modules"), (4, "node_modules")])
+    self.assertEqual(parts("part = ?", b"node_modules"), [])
+    self.assertEqual(parts("part = 'NODE_MODULES' collate nocase"), [(1, "node_modules"), (4, "node_modules")])
+    self.assertEqual(parts("type = 'back'"), [(3, "..")])
+    self.assertEqual(parts("type = 'current' and part = '.'"), [(5, ".")])
+    self.assertEqual(parts("type = 'unknown'"), [])
+    self.assertEqual(parts("rowid = 2"), [(2, "b")])
+    self.assertEqual(parts("rowid between 2 and 3"), [(2, "b"), (3, "..")])
+    self.assertEqual(parts("rowid > 4 and rowid < 100"), [(5, "."), (6, "c")])
+    self.assertEqual(parts("rowid >= 6"), [(6, "c")])
+    self.assertEqual(parts("rowid < 1.5"), [(0, "a"), (1, "node_modules")])
+    self.assertEqual(parts("rowid <= -1"), [])
+    self.assertEqual(parts("rowid > 9223372036854775807"), [])
+    self.assertEqual(parts("part = 'node_modules' and rowid > 1"), [(4, "node_modules")])
+    self.assertEqual(execute_all("select rowid, part from path_parts('/a/1/b') where part = 1"), [{"rowid": 1, "part": "1"}])
+    self.assertEqual(explain_query_plan("select * from path_parts('a/b') where part = 'b' and rowid = 1"), "SCAN path_parts VIRTUAL TABLE INDEX 5:")
+
+    # ORDER BY rowid and LIMIT/OFFSET are consumed by path_parts
+    path = "/a/b/c/d/e/f"
+    parts = lambda sql: [row["part"] for row in execute_all("select part from path_parts(?) " + sql, [path])]
+    self.assertEqual(parts("order by rowid desc limit 2"), ["f", "e"])
+    self.assertEqual(parts("order by rowid desc limit 2 offset 1"), ["e", "d"])
+    self.assertEqual(parts("order by rowid desc limit 10 offset 4"), ["b", "a"])
+    self.assertEqual(parts("order by rowid desc"), ["f", "e", "d", "c", "b", "a"])
+    self.assertEqual(parts("order by rowid limit 2 offset 3"), ["d", "e"])
+    self.assertEqual(parts("limit 2 offset 10"), [])
+    self.assertEqual(parts("limit -1 offset 4"), ["e", "f"])
+    self.assertEqual(parts("limit 0"), [])
+    self.assertEqual(parts("where rowid < 4 order by rowid desc limit 2"), ["d", "c"])
+    self.assertEqual(parts("where rowid >= 2 order by rowid desc limit 2 offset 3"), ["c"])
+    self.assertEqual(parts("where part <> 'b' order by rowid desc limit 2 offset 4"), ["a"])
+    self.assertEqual(parts("where part = 'b' order by rowid desc limit 2"), ["b"])
+    self.assertEqual(parts("order by part desc limit 2"), ["f", "e"])
+    self.assertEqual(
+      [row["part"] for row in execute_all(
+        "select p.part from json_each('[\"a/b/c\", \"x/y\"]') as f, path_parts(f.value) as p where p.rowid >= 1 order by f.value, p.rowid desc")],
+      ["c", "b", "y"])
+    self.assertEqual(explain_query_plan("select part from path_parts('a/b') order by rowid desc limit 1"), "SCAN path_parts VIRTUAL TABLE INDEX 65664:")
+
+    # a list of paths is handled by one cursor, and the path column is real
+    db.execute("create temp table staging(path)")
+    db.executemany("insert into staging values (?)", [["/a/b"], ["x/y/z"], [None], [b"/q"], ["/a/b"]])
+    rows = lambda sql: [tuple(row) for row in db.execute(sql).fetchall()]
+    self.assertEqual(
+      sorted(rows("select path, rowid, part from path_parts where path in (select path from staging)"), key=str),
+      sorted([("/a/b", 0, "a"), ("/a/b", 1, "b"), ("x/y/z", 0, "x"), ("x/y/z", 1, "y"), ("x/y/z", 2, "z"), (b"/q", 0, b"q")], key=str))
+    self.assertEqual(
+      sorted(rows("select path, part from path_parts where path in ('a/b/c', 'x/y/z') and part in ('b', 'z')")),
+      [("a/b/c", "b"), ("x/y/z", "z")])
+    self.assertEqual(
+      rows("select path, part from path_parts where path in ('a/b/c', 'x/y/z') order by path desc, rowid desc limit 2 offset 1"),
+      [("x/y/z", "y"), ("x/y/z", "x")])
+    self.assertEqual(
+      len(rows("select part from path_parts where path in ('a/b/c', 'x/y/z') limit 4 offset 1")), 4)
+    self.assertEqual(
+      rows("select s.path, p.path from staging as s, path_parts(s.path) as p where p.rowid = 0 order by s.rowid"),
+      [("/a/b", "/a/b"), ("x/y/z", "x/y/z"), (b"/q", b"/q"), ("/a/b", "/a/b")])
+    self.assertEqual(explain_query_plan("select * from path_parts where path in ('a', 'b')"), "SCAN path_parts VIRTUAL TABLE INDEX 131072:")
+    db.execute("drop table staging")
+
+    # the path is computed per row, so its text is freed while the parts of a
+    # previous row may still be read
+    self.assertEqual(
+      [row["part"] for row in execute_all("""
+        select p.part
+        from (select 'dir' || value || '/' || printf('%.*c', value * 50, 'x') as path from json_each('[1,2,3]')) as f,
+          path_parts(f.path) as p
+        order by f.path desc, p.rowid desc
+      """)],
+      ["x" * 150, "dir3", "x" * 100, "dir2", "x" * 50, "dir1"])
+
+  def test_path_synth(self):
+    paths = execute_all("select rowid, path from path_synth(1000, 42)")
+    self.assertEqual(len(paths), 1000)
+    self.assertEqual([p["rowid"] for p in paths], list(range(1, 1001)))
+    # deterministic, and every row only depends on its rowid
+    self.assertEqual(execute_all("select rowid, path from path_synth(1000, 42)"), paths)
+    self.assertEqual(
+      execute_all("select rowid, path from path_synth(1000, 42) where rowid between 100 and 109"),
+      paths[99:109]
+    )
+    self.assertEqual(
+      execute_all("select rowid, path from path_synth(1000, 42) where rowid > 995"),
+      paths[995:]
+    )
+    # bounds that aren't integers are still applied, as SQLite compares them
+    synth_rowids = lambda where: [r[0] for r in db.execute("select rowid from path_synth(10, 42) where " + where).fetchall()]
+    self.assertEqual(synth_rowids("rowid < 2.5"), [1, 2])
+    self.assertEqual(synth_rowids("rowid >= 8.5"), [9, 10])
+    self.assertEqual(synth_rowids("rowid < 'x'"), list(range(1, 11)))
+    self.assertEqual(synth_rowids("rowid > 'x'"), [])
+    self.assertEqual(synth_rowids("rowid > null"), [])
+    self.assertEqual(synth_rowids("rowid <= null"), [])
+    self.assertNotEqual(execute_all("select rowid, path from path_synth(1000, 43)"), paths)
+    self.assertEqual(execute_all("select n, seed, profile from path_synth(1)"), [{"n": 1, "seed": 0, "profile": "monorepo"}])
+    self.assertEqual(db.execute("select count(*) from path_synth(0)").fetchone()[0], 0)
+
+    # popular directories hold many files, and there are dotfiles
+    self.assertLess(db.execute("select count(distinct path_dirname(path)) from path_synth(10000, 1)").fetchone()[0], 10000)
+    self.assertGreater(db.execute("select count(*) from path_synth(10000, 1) where path_basename(path) like '.%'").fetchone()[0], 0)
+
+    home = db.execute("select path from path_synth(100, 1, 'home')").fetchall()
+    self.assertTrue(all(p[0].startswith("/home/user/") for p in home))
+    windows = db.execute("select path_win_root(path) from path_synth(100, 1, 'windows')").fetchall()
+    self.assertEqual(set(p[0] for p in windows), {"C:\\"})
+
+    with self.assertRaisesRegex(sqlite3.OperationalError, "unknown path_synth profile 'nope'"):
+      db.execute("select * from path_synth(10, 1, 'nope')").fetchall()
+    with self.assertRaisesRegex(sqlite3.OperationalError, "n argument is required"):
+      db.execute("select * from path_synth").fetchall()
+
+  def test_path_trie(self):
+    db.execute("create table trie_files(path text)")
+    db.executemany("insert into trie_files values (?)", [[p] for p in [
+      "/srv/data/a/x.csv", "/srv/data/a/b/y.csv", "/srv/data/a-b/z.csv",
+      "/srv/other/q", "/srv/data/a/./c/../x2.csv", "rel/file",
+    ]])
+    db.execute("create virtual table trie using path_trie(trie_files, path)")
+    nodes = lambda sql, *args: [tuple(row) for row in db.execute(sql, args).fetchall()]
+
+    # every node, depth first, with the rows at and under it
+    self.assertEqual(nodes("select path, name, depth, count, entries from trie"), [
+      ("", "", 0, 1, 0),
+      ("rel", "rel", 1, 1, 0),
+      ("rel/file", "file", 2, 1, 1),
+      ("/", "/", 0, 5, 0),
+      ("/srv", "srv", 1, 5, 0),
+      ("/srv/data", "data", 2, 4, 0),
+      ("/srv/data/a", "a", 3, 3, 0),
+      ("/srv/data/a/b", "b", 4, 1, 0),
+      ("/srv/data/a/b/y.csv", "y.csv", 5, 1, 1),
+      ("/srv/data/a/x.csv", "x.csv", 4, 1, 1),
+      ("/srv/data/a/x2.csv", "x2.csv", 4, 1, 1),
+      ("/srv/data/a-b", "a-b", 3, 1, 0),
+      ("/srv/data/a-b/z.csv", "z.csv", 4, 1, 1),
+      ("/srv/other", "other", 2, 1, 0),
+      ("/srv/other/q", "q", 3, 1, 1),
+    ])
+    self.assertEqual(nodes("select name, count from trie where children = '/srv/data/'"), [("a", 3), ("a-b", 1)])
+    self.assertEqual(nodes("select path from trie where descendants = '/srv/data/a'"), [
+      ("/srv/data/a/b",), ("/srv/data/a/b/y.csv",), ("/srv/data/a/x.csv",), ("/srv/data/a/x2.csv",),
+    ])
+    # count_under
+    self.assertEqual(nodes("select count from trie where path = '/srv/data/x/..'"), [(4,)])
+    self.assertEqual(nodes("select count from trie where path = '/nope'"), [])
+    # longest indexed prefix
+    self.assertEqual(
+      nodes("select path from trie where prefix_of = '/srv/data/a/b/y.csv/more' and entries > 0 order by depth desc limit 1"),
+      [("/srv/data/a/b/y.csv",)]
+    )
+    self.assertEqual(nodes("select path from trie where prefix_of = '/srv/nope'"), [("/",), ("/srv",)])
+
+    # path_under() on the path column is a descendants scan
+    self.assertEqual(
+      nodes("select path from trie where path_under(path, '/srv/data/a')"),
+      nodes("select path from trie where descendants = '/srv/data/a'")
+    )
+    plan = " ".join(row[3] for row in db.execute("explain query plan select path from trie where path_under(path, '/srv')"))
+    self.assertIn("INDEX 4", plan)
+
+    # triggers keep it in sync with the source table
+    db.execute("insert into trie_files values ('/srv/data/new')")
+    db.execute("delete from trie_files where path = '/srv/other/q'")
+    db.execute("update trie_files set path = '/moved/x' where path = 'rel/file'")
+    self.assertEqual(nodes("select path, count from trie where depth <= 1"), [("/", 6), ("/moved", 1), ("/srv", 5)])
+    self.assertEqual(nodes("select count(*) from trie_node"), [(13,)])
+    self.assertEqual(nodes("select count(*) from trie_entry"), [(6,)])
+    before = nodes("select path, count, entries from trie")
+    db.execute("insert into trie(trie) values ('rebuild')")
+    self.assertEqual(nodes("select path, count, entries from trie"), before)
+
+    with self.assertRaisesRegex(sqlite3.OperationalError, "unknown path_trie command 'vacuum'"):
+      db.execute("insert into trie(trie) values ('vacuum')")
+    with self.assertRaisesRegex(sqlite3.OperationalError, "path_trie tables follow trie_files"):
+      db.execute("delete from trie")
+    with self.assertRaisesRegex(sqlite3.OperationalError, "path_trie takes a source table and a column"):
+      db.execute("create virtual table bad_trie using path_trie(trie_files)")
+    # the triggers write through the trie, which untrusted schema can't do
+    db.execute("pragma trusted_schema = off")
+    try:
+      with self.assertRaisesRegex(sqlite3.OperationalError, 'unsafe use of virtual table "trie"'):
+        db.execute("insert into trie_files values ('/srv/untrusted')")
+    finally:
+      db.execute("pragma trusted_schema = on")
+
+    # renaming the trie renames its shadow tables and triggers, and a renamed
+    # source table is found through its triggers
+    db.execute("alter table trie rename to trie2")
+    db.execute("alter table trie_files rename to trie_files2")
+    db.execute("insert into trie_files2 values ('/srv/renamed')")
+    self.assertEqual(nodes("select count from trie2 where path = '/srv'"), [(6,)])
+    db.execute("insert into trie2(trie2) values ('rebuild')")
+    self.assertEqual(nodes("select count from trie2 where path = '/srv'"), [(6,)])
+    self.assertEqual(
+      nodes("select name, tbl_name from sqlite_master where name like 'trie%' order by 1"), [
+      ("trie2", "trie2"), ("trie2_delete", "trie_files2"), ("trie2_entry", "trie2_entry"),
+      ("trie2_insert", "trie_files2"), ("trie2_node", "trie2_node"), ("trie2_update", "trie_files2"),
+      ("trie_files2", "trie_files2"),
+    ])
+    # a rebuild that fails changes nothing
+    before = nodes("select path, count, entries from trie2")
+    db.execute("alter table trie_files2 rename column path to p")
+    with self.assertRaisesRegex(sqlite3.OperationalError, "no such column: s.path"):
+      db.execute("insert into trie2(trie2) values ('rebuild')")
+    self.assertEqual(nodes("select path, count, entries from trie2"), before)
+
+    db.execute("drop table trie2")
+    self.assertEqual(
+      nodes("select name from sqlite_master where name like 'trie%' order by 1"),
+      [("trie_files2",)]
+    )
+    db.execute("drop table trie_files2")
+
+  def test_path_closure(self):
+    db.execute("create table closure_files(path text)")
+    db.executemany("insert into closure_files values (?)", [[p] for p in [
+      "/srv/data/a.csv", "/srv/data/b/c.csv", "/srv/other", "rel/file",
+    ]])
+    db.execute("create virtual table tree using path_closure(closure_files, path)")
+    rows = lambda sql, *args: [tuple(row) for row in db.execute(sql, args).fetchall()]
+
+    # every node with each of its ancestors, itself included
+    self.assertEqual(rows("select count(*) from tree"), [(28,)])
+    self.assertEqual(rows("select descendant, depth from tree where ancestor = '/srv/data/' order by descendant"), [
+      ("/srv/data", 0), ("/srv/data/a.csv", 1), ("/srv/data/b", 1), ("/srv/data/b/c.csv", 2),
+    ])
+    self.assertEqual(rows("select ancestor from tree where descendant = '/srv/data/b/c.csv' and depth > 0 order by depth"), [
+      ("/srv/data/b",), ("/srv/data",), ("/srv",), ("/",),
+    ])
+    self.assertEqual(rows("select ancestor, descendant from tree where descendant = 'rel/file' and depth >= 1.5"), [("", "rel/file")])
+    self.assertEqual(rows("select descendant from tree where ancestor = '/' and depth between 1.5 and 2 order by 1"), [
+      ("/srv/data",), ("/srv/other",),
+    ])
+    self.assertEqual(rows("select depth from tree where ancestor = '/srv' and descendant = '/srv/data/b'"), [(2,)])
+    self.assertEqual(rows("select count(*) from tree where ancestor = '/nope'"), [(0,)])
+    # ids are rowids of tree_node
+    self.assertEqual(
+      rows("select t.descendant from tree t join tree_node n on n.id = t.descendant_id where n.path = '/srv/data/b' and t.depth = 0"),
+      [("/srv/data/b",)]
+    )
+    self.assertEqual(
+      rows("select descendant from tree where ancestor_id = (select id from tree_node where path = '/srv/data/b') order by 1"),
+      [("/srv/data/b",), ("/srv/data/b/c.csv",)]
+    )
+    # ids compare like the int columns they are, so reals and text match too
+    for ancestor_id in ["2.0", "'2'", "' 2 '", "2"]:
+      self.assertEqual(
+        rows(f"select count(*) from tree where ancestor_id = {ancestor_id}"),
+        rows("select count(*) from tree_closure where ancestor = 2")
+      )
+    self.assertEqual(rows("select count(*) from tree where ancestor_id = 2.5"), [(0,)])
+    self.assertEqual(rows("select count(*) from tree where descendant_id = 'x'"), [(0,)])
+    self.assertEqual(rows("select count(*) from tree where descendant_id = x'02'"), [(0,)])
+    plan = " ".join(row[3] for row in db.execute("explain query plan select * from tree where ancestor = '/srv' and depth = 1"))
+    self.assertIn("INDEX 21", plan)
+
+    # triggers keep it in sync with the source table, renames too
+    db.execute("update closure_files set path = '/srv/moved/c.csv' where path = '/srv/data/b/c.csv'")
+    db.execute("delete from closure_files where path = '/srv/other'")
+    self.assertEqual(rows("select descendant from tree where ancestor = '/srv' and depth = 1 order by 1"), [
+      ("/srv/data",), ("/srv/moved",),
+    ])
+    self.assertEqual(rows("select count(*) from tree_closure where ancestor not in (select id from tree_node)"), [(0,)])
+    before = rows("select ancestor, descendant, depth from tree order by 1, 2")
+    db.execute("insert into tree(tree) values ('rebuild')")
+    self.assertEqual(rows("select ancestor, descendant, depth from tree order by 1, 2"), before)
+
+    with self.assertRaisesRegex(sqlite3.OperationalError, "path_closure tables follow closure_files"):
+      db.execute("delete from tree")
+    with self.assertRaisesRegex(sqlite3.OperationalError, "path_closure takes a source table and a column"):
+      db.execute("create virtual table bad_tree using path_closure(closure_files)")
+
+    db.execute("alter table tree rename to tree2")
+    db.execute("insert into closure_files values ('/srv/renamed')")
+    self.assertEqual(rows("select descendant from tree2 where ancestor = '/srv' and depth = 1 order by 1"), [
+      ("/srv/data",), ("/srv/moved",), ("/srv/renamed",),
+    ])
+    self.assertEqual(rows("select count(*) from sqlite_master where name like 'tree2_%'"), [(6,)])
+    # the index of pairs by descendant is renamed with them
+    plan = " ".join(row[3] for row in db.execute("explain query plan select * from tree2_closure where descendant = 1"))
+    self.assertIn("sqlite_autoindex_tree2_closure_", plan)
+    self.assertEqual(rows("select ancestor from tree2 where descendant = '/srv/renamed' and depth = 1"), [("/srv",)])
+
+    db.execute("drop table tree2")
+    self.assertEqual(rows("select name from sqlite_master where name like 'tree%'"), [])
+    db.execute("drop table closure_files")
+
+  def test_path_ancestors(self):
+    ancestors = lambda sql, *args: [tuple(row) for row in db.execute(sql, args).fetchall()]
+    self.assertEqual(ancestors("select prefix, depth from path_ancestors('/a/b/c.txt')"), [
+      ("/", 0), ("/a", 1), ("/a/b", 2),
+    ])
+    # slices of the path as given, relative paths have no root row
+    self.assertEqual(ancestors("select prefix, depth from path_ancestors('a//b/./c/')"), [
+      ("a", 1), ("a//b", 2), ("a//b/.", 3),
+    ])
+    self.assertEqual(ancestors("select prefix from path_ancestors('/')"), [])
+    self.assertEqual(ancestors("select prefix from path_ancestors('file')"), [])
+    self.assertEqual(ancestors("select prefix from path_ancestors(null)"), [])
+    # max_depth is pushed down
+    self.assertEqual(ancestors("select prefix from path_ancestors('/a/b/c/d', 1)"), [("/",), ("/a",)])
+    self.assertEqual(ancestors("select prefix from path_ancestors('/a/b/c/d') where max_depth = 0"), [("/",)])
+    self.assertEqual(ancestors("select prefix from path_ancestors('/a/b', -1)"), [])
+    self.assertEqual(ancestors("select prefix from path_ancestors('/a/b', null)"), [])
+    self.assertEqual(ancestors("select path, prefix from path_ancestors where path in ('/x/y', 'p/q')"), [
+      ("/x/y", "/"), ("/x/y", "/x"), ("p/q", "p"),
+    ])
+    with self.assertRaisesRegex(sqlite3.OperationalError, "path argument is required"):
+      db.execute("select * from path_ancestors")
+
+    # a du-style rollup without a recursive CTE
+    db.execute("create table ancestors_files(path text, size int)")
+    db.executemany("insert into ancestors_files values (?, ?)", [
+      ("/srv/a/x", 1), ("/srv/a/y", 2), ("/srv/b/z", 4), ("/tmp/t", 8),
+    ])
+    self.assertEqual(ancestors("""
+      select a.prefix, sum(size) from ancestors_files, path_ancestors(ancestors_files.path) a
+      group by 1 order by 1
+    """), [("/", 15), ("/srv", 7), ("/srv/a", 3), ("/srv/b", 4), ("/tmp", 8)])
+    db.execute("drop table ancestors_files")
+
+  def test_path_rollup(self):
+    db.execute("create table rollup_files(path text, size)")
+    db.executemany("insert into rollup_files values (?, ?)", [
+      ("/srv/a/x", 1), ("/srv/a/y", 2), ("/srv/b/z", 4), ("/tmp/t", 8),
+      ("/srv/./b/../a/k", 32), ("rel/q/w", 16), ("top", 64), (None, 128), ("/srv/n", None),
+    ])
+    rollup = lambda sql: db.execute(sql).fetchone()[0]
+    # every ancestor, normalized, depth first with siblings by name
+    self.assertEqual(
+      rollup("select path_rollup(path, size) from rollup_files"),
+      '{"rel":16,"rel/q":16,"/":47,"/srv":39,"/srv/a":35,"/srv/b":4,"/tmp":8}'
+    )
+    # the same totals as a group by over path_ancestors
+    self.assertEqual(
+      dict(db.execute("select key, value from json_each((select path_rollup(path, size) from rollup_files))").fetchall()),
+      dict(db.execute("""
+        select a.prefix, sum(size) from rollup_files, path_ancestors(path_normalize(rollup_files.path)) a
+        where size is not null group by 1
+      """).fetchall())
+    )
+    self.assertEqual(
+      rollup("select path_rollup(path, size / 2.0) from rollup_files where path like '/tmp%'"),
+      '{"/":4.0,"/tmp":4.0}'
+    )
+    self.assertEqual(rollup("select path_rollup(path, '3') from rollup_files where path = '/tmp/t'"), '{"/":3,"/tmp":3}')
+    self.assertEqual(rollup("select path_rollup(path, size) from rollup_files where 0"), "{}")
+    self.assertEqual(rollup("select json_type(path_rollup(path, size)) from rollup_files"), "object")
+    self.assertEqual(rollup("""select path_rollup('/a"b/\n/c', 1)"""), '{"/":1,"/a\\"b":1,"/a\\"b/\\n":1}')
+    with self.assertRaisesRegex(sqlite3.OperationalError, "integer overflow"):
+      rollup("select path_rollup(path, 9223372036854775807) from rollup_files")
+    db.execute("drop table rollup_files")
+
+  def test_path_win_rollup(self):
+    self.assertEqual(
+      db.execute("select path_win_rollup(column1, 1) from (values ('C:\\a\\B'), ('c:/A/b/x'))").fetchone()[0],
+      '{"C:\\\\":2,"C:\\\\a":2,"C:\\\\a\\\\b":1}'
+    )
+    # unix paths that differ in case are different paths
+    self.assertEqual(
+      db.execute("select path_rollup(column1, 1) from (values ('/a/B'), ('/A/b/x'))").fetchone()[0],
+      '{"/":2,"/A":1,"/A/b":1,"/a":1}'
+    )
+
+  def test_path_tree(self):
+    db.execute("create table tree_files(path text, size)")
+    db.executemany("insert into tree_files values (?, ?)", [
+      ("/srv/b/z", 4), ("/srv/a/x", 1), ("/srv/a/y", 2), ("/srv/./b/../a/y", 32),
+      ("rel/q", 16), ("top", None), (None, 128), ("/srv/a", "dir"),
+    ])
+    tree = lambda sql, *args: json.loads(db.execute(sql, args).fetchone()[0])
+    # counts of rows at or under each node, relative paths at the top level
+    self.assertEqual(tree("select path_tree(path) from tree_files"), {"count": 7, "children": [
+      {"name": "/", "count": 5, "children": [
+        {"name": "srv", "count": 5, "children": [
+          {"name": "a", "count": 4, "children": [{"name": "x", "count": 1}, {"name": "y", "count": 2}]},
+          {"name": "b", "count": 1, "children": [{"name": "z", "count": 1}]},
+        ]},
+      ]},
+      {"name": "rel", "count": 1, "children": [{"name": "q", "count": 1}]},
+      {"name": "top", "count": 1},
+    ]})
+    # payloads on a row's own node, the first one for a path, JSON nested as is
+    srv = tree("select path_tree(path, size) from (select * from tree_files order by rowid)")["children"][0]["children"][0]
+    self.assertEqual(srv["children"][0]["payload"], "dir")
+    self.assertEqual(srv["children"][0]["children"][1], {"name": "y", "count": 2, "payload": 2})
+    self.assertNotIn("payload", srv)
+    self.assertEqual(
+      tree("select path_tree('/a', json_object('size', 3))"),
+      {"count": 1, "children": [{"name": "/", "count": 1, "children": [{"name": "a", "count": 1, "payload": {"size": 3}}]}]}
+    )
+    self.assertEqual(tree("select path_tree('a', '{\"size\": 3}')")["children"][0]["payload"], '{"size": 3}')
+    self.assertEqual(tree("select path_tree('a', 1.5)")["children"][0]["payload"], 1.5)
+    self.assertEqual(tree("select path_tree('a\"\n')")["children"][0]["name"], 'a"\n')
+    self.assertEqual(tree("select path_tree(path) from tree_files where 0"), {"count": 0})
+    self.assertEqual(db.execute("select json_type(path_tree(path)) from tree_files").fetchone()[0], "object")
+    with self.assertRaisesRegex(sqlite3.OperationalError, "JSON cannot hold BLOB values"):
+      tree("select path_tree('a', x'00')")
+    with self.assertRaisesRegex(sqlite3.OperationalError, "path_tree takes a path, and optionally a payload, an order and max_children"):
+      tree("select path_tree('a', 1, 'name', 2, 3)")
+
+    # sibling order and caps, from the arguments of the first row
+    names = lambda node: [c["name"] for c in node["children"]]
+    rows = "select path_tree(column1, null%s) from (values ('/z'), ('/a'), ('/m'), ('/m/1'), ('/a'), ('/m'))"
+    self.assertEqual(names(tree(rows % "")["children"][0]), ["a", "m", "z"])
+    self.assertEqual(names(tree(rows % ", 'name'")["children"][0]), ["a", "m", "z"])
+    self.assertEqual(names(tree(rows % ", 'count'")["children"][0]), ["m", "a", "z"])
+    self.assertEqual(names(tree(rows % ", 'INPUT'")["children"][0]), ["z", "a", "m"])
+    root = tree(rows % ", 'input', 2")["children"][0]
+    self.assertEqual(names(root), ["z", "a"])
+    self.assertEqual(root["truncated"], 1)
+    self.assertEqual(root["count"], 6)
+    self.assertEqual(names(tree(rows % ", null, '2'")["children"][0]), ["a", "m"])
+    self.assertEqual(names(tree(rows % ", null, 0")["children"][0]), ["a", "m", "z"])
+    with self.assertRaisesRegex(sqlite3.OperationalError, "path_tree order must be 'name', 'count' or 'input'"):
+      tree(rows % ", 'size'")
+    for cap in ["-1", "'abc'", "2.5"]:
+      with self.assertRaisesRegex(sqlite3.OperationalError, "path_tree max_children must be 0 or a positive integer"):
+        tree(rows % (", null, " + cap))
+    db.execute("drop table tree_files")
+
+  def test_path_win_tree(self):
+    self.assertEqual(
+      json.loads(db.execute("select path_win_tree(column1) from (values ('C:\\a\\b'), ('C:\\a/c'))").fetchone()[0]),
+      {"count": 2, "children": [{"name": "C:\\", "count": 2, "children": [
+        {"name": "a", "count": 2, "children": [{"name": "b", "count": 1}, {"name": "c", "count": 1}]},
+      ]}]}
+    )
+    # nodes match case-insensitively, and keep the first spelling
+    self.assertEqual(
+      json.loads(db.execute("select path_win_tree(column1) from (values ('C:\\a\\B'), ('c:/A/b/x'))").fetchone()[0]),
+      {"count": 2, "children": [{"name": "C:\\", "count": 2, "children": [
+        {"name": "a", "count": 2, "children": [{"name": "B", "count": 2, "children": [{"name": "x", "count": 1}]}]},
+      ]}]}
+    )
+
+  def test_path_common_prefix(self):
+    common_prefix = lambda paths: db.execute(
+      "select path_common_prefix(column1) from (select null as column1 union all select * from (values %s))" % ",".join("(?)" for _ in paths),
+      paths
+    ).fetchone()[0]
+    self.assertEqual(common_prefix(["/srv/a/x", "/srv/a/b/y", "/srv/a/b/./z"]), "/srv/a")
+    self.assertEqual(common_prefix(["/srv/a/x", "/tmp"]), "/")
+    self.assertEqual(common_prefix(["a/b/c", "a/b/d"]), "a/b")
+    self.assertEqual(common_prefix(["a/b", "b/c"]), None)
+    self.assertEqual(common_prefix(["/a", "a"]), None)
+    # one path is its own prefix, like path_intersection(path, path)
+    self.assertEqual(common_prefix(["/srv/a/x"]), "/srv/a/x")
+    # a prefix of the latest path, as given
+    self.assertEqual(common_prefix(["/srv/a/x", "/srv//a/y"]), "/srv//a")
+    self.assertEqual(db.execute("select path_common_prefix(null)").fetchone()[0], None)
+    self.assertEqual(db.execute("select path_common_prefix(1) where 0").fetchone()[0], None)
+
+    # a rolling common root, with rows leaving the frame through xInverse
+    paths = [
+      "/srv/a/x", "/srv/a/b/y", "/srv/a/b/z", "/srv/a/b/./q/r", "/tmp/x", None,
+      "/tmp/y/z", "/tmp/y/w", "rel/a", "rel/b/c", "/srv/a/b/../c", "/srv/a/c/d",
+    ]
+    db.execute("create table common_prefix_events(t int, path text)")
+    db.executemany("insert into common_prefix_events values (?, ?)", list(enumerate(paths)))
+    for frame in ["1 preceding and current row", "3 preceding and current row", "2 preceding and 1 preceding",
+                  "current row and 2 following", "unbounded preceding and current row"]:
+      rows = db.execute(
+        f"select t, path_common_prefix(path) over (order by t rows between {frame}) from common_prefix_events order by t"
+      ).fetchall()
+      for t, result in rows:
+        # path_intersection, folded over the frame, from the latest path back
+        sql = f"""
+          with frame as (
+            select t, path from common_prefix_events where path is not null and t in (
+              select t from common_prefix_events w where w.t between ? and ?
+            )
+          )
+          select path from frame order by t
+        """
+        lower, upper = {
+          "1 preceding and current row": (t - 1, t),
+          "3 preceding and current row": (t - 3, t),
+          "2 preceding and 1 preceding": (t - 2, t - 1),
+          "current row and 2 following": (t, t + 2),
+          "unbounded preceding and current row": (0, t),
+        }[frame]
+        frame_paths = [row[0] for row in db.execute(sql, [lower, upper]).fetchall()]
+        expected = frame_paths[-1] if frame_paths else None
+        for other in reversed(frame_paths[:-1]):
+          if expected is None:
+            break
+          expected = db.execute("select path_intersection(?, ?)", [expected, other]).fetchone()[0]
+        self.assertEqual(result, expected, f"{frame} at {t}")
+    db.execute("drop table common_prefix_events")
+
+  def test_path_win_common_prefix(self):
+    self.assertEqual(
+      db.execute("select path_win_common_prefix(column1) from (values ('C:\\Users\\A\\x'), ('c:/users/a/y'))").fetchone()[0],
+      "c:/users/a"
+    )
+
+  def test_path_parse(self):
+    self.assertEqual(execute_all("select * from path_parse('/a/b/../c.tar.gz')"), [{
+      "dirname": "/a/b/../", "basename": "c.tar.gz", "name": "c",
+      "extension": ".gz", "root": "/", "depth": 4, "is_absolute": 1,
+      "normalized": "/a/c.tar.gz",
+    }])
+    self.assertEqual(execute_all("select * from path_parse('')"), [{
+      "dirname": None, "basename": None, "name": None, "extension": None,
+      "root": "", "depth": 0, "is_absolute": 0, "normalized": ".",
+    }])
+    self.assertEqual(execute_all("select * from path_parse(null)"), [])
+    self.assertEqual(execute_all("select path, normalized from path_parse(?)", [b"/a/\xff/.."]),
+      [{"path": b"/a/\xff/..", "normalized": b"/a"}])
+    self.assertEqual(
+      sorted(tuple(row) for row in db.execute("select path, depth, normalized from path_parse where path in ('a/./b', '/c', null, 'd/..')").fetchall()),
+      [("/c", 1, "/c"), ("a/./b", 3, "a/b"), ("d/..", 2, ".")])
+
+    # same results as the scalar functions, for every subset of columns read
+    paths = ["/a/b/c.txt", "a", ".", "..", "/", "a/./b/../.vimrc", "x/y.tar.gz/", "~/z."]
+    scalars = {
+      "dirname": "path_dirname(value)", "basename": "path_basename(value)",
+      "name": "path_name(value)", "extension": "path_extension(value)",
+      "root": "path_root(value)", "depth": "path_length(value)",
+      "is_absolute": "path_absolute(value)", "normalized": "path_normalize(value)",
+    }
+    for column, scalar in scalars.items():
+      self.assertEqual(
+        execute_all(f"select p.{column} as x from json_each(?), path_parse(value) as p", [json.dumps(paths)]),
+        execute_all(f"select {scalar} as x from json_each(?)", [json.dumps(paths)]),
+        column)
+    self.assertEqual(
+      execute_all("select count(*) as n from json_each(?), path_parse(value)", [json.dumps(paths)]),
+      [{"n": len(paths)}])
+
+  def test_parse_cache(self):
+    # more distinct paths than the per-connection parse cache holds,
+    # with every single-path function called on each row
+    paths = ["/a/b%d/c%d.tar.gz" % (i, i) for i in range(10)] + ["", "x", "/"]
+    rows = execute_all("""
+      select
+        path_dirname(value) as dirname,
+        path_basename(value) as basename,
+        path_extension(value) as extension,
+        path_name(value) as name,
+        path_length(value) as length,
+        path_root(value) as root,
+        path_part_at(value, -1) as last
+      from json_each(?)
+    """, [json.dumps(paths + paths)])
+    for i, path in enumerate(paths + paths):
+      self.assertEqual(rows[i], execute_all("""
+        select
+          path_dirname(:p) as dirname,
+          path_basename(:p) as basename,
+          path_extension(:p) as extension,
+          path_name(:p) as name,
+          path_length(:p) as length,
+          path_root(:p) as root,
+          path_part_at(:p, -1) as last
+      """, {"p": path})[0])
+    self.assertEqual(rows[3], {
+      "dirname": "/a/b3/", "basename": "c3.tar.gz", "extension": ".gz",
+      "name": "c3", "length": 3, "root": "/", "last": "c3.tar.gz",
+    })
+
+
+  def test_binary_paths(self):
+    # BLOB paths give BLOB results, with non-UTF-8 and NUL bytes intact
+    path = b"/srv/caf\xe9/\x00x/report.tar.gz"
+    row = execute_all("""
+      select
+        path_dirname(:p) as dirname,
+        path_basename(:p) as basename,
+        path_extension(:p) as extension,
+        path_name(:p) as name,
+        path_root(:p) as root,
+        path_part_at(:p, 1) as part,
+        path_length(:p) as length,
+        path_absolute(:p) as absolute,
+        path_normalize(:p) as normalized,
+        path_join(:p, '..', 'b') as joined
+    """, {"p": path})[0]
+    self.assertEqual(row, {
+      "dirname": b"/srv/caf\xe9/\x00x/", "basename": b"report.tar.gz",
+      "extension": b".gz", "name": b"report", "root": b"/",
+      "part": b"caf\xe9", "length": 4, "absolute": 1,
+      "normalized": b"/srv/caf\xe9/\x00x/report.tar.gz",
+      "joined": b"/srv/caf\xe9/\x00x/b",
+    })
+    # the result has the type of the first path
+    self.assertEqual(
+      tuple(db.execute("select typeof(p), hex(p) from (select path_join('a', ?) as p)", [b"\xff"]).fetchone()),
+      ("text", "612FFF"))
+    self.assertEqual(db.execute("select path_basename(?)", [b""]).fetchone()[0], None)
+    self.assertEqual(db.execute("select path_normalize(?)", [b""]).fetchone()[0], b".")
+    self.assertEqual(
+      [row["part"] for row in execute_all("select part from path_parts(?)", [path])],
+      [b"srv", b"caf\xe9", b"\x00x", b"report.tar.gz"])
+    # TEXT paths stay TEXT, even with embedded NUL bytes
+    self.assertEqual(db.execute("select path_basename(?)", ["a/b\x00c"]).fetchone()[0], "b\x00c")
+
+
+  def test_path_win_absolute(self):
+    path_win_absolute = lambda arg: db.execute("select path_win_absolute(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_absolute("C:\\a"), 1)
+    self.assertEqual(path_win_absolute("C:/a"), 1)
+    self.assertEqual(path_win_absolute("C:a"), 0)
+    self.assertEqual(path_win_absolute("\\a"), 1)
+    self.assertEqual(path_win_absolute("\\\\server\\share\\a"), 1)
+    self.assertEqual(path_win_absolute("a\\b"), 0)
+    self.assertEqual(path_win_absolute(None), 0)
+
+  def test_path_win_basename(self):
+    path_win_basename = lambda arg: db.execute("select path_win_basename(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_basename("C:\\a\\b.txt"), "b.txt")
+    self.assertEqual(path_win_basename("a/b\\c"), "c")
+    self.assertEqual(path_win_basename("C:\\"), None)
+    # unix functions don't split on backslashes
+    self.assertEqual(db.execute("select path_basename('a\\b')").fetchone()[0], "a\\b")
+
+  def test_path_win_dirname(self):
+    path_win_dirname = lambda arg: db.execute("select path_win_dirname(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_dirname("C:\\a\\b.txt"), "C:\\a\\")
+    self.assertEqual(path_win_dirname("a\\b"), "a\\")
+    self.assertEqual(path_win_dirname("a"), None)
+
+  def test_path_win_extension(self):
+    path_win_extension = lambda arg: db.execute("select path_win_extension(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_extension("C:\\a.d\\b.txt"), ".txt")
+    self.assertEqual(path_win_extension("C:\\a.d\\b"), None)
+
+  def test_path_win_name(self):
+    path_win_name = lambda arg: db.execute("select path_win_name(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_name("C:\\a\\b.tar.gz"), "b")
+    self.assertEqual(path_win_name("C:\\a\\.vimrc"), ".vimrc")
+
+  def test_path_win_intersection(self):
+    path_win_intersection = lambda a, b: db.execute("select path_win_intersection(?, ?)", [a, b]).fetchone()[0]
+    self.assertEqual(path_win_intersection("C:\\Foo\\bar", "c:/foo/baz"), "C:\\Foo")
+    self.assertEqual(path_win_intersection("\\\\server\\share\\a", "\\\\SERVER\\share\\b"), "\\\\server\\share\\")
+    self.assertEqual(path_win_intersection("C:\\a", "D:\\a"), None)
+
+  def test_path_win_join(self):
+    path_win_join = lambda *args: db.execute(f"select path_win_join({spread_args(args)})", args).fetchone()[0]
+    self.assertEqual(path_win_join("C:\\a", "b"), "C:\\a\\b")
+    self.assertEqual(path_win_join("C:\\a", "b", "..\\c"), "C:\\a\\c")
+    self.assertEqual(path_win_join("a/b", "c"), "a\\b\\c")
+
+  def test_path_win_length(self):
+    path_win_length = lambda arg: db.execute("select path_win_length(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_length("C:\\a\\b/c"), 3)
+    self.assertEqual(path_win_length("\\\\server\\share\\a"), 1)
+    self.assertEqual(path_win_length("C:\\"), 0)
+
+  def test_path_win_normalize(self):
+    path_win_normalize = lambda arg: db.execute("select path_win_normalize(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_normalize("C:\\a\\.\\b\\..\\c"), "C:\\a\\c")
+    self.assertEqual(path_win_normalize("C:\\..\\a"), "C:\\a")
+    self.assertEqual(path_win_normalize("C:..\\a"), "C:..\\a")
+    self.assertEqual(path_win_normalize("a/b"), "a\\b")
+
+  def test_path_win_relative(self):
+    path_win_relative = lambda arg: db.execute("select path_win_relative(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_relative("C:a"), 1)
+    self.assertEqual(path_win_relative("C:\\a"), 0)
+    self.assertEqual(path_win_relative("a\\b"), 1)
+    self.assertEqual(path_win_relative(None), None)
+
+  def test_path_win_root(self):
+    path_win_root = lambda arg: db.execute("select path_win_root(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_root("C:\\a"), "C:\\")
+    self.assertEqual(path_win_root("C:a"), "C:")
+    self.assertEqual(path_win_root("\\a"), "\\")
+    self.assertEqual(path_win_root("\\\\server\\share\\a"), "\\\\server\\share\\")
+    self.assertEqual(path_win_root("\\\\?\\C:\\a"), "\\\\?\\")
+    self.assertEqual(path_win_root("a"), "")
+
+  def test_path_win_at(self):
+    self.assertEqual(db.execute("select path_win_at('C:\\a\\b', -1)").fetchone()[0], "b")
+
+  def test_path_win_part_at(self):
+    path_win_part_at = lambda a, b: db.execute("select path_win_part_at(?, ?)", [a, b]).fetchone()[0]
+    self.assertEqual(path_win_part_at("C:\\a\\b/c", 0), "a")
+    self.assertEqual(path_win_part_at("C:\\a\\b/c", 2), "c")
+    self.assertEqual(path_win_part_at("\\\\server\\share\\a", 0), "a")
+    self.assertEqual(path_win_part_at("C:\\a", 1), None)
+
+  def test_path_win_sort_key(self):
+    path_win_sort_key = lambda arg: db.execute("select path_win_sort_key(?)", [arg]).fetchone()[0]
+    self.assertEqual(path_win_sort_key("C:\\a\\b"), b"C:\x00a\x00b")
+    self.assertEqual(path_win_sort_key("C:/a\\b\\"), b"C:\x00a\x00b")
+
+  def test_path_win_subtree_upper(self):
+    self.assertEqual(db.execute("select path_win_subtree_upper('C:\\a')").fetchone()[0], b"C:\x00a\x01")
+    self.assertEqual(db.execute("select path_win_subtree_upper('C:\\')").fetchone()[0], b"C:\x01")
+
+  def test_path_win_under(self):
+    path_win_under = lambda a, b: db.execute("select path_win_under(?, ?)", [a, b]).fetchone()[0]
+    self.assertEqual(path_win_under("C:\\Users\\Alex\\a.txt", "c:/users"), 1)
+    self.assertEqual(path_win_under("C:\\Users\\a.txt", "D:\\Users"), 0)
+    self.assertEqual(path_win_under("\\\\server\\share\\a", "\\\\server\\share\\"), 1)
+
+  def test_path_win_tables(self):
+    self.assertEqual(
+      execute_all("select part from path_win_parts('C:\\a\\b/c')"),
+      [{"part": "a"}, {"part": "b"}, {"part": "c"}]
+    )
+    self.assertEqual(
+      execute_all("select root, basename, is_absolute, normalized from path_win_parse('C:\\a\\..\\b.txt')"),
+      [{"root": "C:\\", "basename": "b.txt", "is_absolute": 1, "normalized": "C:\\b.txt"}]
+    )
+    self.assertEqual(
+      execute_all("select prefix, depth from path_win_ancestors('C:\\a\\b/c.txt')"),
+      [{"prefix": "C:\\", "depth": 0}, {"prefix": "C:\\a", "depth": 1}, {"prefix": "C:\\a\\b", "depth": 2}]
+    )
+    # the same path gives different results for each style
+    self.assertEqual(
+      execute_all("select path_length('a\\b') as unix, path_win_length('a\\b') as win"),
+      [{"unix": 1, "win": 2}]
+    )
+
 class TestCoverage(unittest.TestCase):                                      
   def test_coverage(self):                                                      
     test_methods = [method for method in dir(TestPath) if method.startswith('test_path')]
@@ -22,11 +22,11 @@ class TestSqliteLinesCli(unittest.TestCase):
     self.assertEqual(run_sqlite3('select 1').stdout,  '1\n')
     self.assertEqual(
       run_sqlite3(['select name from pragma_function_list where name like "path_%" order by 1']).stdout,  
-      "path_absolute\npath_at\npath_basename\npath_debug\npath_dirname\npath_extension\npath_intersection\npath_join\npath_name\npath_normalize\npath_part_at\npath_relative\npath_root\npath_version\n"
+      "path_absolute\npath_at\npath_basename\npath_common_prefix\npath_config\npath_debug\npath_dirname\npath_extension\npath_intersection\npath_join\npath_length\npath_name\npath_normalize\npath_part_at\npath_relative\npath_rollup\npath_root\npath_sort_key\npath_subtree_upper\npath_tree\npath_under\npath_version\npath_win_absolute\npath_win_at\npath_win_basename\npath_win_common_prefix\npath_win_dirname\npath_win_extension\npath_win_intersection\npath_win_join\npath_win_length\npath_win_name\npath_win_normalize\npath_win_part_at\npath_win_relative\npath_win_rollup\npath_win_root\npath_win_sort_key\npath_win_subtree_upper\npath_win_tree\npath_win_under\n"
     )
     self.assertEqual(
       run_sqlite3(['select name from pragma_module_list where name like "path_%" order by 1']).stdout,  
-      "path_parts\n"
+      "path_ancestors\npath_closure\npath_parse\npath_parts\npath_stats\npath_synth\npath_trie\npath_win_ancestors\npath_win_parse\npath_win_parts\n"
     )
     self.assertEqual(
       run_sqlite3(['select * from path_parts("/a/b/c");']).stdout,  